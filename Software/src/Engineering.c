@@ -32,13 +32,9 @@ void EngineeringConsole() {
                 break;
 
             case '1':
-                RadioTX();
                 TncPreparePacket("$GPGGA,155146,3000.5000,N,10000.0100,W,1,10,0.9,2000.0,M,,M,,*74", "APRS  ");
                 // Send it
-                TncSendPacket();
-
-                __delay_ms(10);
-                RadioRX();
+                RadioTransmit();
                 break;
 
             case '2':
@@ -0,0 +1,111 @@
+#include "main.h"
+#include "beacon.h"
+
+/**
+ * @defgroup beacon Smart Beaconing
+ *
+ * Decides when to send a position from how fast we're going and how much the
+ * heading has changed.  At or below lowSpeed a beacon goes out every slowRate
+ * seconds.  Between the speed thresholds the interval shrinks in proportion to
+ * speed, down to fastRate at highSpeed.  Any time turnTime has passed since the
+ * last beacon, a heading change of more than turnAngle + turnSlope / knots sends
+ * one right away ("corner pegging"), so the track keeps its shape through turns.
+ *
+ * Both tests are done by cross multiplying, so there's no division and no
+ * floating point:  elapsed * speed >= fastRate * highSpeed instead of elapsed >=
+ * fastRate * highSpeed / speed, and the same for the turn.
+ *
+ * @{
+ */
+
+/// Smart beaconing settings
+BEACON_CONFIG beaconConfig;
+
+/// System tick and heading of the last beacon
+static uint32_t beaconTick;
+static uint16_t beaconHeading;
+
+/// Set once the first beacon has gone out
+static bool_t beaconSent;
+
+/**
+ * Set the default smart beaconing rates.  They're picked for a balloon:  never more
+ * than a few minutes apart, and every 30 seconds once the winds aloft pick it up.
+ */
+void BeaconConfigDefault(void) {
+    beaconConfig.slowRate = 180;
+    beaconConfig.fastRate = 30;
+
+    // 5 and 60 knots
+    beaconConfig.lowSpeed = 50;
+    beaconConfig.highSpeed = 600;
+
+    beaconConfig.turnAngle = 28;
+    beaconConfig.turnSlope = 255;
+    beaconConfig.turnTime = 15;
+
+    BeaconReset();
+}
+
+/**
+ * Send a beacon on the next fix, whatever the rates say.
+ */
+void BeaconReset(void) {
+    beaconSent = FALSE;
+}
+
+/**
+ * Determine if a position should be sent for this fix.  It isn't counted as sent
+ * until BeaconSent() is called, so one that couldn't be queued is tried again on
+ * the next fix.
+ *
+ * @param gps the latest fix
+ * @param tick current system tick (50 mS)
+ *
+ * @return true if it's time for a beacon
+ */
+bool_t BeaconIsDue(GPSData * gps, uint32_t tick) {
+    uint32_t elapsed;
+    uint16_t speed, turn;
+    bool_t due;
+
+    elapsed = tick - beaconTick;
+
+    if (!beaconSent)
+        due = TRUE;
+    else if (gps->speed <= beaconConfig.lowSpeed)
+        due = (elapsed >= (uint32_t) beaconConfig.slowRate * BEACON_TICK_RATE);
+    else {
+        // fastRate * highSpeed / speed seconds apart, but no faster than fastRate
+        speed = (gps->speed < beaconConfig.highSpeed ? gps->speed : beaconConfig.highSpeed);
+        due = (elapsed * speed >= (uint32_t) beaconConfig.fastRate * BEACON_TICK_RATE * beaconConfig.highSpeed);
+
+        if (!due && elapsed >= (uint32_t) beaconConfig.turnTime * BEACON_TICK_RATE) {
+            // Heading change either way around, in 0.01 degrees
+            turn = (gps->heading > beaconHeading ? gps->heading - beaconHeading : beaconHeading - gps->heading);
+            if (turn > 18000)
+                turn = 36000 - turn;
+
+            // turn > turnAngle + turnSlope / knots, with knots * 10 and 0.01 degrees
+            if (turn > beaconConfig.turnAngle * 100)
+                due = ((uint32_t) (turn - beaconConfig.turnAngle * 100) * gps->speed >
+                        (uint32_t) beaconConfig.turnSlope * 1000);
+        }
+    }
+
+    return due;
+}
+
+/**
+ * Start the next interval from a beacon that was queued.
+ *
+ * @param gps the fix that was sent
+ * @param tick system tick (50 mS) it was sent at
+ */
+void BeaconSent(GPSData * gps, uint32_t tick) {
+    beaconTick = tick;
+    beaconHeading = gps->heading;
+    beaconSent = TRUE;
+}
+
+/** @} */
@@ -0,0 +1,72 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     beacon.h                                                  *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef BEACON_H
+#define BEACON_H
+
+#include "main.h"
+#include "gps.h"
+
+/**
+ * @defgroup beacon Smart Beaconing
+ *
+ * @{
+ */
+
+/// Smart beaconing settings.  Speeds are in knots * 10, like GPSData.
+typedef struct {
+    /// Seconds between beacons at or below lowSpeed
+    uint16_t slowRate;
+    /// Seconds between beacons at or above highSpeed
+    uint16_t fastRate;
+    /// Speed below which we're treated as stopped
+    uint16_t lowSpeed;
+    /// Speed at which the fast rate kicks in
+    uint16_t highSpeed;
+    /// Smallest heading change that counts as a turn at any speed, in degrees
+    uint8_t turnAngle;
+    /// Added to the turn angle at low speed, in degrees * knots.  The angle needed is turnAngle + turnSlope / knots.
+    uint16_t turnSlope;
+    /// Seconds after a beacon before a turn can trigger another
+    uint16_t turnTime;
+} BEACON_CONFIG;
+
+/// The smart beaconing settings, set up by BeaconConfigDefault()
+extern BEACON_CONFIG beaconConfig;
+
+void BeaconConfigDefault(void); // Set the default smart beaconing rates
+void BeaconReset(void); // Send a beacon on the next fix
+bool_t BeaconIsDue(GPSData * gps, uint32_t tick); // True if a position should be sent for this fix
+void BeaconSent(GPSData * gps, uint32_t tick); // Start the next interval from a queued beacon
+
+/// System ticks in a second, 50 mS each
+#define BEACON_TICK_RATE 20
+
+/** @} */
+
+#endif  // #ifndef BEACON_H
@@ -0,0 +1,154 @@
+#include "gps.h"
+#include "compress.h"
+
+/**
+ *  @defgroup compress Compressed Position
+ *
+ *  APRS compressed position reports.  Latitude and longitude go out as 4 base-91
+ *  digits each, followed by either course and speed or altitude in 2 more.  The
+ *  report is 14 bytes where Mic-E is 13, but it goes to the normal destination
+ *  address, so which one is shorter on the air comes down to bit stuffing.
+ *
+ *  All the math is done in 32 bits, without floating point.
+ *
+ *  @{
+ */
+
+/// Informational text field as part of the AX.25 message.
+static char information[16];
+
+/**
+ * Multiply a number of 10^-7 degrees by a scale, exactly, without overflowing 32 bits.
+ *
+ * @param value angle in degrees * 10^7
+ * @param scale base-91 units per degree, less than 2^19
+ *
+ * @return value * scale / 10^7, rounded down
+ */
+static uint32_t CompressScale(uint32_t value, uint32_t scale)
+{
+    uint32_t fraction, high;
+
+    // Whole degrees can't overflow.  The fraction is split at bit 12, and 10^7 is
+    // 78125 * 2^7, so each piece of fraction * scale stays under 2^31.
+    fraction = value % 10000000;
+    high = (fraction >> 12) * scale;
+
+    return (value / 10000000) * scale + (high / 78125) * 32 +
+            ((high % 78125) * 4096 + (fraction & 0x0fff) * scale) / 10000000;
+}
+
+/**
+ * Write a number as 4 base-91 digits, most significant first.
+ *
+ * @param value number less than 91^4
+ * @param out where the digits go
+ */
+static void CompressBase91(uint32_t value, char *out)
+{
+    out[0] = 33 + (value / 753571);
+    value %= 753571;
+    out[1] = 33 + (value / 8281);
+    value %= 8281;
+    out[2] = 33 + (value / 91);
+    out[3] = 33 + (value % 91);
+}
+
+/**
+ * Find the compressed altitude, the power of 1.002 nearest the altitude in feet.
+ *
+ * @param feet altitude
+ *
+ * @return log base 1.002 of feet, 0 to 8280
+ */
+static uint16_t CompressAltitude(uint32_t feet)
+{
+    uint32_t x, power;
+    uint8_t i;
+
+    if (feet <= 1)
+        return 0;
+
+    // Whole part of log2, and the rest of feet scaled to 1.0 to 2.0 in Q15
+    power = 0;
+    for (x = feet; x > 1; x >>= 1)
+        power += 4096;
+
+    x = (power >= 15 * 4096 ? feet >> ((power >> 12) - 15) : feet << (15 - (power >> 12)));
+
+    // 12 fraction bits by squaring.  Each time it passes 2.0 is a one.
+    for (i = 0; i < 12; ++i) {
+        x = (x * x) >> 15;
+        if (x >= 65536) {
+            x >>= 1;
+            power |= 0x0800 >> i;
+        }
+    }
+
+    // power is log2(feet) in Q12, rounded down.  1 / log2(1.002) is 346.920, split
+    // into 346 and 15074 / 16384 so the product fits in 32 bits.  The extra 173 is
+    // half a count of power, and 2048 rounds to the nearest.
+    x = (power * 346 + ((power * 15074) >> 14) + 2048 + 173) >> 12;
+
+    return (x > 8280 ? 8280 : x);
+}
+
+/**
+ * Generate the compressed position report.  It has altitude with a 3D fix and
+ * course and speed otherwise.
+ *
+ * @param gps GPSData structure containing the position
+ */
+void CompressEncode (GPSData *gps)
+{
+    uint32_t value, limit;
+    uint8_t speed;
+
+    // Position without time or messaging, balloon symbol
+    information[0] = '!';
+    information[1] = '/';
+    information[10] = 'O';
+
+    // 380926 units per degree south from 90 N, 190463 per degree east from 180 W
+    CompressBase91(CompressScale(900000000 - gps->latitude, 380926), information + 2);
+    CompressBase91(CompressScale(1800000000UL + gps->longitude, 190463), information + 6);
+
+    if (gps->fixType == Fix3D) {
+        // Altitude in feet from cm, to the nearest foot.  The type byte says it came
+        // from a GGA sentence.
+        value = (gps->altitude > 0 ? gps->altitude : 0);
+        value = CompressAltitude((value * 25 + 381) / 762);
+
+        information[11] = 33 + (value / 91);
+        information[12] = 33 + (value % 91);
+        information[13] = 33 + 0x30;
+    } else {
+        // Course in 4 degree steps, 0.01 degrees in
+        information[11] = 33 + (gps->heading / 400) % 90;
+
+        // Speed is 1.08^s - 1 knots.  Find the largest s that doesn't go over, keeping
+        // 1.08^s * 10000 in value so it compares with speed in knots * 10.
+        limit = ((uint32_t) gps->speed + 10) * 1000;
+        value = 10000;
+        for (speed = 0; speed < 89 && (value * 108 + 50) / 100 <= limit; ++speed)
+            value = (value * 108 + 50) / 100;
+
+        information[12] = 33 + speed;
+        information[13] = 33 + 0x20;
+    }
+
+    // NULL terminate the string.
+    information[14] = 0;
+}
+
+/**
+ * Get the information field text of the compressed position report.
+ *
+ * @return NULL terminated string
+ */
+char * CompressGetInfoField()
+{
+    return information;
+}
+
+/** @} */
@@ -0,0 +1,53 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     compress.h                                                *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "main.h"
+#include "gps.h"
+
+/**
+ *  @defgroup compress Compressed Position
+ *
+ *  @{
+ */
+
+/**
+ *  Generate an APRS compressed position report
+ */
+void CompressEncode (GPSData *gps);
+
+/**
+ * Get the AX.25 info field of the compressed position report
+ * @return pointer to the NULL terminated string
+ */
+char * CompressGetInfoField();
+
+/** @} */
+
+#endif  // #ifndef COMPRESS_H
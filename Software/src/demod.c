@@ -0,0 +1,311 @@
+#include <htc.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "demod.h"
+#include "tnc.h"
+
+#if DEMOD_ENABLE
+
+/**
+ * @defgroup demod AFSK Demodulator
+ *
+ * Receives Bell 202 AFSK from the radio's discriminator audio.  Timer 3 and
+ * the CCP2 special event trigger start an ADC conversion 9600 times a second,
+ * so every bit is 8 samples.  Each sample is correlated against the mark and
+ * space tones over the last bit, a software PLL picks the middle of each bit,
+ * and the bits are NRZI decoded, un-stuffed, and collected into frames.  All
+ * of it runs from the ADC interrupt at low priority.
+ *
+ * The correlators are sliding sums of sample * reference products.  Each
+ * sample adds 4 products and drops the 4 from one bit ago, so the cost per
+ * sample doesn't depend on the window length.  That's 4 8x8 multiplies, about
+ * 300 of the 833 instruction cycles between samples, leaving a bit over half
+ * the CPU for the main loop.
+ *
+ * @{
+ */
+
+/// 1200 Hz reference at 9600 Hz, one cycle every 8 samples.  Scaled to +/-63.
+static const int8_t markCos[DEMOD_SAMPLES_PER_BIT] = {63, 45, 0, -45, -63, -45, 0, 45};
+static const int8_t markSin[DEMOD_SAMPLES_PER_BIT] = {0, 45, 63, 45, 0, -45, -63, -45};
+
+/// 2200 Hz reference at 9600 Hz, 11 cycles every 48 samples.  Scaled to +/-63.
+static const int8_t spaceCos[48] = {
+     63,   8, -61, -24,  55,  38, -45, -50,  31,  58, -16, -62,
+      0,  62,  16, -58, -32,  50,  45, -38, -55,  24,  61,  -8,
+    -63,  -8,  61,  24, -55, -38,  45,  50, -31, -58,  16,  62,
+      0, -62, -16,  58,  32, -50, -45,  38,  55, -24, -61,   8
+};
+static const int8_t spaceSin[48] = {
+      0,  62,  16, -58, -32,  50,  45, -38, -55,  24,  61,  -8,
+    -63,  -8,  61,  24, -55, -38,  45,  50, -31, -58,  16,  62,
+      0, -62, -16,  58,  32, -50, -45,  38,  55, -24, -61,   8,
+     63,   8, -61, -24,  55,  38, -45, -50,  31,  58, -16, -62
+};
+
+/// Products from the last bit, so they can be dropped from the sums
+static int16_t markIHistory[DEMOD_SAMPLES_PER_BIT], markQHistory[DEMOD_SAMPLES_PER_BIT];
+static int16_t spaceIHistory[DEMOD_SAMPLES_PER_BIT], spaceQHistory[DEMOD_SAMPLES_PER_BIT];
+
+/// Correlation of the last bit with the mark and space tones
+static int16_t markI, markQ, spaceI, spaceQ;
+
+/// Position in the history and the space reference
+static uint8_t demodIndex, demodSpaceIndex;
+
+/// Bit clock phase.  Tone changes should line up with 0; bits are picked at 128.
+static uint8_t demodPll;
+
+/// Tone of the last sample and of the last bit, 1 is a mark
+static uint8_t demodTone, demodBitTone;
+
+/// Last 8 bits received, to find flags
+static uint8_t demodHdlc;
+
+/// Number of ones in a row, to remove bit stuffing and catch aborts
+static uint8_t demodOnes;
+
+/// Byte being received and the number of bits in it so far
+static uint8_t demodByte, demodBitCount;
+
+/// True between an opening flag and an abort
+static bool_t demodInFrame;
+
+/// Bits since the last flag, to tell a real preamble from a flag-shaped bit of noise
+static uint8_t demodFlagBits;
+
+/// Bits left until the channel is clear again
+static volatile uint8_t demodDcd;
+
+/// Two frame buffers.  The interrupt fills one while the main loop reads the other.
+static uint8_t demodFrames[2][DEMOD_MAX_FRAME];
+static uint8_t demodLength, demodWriteBuffer;
+
+/// Set when a frame is waiting in demodFrames[demodReadyBuffer]
+static volatile bool_t demodReady;
+static uint8_t demodReadyBuffer, demodReadyLength;
+
+/**
+ * Set up the ADC, timer 3, and CCP2 to sample the radio audio.  Call DemodStart()
+ * to begin receiving.
+ */
+void DemodInit(void) {
+    // Audio input pin
+    TRISAbits.TRISA5 = 1;
+    ADCON1 = DEMOD_ADCON1;
+
+    // Left justified so ADRESH has the top 8 bits, 4 Tad acquisition, Fosc/32 conversion clock
+    ADCON2 = 0b00010010;
+    ADCON0 = (DEMOD_ADC_CHANNEL << 2) | 0x01;
+
+    // Timer 3 from Fosc/4, no prescaler, clocks CCP2 (CCP1 stays on timer 1)
+    T3CON = 0b00001001;
+
+    // CCP2 compare with special event trigger: reset timer 3 and start a conversion
+    CCPR2H = DEMOD_CCPR2 >> 8;
+    CCPR2L = DEMOD_CCPR2 & 0xff;
+    CCP2CON = 0b00001011;
+
+    // Conversions are handled at low priority
+    ADIP = 0;
+    ADIF = 0;
+}
+
+/**
+ * Start receiving.
+ */
+void DemodStart(void) {
+    demodInFrame = FALSE;
+    demodDcd = 0;
+    ADIF = 0;
+    ADIE = 1;
+}
+
+/**
+ * Stop receiving, while we transmit.
+ */
+void DemodStop(void) {
+    ADIE = 0;
+    demodInFrame = FALSE;
+    demodDcd = 0;
+}
+
+/**
+ * Handle one received bit.  NRZI decode it, remove bit stuffing, and collect the
+ * bytes between flags.
+ *
+ * @param tone tone of the bit, 1 for a mark
+ */
+static void DemodBit(uint8_t tone) {
+    uint8_t bit;
+
+    // NRZI decode.  No change in tone is a one.
+    bit = (tone == demodBitTone);
+    demodBitTone = tone;
+
+    if (demodDcd != 0)
+        --demodDcd;
+
+    if (demodFlagBits != 0xff)
+        ++demodFlagBits;
+
+    demodHdlc = demodHdlc >> 1;
+    if (bit)
+        demodHdlc |= 0x80;
+
+    if (demodHdlc == 0x7e) {
+        // A flag.  If it closes a whole number of bytes (the flag's first 7 bits are
+        // already in demodByte), pass the frame to the main loop.
+        if (demodInFrame && demodBitCount == 7 && demodLength >= DEMOD_MIN_FRAME && !demodReady) {
+            demodReadyBuffer = demodWriteBuffer;
+            demodReadyLength = demodLength;
+            demodReady = TRUE;
+            demodWriteBuffer ^= 1;
+        }
+
+        // Noise makes a flag now and then, but back to back flags mean someone is sending
+        if (demodFlagBits == 8)
+            demodDcd = DEMOD_DCD_BITS;
+
+        demodInFrame = TRUE;
+        demodLength = 0;
+        demodBitCount = 0;
+        demodOnes = 0;
+        demodFlagBits = 0;
+        return;
+    }
+
+    if (bit) {
+        // 7 ones in a row is an abort, or noise
+        if (++demodOnes == 7)
+            demodInFrame = FALSE;
+    } else {
+        // A zero after 5 ones was stuffed by the sender
+        if (demodOnes == 5) {
+            demodOnes = 0;
+            return;
+        }
+        demodOnes = 0;
+    }
+
+    if (!demodInFrame)
+        return;
+
+    // Bytes are sent LSB first
+    demodByte = demodByte >> 1;
+    if (bit)
+        demodByte |= 0x80;
+
+    if (++demodBitCount == 8) {
+        demodBitCount = 0;
+
+        if (demodLength == DEMOD_MAX_FRAME) {
+            demodInFrame = FALSE;
+            return;
+        }
+
+        demodFrames[demodWriteBuffer][demodLength++] = demodByte;
+
+        // Once the preamble has been heard, keep the channel busy to the end of the frame
+        if (demodDcd != 0)
+            demodDcd = DEMOD_DCD_BITS;
+    }
+}
+
+/**
+ * ADC interrupt handler.  Runs for every sample of the radio audio.  Must be called
+ * from the low priority interrupt.
+ */
+void DemodAdcInterrupt(void) {
+    int8_t sample;
+    int16_t product, mark, space;
+    uint8_t i, tone;
+
+    ADIF = 0;
+
+    // Remove the bias.  Half scale leaves room in the 16 bit sums for a bit of products.
+    sample = (int8_t) (ADRESH - 128) >> 1;
+
+    // Slide the correlation windows along one sample
+    i = demodIndex;
+
+    product = sample * markCos[i];
+    markI += product - markIHistory[i];
+    markIHistory[i] = product;
+
+    product = sample * markSin[i];
+    markQ += product - markQHistory[i];
+    markQHistory[i] = product;
+
+    product = sample * spaceCos[demodSpaceIndex];
+    spaceI += product - spaceIHistory[i];
+    spaceIHistory[i] = product;
+
+    product = sample * spaceSin[demodSpaceIndex];
+    spaceQ += product - spaceQHistory[i];
+    spaceQHistory[i] = product;
+
+    demodIndex = (i + 1) & (DEMOD_SAMPLES_PER_BIT - 1);
+    if (++demodSpaceIndex == 48)
+        demodSpaceIndex = 0;
+
+    // Whichever tone correlates better is the one we're hearing
+    mark = abs(markI) + abs(markQ);
+    space = abs(spaceI) + abs(spaceQ);
+    tone = (mark > space);
+
+    // Pull the bit clock toward the tone changes
+    if (tone != demodTone) {
+        demodTone = tone;
+        demodPll = (uint8_t) ((int8_t) demodPll - ((int8_t) demodPll >> 2));
+    }
+
+    // The window covers a whole bit when the clock is half way between tone changes
+    i = demodPll;
+    demodPll += 256 / DEMOD_SAMPLES_PER_BIT;
+    if ((i & 0x80) == 0 && (demodPll & 0x80) != 0)
+        DemodBit(tone);
+}
+
+/**
+ * Determine if someone is sending on the channel.
+ *
+ * @return true if we've heard flags or frame bytes in the last DEMOD_DCD_BITS bits
+ */
+bool_t DemodIsChannelBusy(void) {
+    return demodDcd != 0;
+}
+
+/**
+ * Get the last frame received, if its CRC checks out.  The interrupt doesn't touch
+ * the buffer until it's released, so it's checked and copied out first.
+ *
+ * @param frame where to copy the frame, starting with the destination address
+ * @param size most bytes to copy; any more of the frame are left out
+ *
+ * @return length of the frame without the CRC, or 0 if there's none
+ */
+uint8_t DemodGetFrame(uint8_t *frame, uint8_t size) {
+    uint8_t *ready, length;
+
+    if (!demodReady)
+        return 0;
+
+    ready = demodFrames[demodReadyBuffer];
+    length = demodReadyLength - 2;
+
+    if (CRC16(ready, length) != (ready[length] | ((uint16_t) ready[length + 1] << 8)))
+        length = 0;
+    else
+        memcpy(frame, ready, (length < size ? length : size));
+
+    // Now the interrupt can have the buffer back
+    demodReady = FALSE;
+
+    return length;
+}
+
+/** @} */
+
+#endif  // #if DEMOD_ENABLE
@@ -0,0 +1,71 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     demod.h                                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#ifndef DEMOD_H
+#define DEMOD_H
+
+#include "main.h"
+
+/**
+ * @defgroup demod AFSK Demodulator
+ *
+ * @{
+ */
+
+void DemodInit(void);
+void DemodStart(void);
+void DemodStop(void);
+void DemodAdcInterrupt(void);
+bool_t DemodIsChannelBusy(void);
+uint8_t DemodGetFrame(uint8_t *frame, uint8_t size);
+
+/// Set to 1 on boards that bring the radio's receive audio to AN4 (RA5).  On the PICTrack
+/// board RA5 only goes to TP1, so without a wire there's nothing to listen to.
+#ifndef DEMOD_ENABLE
+#define DEMOD_ENABLE 0
+#endif
+
+/// ADC channel with the radio's discriminator audio, biased to half the supply.  AN4 is RA5.
+#define DEMOD_ADC_CHANNEL 4
+/// ADCON1 setting that makes AN0 through DEMOD_ADC_CHANNEL analog.  The DAC on RA0-RA3 still drives its pins.
+#define DEMOD_ADCON1 0x0a
+
+/// Samples per bit.  The correlators and clock recovery are built around 8.
+#define DEMOD_SAMPLES_PER_BIT 8
+/// Timer 3 period that starts each conversion, (Fosc/4)/(1200 * 8).  9604 Hz
+#define DEMOD_CCPR2 833
+
+/// Largest frame we'll receive, including the CRC.  Room for our own packets.
+#define DEMOD_MAX_FRAME 160
+/// Smallest frame worth checking:  two addresses, control field, and CRC
+#define DEMOD_MIN_FRAME 17
+/// Number of bits the channel stays busy after the last flag or byte we heard
+#define DEMOD_DCD_BITS 32
+
+/** @} */
+
+#endif  // #ifndef DEMOD_H
@@ -41,6 +41,12 @@ uint32_t tail;
 /// Circular buffer (FIFO) to hold serial data.
 uint8_t buffer[FIFOBUFFERSIZE];
 
+/// Set when a character was dropped because the FIFO was full.
+static volatile bool_t overflow;
+
+/// Index of the first character after the last one dropped.
+static volatile uint32_t gap;
+
 /**
  * Clear the FIFO contents.
  */
@@ -48,6 +54,7 @@ void FifoClear()
 {
     head = 0;
     tail = 0;
+    overflow = FALSE;
 }
 
 /**
@@ -92,9 +99,41 @@ uint8_t FifoRead()
  */
 void FifoWrite(uint8_t value)
 {
+    // Drop the character if the FIFO is full, rather than write over the oldest ones,
+    // and note where the gap is.
+    if (((head + 1) & FIFOBufferMask) == tail) {
+        gap = head;
+        overflow = TRUE;
+        return;
+    }
+
     // Save the value in the FIFO.
     buffer[head] = value;
 
     // Move the pointer to the next open space.
     head = (head + 1) & FIFOBufferMask;
-}
\ No newline at end of file
+}
+
+/**
+ * Determine if characters were dropped because the FIFO was full.  This is a one
+ * shot, it's cleared by the call.
+ *
+ * @return true if characters were lost since the last call
+ */
+bool_t FifoOverflow()
+{
+    if (!overflow)
+        return FALSE;
+
+    overflow = FALSE;
+    return TRUE;
+}
+
+/**
+ * Throw away the characters ahead of the last ones dropped, so the next one read
+ * is the first character after the gap.
+ */
+void FifoSkipToGap()
+{
+    tail = gap;
+}
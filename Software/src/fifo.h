@@ -43,6 +43,8 @@ void FifoClear();
 bool_t FifoHasData();
 uint8_t FifoRead();
 void FifoWrite(uint8_t value);
+bool_t FifoOverflow();
+void FifoSkipToGap();
 
 /** @} */
 
@@ -0,0 +1,203 @@
+#include <string.h>
+#include "main.h"
+#include "flight.h"
+#include "tnc.h"
+
+/**
+ * @defgroup flight Flight Phase
+ *
+ * Works out the flight phase from the altitude of each fix, and picks the
+ * digipeater path to go with it.  On the ground we need fill-in digipeaters to
+ * be heard at all.  Once we're high, dozens of digipeaters hear every packet
+ * directly and a WIDE path only floods the channel and adds 7 bytes to every
+ * frame.  The address fields are only rebuilt when the path changes.
+ *
+ * The climb rate is the change in altitude over the GPS time between fixes,
+ * smoothed over about 8 seconds.  It goes by the time rather than counting
+ * fixes, since a receiver sending both GGA and NAV-PVT reports each second
+ * twice, and a lost fix leaves a gap.
+ *
+ * @{
+ */
+
+/// A digipeater path, relay call signs padded to 6 characters.  An empty call sign is left out.
+typedef struct {
+    char relayCallSign1[7];
+    uint8_t relayCallSignSSID1;
+    char relayCallSign2[7];
+    uint8_t relayCallSignSSID2;
+} FLIGHT_PATH;
+
+/// Paths from the ground up
+static const FLIGHT_PATH flightPaths[] = {
+    /// Near the ground, fill-in digipeaters and one wide hop
+    {"WIDE1 ", 1, "WIDE2 ", 1},
+    /// In the air, one wide hop
+    {"WIDE2 ", 1, "", 0},
+    /// High enough to be heard directly
+    {"", 0, "", 0}
+};
+
+/// Index of the path near the ground, in the air, and high up
+#define FLIGHT_PATH_GROUND 0
+#define FLIGHT_PATH_AIR 1
+#define FLIGHT_PATH_DIRECT 2
+
+static FLIGHT_PHASE flightPhase;
+
+/// Altitude of the last fix, and the lowest altitude before launch, in cm
+static int32_t flightAltitude, flightLaunchAltitude;
+
+/// Smoothed climb rate in cm/s
+static int16_t flightClimbRate;
+
+/// GPS time of the last fix, in seconds since midnight
+static int32_t flightTime;
+
+/// Seconds in a row that held altitude
+static uint8_t flightSteady;
+
+/// Set once there's been a fix to measure from
+static bool_t flightHaveFix;
+
+/// Path in use, an index into flightPaths
+static uint8_t flightPath;
+
+/**
+ * Start out on the ground.  The path is set on the first FlightUpdate().
+ */
+void FlightInit(void) {
+    flightPhase = FLIGHT_GROUND;
+    flightClimbRate = 0;
+    flightSteady = 0;
+    flightHaveFix = FALSE;
+    flightPath = 0xff;
+}
+
+/**
+ * Switch to a path, rebuilding the address fields if it's a change.
+ *
+ * @param path index into flightPaths
+ */
+static void FlightSetPath(uint8_t path) {
+    if (path == flightPath)
+        return;
+
+    flightPath = path;
+    memcpy(config.relayCallSign1, flightPaths[path].relayCallSign1, sizeof(config.relayCallSign1));
+    config.relayCallSignSSID1 = flightPaths[path].relayCallSignSSID1;
+    memcpy(config.relayCallSign2, flightPaths[path].relayCallSign2, sizeof(config.relayCallSign2));
+    config.relayCallSignSSID2 = flightPaths[path].relayCallSignSSID2;
+
+    TncBuildHeader();
+}
+
+/**
+ * Update the flight phase from a new fix and pick the digipeater path for the
+ * packets that follow it.  Call it for every fix with an altitude.
+ *
+ * @param gps the latest fix
+ */
+void FlightUpdate(GPSData * gps) {
+    int32_t climb, now, elapsed;
+    uint8_t path;
+
+    now = gps->hours * 3600L + gps->minutes * 60 + gps->seconds;
+
+    if (!flightHaveFix) {
+        flightHaveFix = TRUE;
+        flightAltitude = gps->altitude;
+        flightLaunchAltitude = gps->altitude;
+        flightTime = now;
+    }
+
+    // A second report of the same second adds nothing
+    elapsed = now - flightTime;
+    if (elapsed < 0)
+        elapsed += 24 * 3600L;
+    if (elapsed == 0 && flightPath != 0xff)
+        return;
+
+    // Smooth the climb rate, giving each fix the weight of the seconds it covers.  A
+    // jump faster than 100 m/s is a glitch, and so is the jump back from it, so
+    // neither fix counts for anything.
+    climb = gps->altitude - flightAltitude;
+    flightAltitude = gps->altitude;
+    flightTime = now;
+    if (climb > 10000 * elapsed || climb < -10000 * elapsed)
+        return;
+    if (elapsed != 0)
+        flightClimbRate += ((climb / elapsed - flightClimbRate) * (elapsed > 8 ? 8 : elapsed)) / 8;
+
+    if (flightClimbRate < FLIGHT_STEADY_RATE && flightClimbRate > -FLIGHT_STEADY_RATE)
+        flightSteady = (flightSteady + elapsed > 0xff ? 0xff : flightSteady + elapsed);
+    else
+        flightSteady = 0;
+
+    switch (flightPhase) {
+        case FLIGHT_GROUND:
+            // The launch site is the lowest we've been.  Climbing well clear of it is a launch.
+            if (gps->altitude < flightLaunchAltitude)
+                flightLaunchAltitude = gps->altitude;
+            if (flightClimbRate > FLIGHT_CLIMB_RATE && gps->altitude > flightLaunchAltitude + FLIGHT_LAUNCH_HEIGHT)
+                flightPhase = FLIGHT_ASCENT;
+            break;
+
+        case FLIGHT_ASCENT:
+        case FLIGHT_FLOAT:
+            if (flightClimbRate < FLIGHT_SINK_RATE)
+                flightPhase = FLIGHT_DESCENT;
+            else if (flightClimbRate > FLIGHT_CLIMB_RATE)
+                flightPhase = FLIGHT_ASCENT;
+            else if (flightSteady >= FLIGHT_STEADY_TIME)
+                flightPhase = FLIGHT_FLOAT;
+            break;
+
+        case FLIGHT_DESCENT:
+            // Stopped coming down near where we started.  Otherwise it's a float at a lower altitude.
+            if (flightClimbRate > FLIGHT_CLIMB_RATE)
+                flightPhase = FLIGHT_ASCENT;
+            else if (flightSteady >= FLIGHT_STEADY_TIME) {
+                if (gps->altitude < flightLaunchAltitude + FLIGHT_LANDED_HEIGHT)
+                    flightPhase = FLIGHT_LANDED;
+                else
+                    flightPhase = FLIGHT_FLOAT;
+            }
+            break;
+
+        case FLIGHT_LANDED:
+            break;
+    }
+
+    // Direct when high, with some room so we don't flip back and forth at the boundary
+    if (flightPhase == FLIGHT_GROUND || flightPhase == FLIGHT_LANDED)
+        path = FLIGHT_PATH_GROUND;
+    else if (gps->altitude > FLIGHT_DIRECT_ALTITUDE)
+        path = FLIGHT_PATH_DIRECT;
+    else if (flightPath == FLIGHT_PATH_DIRECT && gps->altitude > FLIGHT_DIRECT_ALTITUDE - FLIGHT_PATH_HYSTERESIS)
+        path = FLIGHT_PATH_DIRECT;
+    else
+        path = FLIGHT_PATH_AIR;
+
+    FlightSetPath(path);
+}
+
+/**
+ * Get the current flight phase.
+ *
+ * @return the phase as of the last FlightUpdate()
+ */
+FLIGHT_PHASE FlightGetPhase(void) {
+    return flightPhase;
+}
+
+/**
+ * Get the smoothed climb rate.
+ *
+ * @return climb rate in cm/s, negative coming down
+ */
+int16_t FlightGetClimbRate(void) {
+    return flightClimbRate;
+}
+
+/** @} */
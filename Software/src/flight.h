@@ -0,0 +1,80 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     flight.h                                                  *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+#include "main.h"
+#include "gps.h"
+
+/**
+ * @defgroup flight Flight Phase
+ *
+ * @{
+ */
+
+/// Where we are in the flight
+typedef enum {
+    /// Waiting to be launched
+    FLIGHT_GROUND,
+    /// Climbing
+    FLIGHT_ASCENT,
+    /// Holding altitude
+    FLIGHT_FLOAT,
+    /// Coming down
+    FLIGHT_DESCENT,
+    /// Back on the ground
+    FLIGHT_LANDED
+} FLIGHT_PHASE;
+
+void FlightInit(void); // Start out on the ground
+void FlightUpdate(GPSData * gps); // Track the flight phase and pick the digipeater path
+FLIGHT_PHASE FlightGetPhase(void); // The current flight phase
+int16_t FlightGetClimbRate(void); // Smoothed climb rate in cm/s
+
+/// Climb rate that counts as going up, cm/s
+#define FLIGHT_CLIMB_RATE 100
+/// Climb rate that counts as coming down, cm/s
+#define FLIGHT_SINK_RATE -200
+/// Climb rate close enough to zero to count as holding altitude, cm/s
+#define FLIGHT_STEADY_RATE 50
+/// Height above the launch site that has to be reached before we're flying, cm
+#define FLIGHT_LAUNCH_HEIGHT 10000
+/// Seconds holding altitude before we're floating or landed
+#define FLIGHT_STEADY_TIME 120
+/// Height above the launch site below which holding altitude after a descent counts as landed, cm
+#define FLIGHT_LANDED_HEIGHT 300000
+
+/// Altitude above which digipeaters hear us directly and no path is used, cm
+#define FLIGHT_DIRECT_ALTITUDE 500000
+/// How far below FLIGHT_DIRECT_ALTITUDE to come before using a path again, cm
+#define FLIGHT_PATH_HYSTERESIS 50000
+
+/** @} */
+
+#endif  // #ifndef FLIGHT_H
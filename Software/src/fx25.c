@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include "main.h"
+#include "fx25.h"
+#include "rs.h"
+
+/**
+ * @defgroup fx25 FX.25 Forward Error Correction
+ *
+ * FX.25 wraps an AX.25 packet in a Reed-Solomon code block so a receiver can fix
+ * bit errors in it, while plain AX.25 receivers still find the packet inside.  The
+ * code block's data is the packet's bit stuffed HDLC bit stream, flags and all,
+ * padded out with more flags.  A 64 bit correlation tag ahead of the block tells
+ * the receiver which code follows.
+ *
+ * The check bytes are worked out a byte at a time as the packet is encoded, so the
+ * data block never has to be held in RAM.  The generator's first root is alpha^1,
+ * the same as other FX.25 TNCs.
+ *
+ * @{
+ */
+
+/// Logarithms of the generator polynomial coefficients, (x - a^1)...(x - a^16), highest
+/// power after x^16 first.
+static const uint8_t fx25Generator[16] = {
+    0x79, 0x6a, 0x6e, 0x71, 0x6b, 0xa7, 0x53, 0x0b, 0x64, 0xc9, 0x9e, 0xb5, 0xc3, 0xd0, 0xf0, 0x88
+};
+
+/// Codes with 16 check bytes, smallest first.  Tags 0x04, 0x03, 0x02, and 0x01 of the FX.25 spec.
+static const FX25_CODE fx25Codes[] = {
+    { 32, {0xee, 0x60, 0x96, 0x36, 0xb4, 0x6e, 0x05, 0x8f}},
+    { 64, {0x9e, 0xb0, 0xd9, 0xf3, 0x08, 0x05, 0xdc, 0xc7}},
+    {128, {0xde, 0x8f, 0xcc, 0x00, 0xa6, 0x60, 0xff, 0x26}},
+    {239, {0x3e, 0x2f, 0x53, 0x8a, 0xdf, 0xb7, 0x4d, 0xb7}}
+};
+
+/// Check bytes of the code block so far, the remainder of the data divided by the generator
+static uint8_t fx25Check[FX25_CHECK_BYTES];
+
+/**
+ * Start a new code block.
+ */
+void Fx25Init(void) {
+    uint8_t i;
+
+    for (i = 0; i < FX25_CHECK_BYTES; ++i)
+        fx25Check[i] = 0;
+}
+
+/**
+ * Add the next data byte of the code block to its check bytes.
+ *
+ * @param value data byte, in the order it's sent
+ */
+void Fx25Encode(uint8_t value) {
+    RsEncode(fx25Check, fx25Generator, FX25_CHECK_BYTES, value);
+}
+
+/**
+ * Get the check bytes of the code block.  Send them, first byte first, once all of
+ * the data block has gone through Fx25Encode().
+ *
+ * @return pointer to FX25_CHECK_BYTES check bytes
+ */
+uint8_t * Fx25GetCheckBytes(void) {
+    return fx25Check;
+}
+
+/**
+ * Pick the smallest code whose data block holds the packet.
+ *
+ * @param length bytes of HDLC bit stream to carry, rounded up
+ *
+ * @return the code, or NULL if the packet is too big for any of them
+ */
+const FX25_CODE * Fx25GetCode(uint16_t length) {
+    uint8_t i;
+
+    for (i = 0; i < sizeof(fx25Codes) / sizeof(fx25Codes[0]); ++i)
+        if (length <= fx25Codes[i].dataSize)
+            return &fx25Codes[i];
+
+    return NULL;
+}
+
+/** @} */
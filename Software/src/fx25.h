@@ -0,0 +1,58 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     fx25.h                                                    *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef FX25_H
+#define FX25_H
+
+#include "main.h"
+
+/**
+ * @defgroup fx25 FX.25 Forward Error Correction
+ *
+ * @{
+ */
+
+/// An FX.25 code:  the size of its data block and the correlation tag that announces it
+typedef struct {
+    /// Bytes of HDLC bit stream the code block carries, followed by FX25_CHECK_BYTES
+    uint8_t dataSize;
+    /// Correlation tag, sent LSB first ahead of the code block
+    uint8_t tag[8];
+} FX25_CODE;
+
+void Fx25Init(void); // Start a new code block
+void Fx25Encode(uint8_t value); // Add a data byte to the code block's check bytes
+uint8_t * Fx25GetCheckBytes(void); // Check bytes of the data so far
+const FX25_CODE * Fx25GetCode(uint16_t length); // Smallest code that carries length bytes
+
+/// Reed-Solomon check bytes per code block.  Every code here is a shortened RS(255, 239).
+#define FX25_CHECK_BYTES 16
+
+/** @} */
+
+#endif  // #ifndef FX25_H
@@ -1,7 +1,6 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <math.h>
 #include "gps.h"
 #include "fifo.h"
 #include "serial.h"
@@ -10,37 +9,107 @@
 /**
  *  @defgroup GPS GPS Parsing
  *
+ *  Decodes NMEA sentences a character at a time as they come out of the serial FIFO.
+ *  Each field's value is built up as its digits arrive and stored in a staging copy
+ *  of the GPS data, which replaces the real one when the checksum checks out.  There's
+ *  no sentence buffer and the work is spread evenly over the characters.
+ *
+ *  u-blox receivers can send the UBX NAV-PVT message instead, which has the whole fix
+ *  as binary integers.  It's framed by its own states in the same state machine and
+ *  decoded into the staging copy the same way, 4 bytes at a time.
+ *
  *  @{
  */
 #define MAX_CMD_LEN     8               ///< maximum command length (NMEA address)
 #define MAX_DATA_LEN    128             ///< maximum data length
 #define MAX_CHAN        36              ///< maximum number of channels
 #define WAYPOINT_ID_LEN 32              ///< waypoint max string len
-#define MAXFIELD        25              ///< maximum length of any NMEA field
+#define LOG_CHUNK       16              ///< number of characters written to the log at once
+#define FIELD_COUNT(fields) (sizeof(fields) / sizeof(fields[0])) ///< number of fields in a table
+
+#define UBX_SYNC_CHAR_1     0xb5        ///< first byte of a UBX frame
+#define UBX_SYNC_CHAR_2     0x62        ///< second byte of a UBX frame
+#define UBX_CLASS_NAV       0x01        ///< UBX navigation results class
+#define UBX_ID_NAV_PVT      0x07        ///< UBX position, velocity, and time message
+#define UBX_NAV_PVT_LENGTH  92          ///< payload length of NAV-PVT
+#define UBX_MAX_LENGTH      512         ///< longest UBX payload we'll skip, a longer one is noise
 
 static uint8_t calcChecksum;                // Calculated NMEA sentence checksum
 static uint8_t receivedChecksum;            // Received NMEA sentence checksum (if exists)
-static uint16_t index;                      // Index used for command and data
+static uint16_t index;                      // Index used for command, data, and UBX payload
 static uint8_t commandBuffer[MAX_CMD_LEN];  // NMEA command
-static uint8_t dataBuffer[MAX_DATA_LEN];    // NMEA data
-static uint8_t nmeaBuffer[MAX_DATA_LEN];    // Raw NMEA string
-static uint8_t nmeaIndex;
+static GPS_SENTENCE sentence;               // Sentence being decoded
+static const GPS_FIELD *sentenceFields;     // What each field of the sentence holds
+static uint8_t sentenceFieldCount;          // Number of fields in sentenceFields
+static uint8_t fieldNum;                    // Field being decoded
+static GPS_FIELD fieldType;                 // What the field being decoded holds
+static uint8_t fieldLength;                 // Characters in the field so far
+static int32_t fieldValue;                  // Value of the field so far
+static uint8_t fieldDecimals;               // Decimal places still wanted in fieldValue
+static bool_t fieldPoint;                   // Set once the field's decimal point arrives
+static bool_t fieldNegative;                // Set if the field starts with a minus sign
+static bool_t fieldDone;                    // Set when the rest of the field doesn't matter
+static uint8_t fieldDegrees;                // Degrees of a latitude or longitude field
+static uint8_t fieldDigits;                 // Latitude or longitude digits copied so far
+static uint8_t ubxClass;                    // UBX message class
+static uint8_t ubxId;                       // UBX message ID
+static uint16_t ubxLength;                  // UBX payload length
+static uint8_t ubxCheckA, ubxCheckB;        // UBX Fletcher checksum
+static union {
+    uint8_t bytes[4];
+    int32_t value;
+} ubxField;                                 // Last 4 UBX payload bytes, little endian like the PIC
+static uint8_t logBuffer[LOG_CHUNK];        // Raw NMEA characters waiting to be logged
+static uint8_t logIndex;
 static bool_t dataReadyFlag;                // Flag that is set when a data set has been parsed.
 static GPSData data;                        // GPS data
+static GPSData staging;                     // GPS data from the sentence being decoded
 
 extern FIL logFile;
 
 /// keeps track of the current parse state
-GPS_PARSE_STATE_MACHINE gpsParseState;      
-
-void ProcessCommand(uint8_t *pCommand, uint8_t *pData);
-bool_t GetField(uint8_t *pData, uint8_t *pField, int8_t nFieldNum, int8_t nMaxFieldLen);
-void ProcessGPGGA(uint8_t *pData);
-void ProcessGPRMC(uint8_t *pData);
+GPS_PARSE_STATE_MACHINE gpsParseState;
+
+/// What each field of a GGA sentence holds.  The time and position come from RMC.
+static const GPS_FIELD ggaFields[] = {
+    FIELD_SKIP, FIELD_SKIP, FIELD_SKIP, FIELD_SKIP, FIELD_SKIP, FIELD_SKIP,
+    FIELD_SATS, FIELD_HDOP, FIELD_ALTITUDE
+};
+
+/// What each field of an RMC sentence holds
+static const GPS_FIELD rmcFields[] = {
+    FIELD_TIME, FIELD_STATUS, FIELD_LATITUDE, FIELD_NORTH_SOUTH, FIELD_LONGITUDE,
+    FIELD_EAST_WEST, FIELD_SPEED, FIELD_COURSE, FIELD_DATE
+};
+
+/// What each field of a VTG sentence holds.  The magnetic course and km/h are skipped.
+static const GPS_FIELD vtgFields[] = {
+    FIELD_COURSE, FIELD_SKIP, FIELD_SKIP, FIELD_SKIP, FIELD_SPEED
+};
+
+/// What each field of a ZDA sentence holds.  The local time zone is skipped.
+static const GPS_FIELD zdaFields[] = {
+    FIELD_TIME, FIELD_DAY, FIELD_MONTH, FIELD_YEAR
+};
+
+void ProcessCommand(uint8_t *pCommand);
+void FieldStart(void);
+void FieldChar(uint8_t value);
+void FieldEnd(void);
+void FieldNumber(uint8_t value);
+void FieldPair(uint8_t value);
+void FieldDigit(uint8_t value, char *pDigits, uint8_t nDegrees);
+void FieldDigitsEnd(char *pDigits, uint8_t nDegrees);
+void FieldPosition(int32_t *pPosition, uint8_t nDegrees);
+void FieldPad(void);
+void CommitSentence(void);
+void UbxChecksum(uint8_t value);
+void UbxField(uint8_t value);
+void LogChar(uint8_t value);
 
 /**
  * Gets a pointer to the GPS data structure
- * 
+ *
  * @return pointer to the GPSData structure
  */
 GPSData * GpsGetData() {
@@ -63,20 +132,29 @@ bool_t GpsIsDataReady() {
 }
 
 /**
- *   Read the serial FIFO and process complete GPS messages.
+ *   Read the serial FIFO and decode the GPS messages.
  */
 void GpsUpdate() {
     uint8_t value;
 
+    // The FIFO overran.  The sentence being decoded and anything up to the gap are
+    // missing bytes, and what's after the gap is the middle of another one, so drop
+    // them and wait for the next '$' or UBX sync rather than splice the two together.
+    if (FifoOverflow()) {
+        FifoSkipToGap();
+        gpsParseState = STARTOFMESSAGE;
+    }
+
     while (FifoHasData()) {
         value = FifoRead();
-        nmeaBuffer[nmeaIndex] = value;
-        if (nmeaIndex < (MAX_DATA_LEN - 1))
-            nmeaIndex++;
+        LogChar(value);
 
-        // This state machine handles each character as it is read from the GPS serial port.
+        // A '$' always starts a new sentence, so a garbled one can't take the next one with it.
+        // UBX frames are binary and can hold any byte once past the two sync characters.
+        if (value == '$' && gpsParseState <= UBX_SYNC)
+            gpsParseState = STARTOFMESSAGE;
 
-        //this->gpsBuffer[this->gpsIndex++] = value;
+        // This state machine handles each character as it is read from the GPS serial port.
         switch (gpsParseState) {
             ///////////////////////////////////////////////////////////////////////
             // Search for start of message '$'
@@ -84,10 +162,9 @@ void GpsUpdate() {
                 if (value == '$') {
                     calcChecksum = 0; // reset checksum
                     index = 0; // reset index
-                    nmeaIndex = 0;
-                    nmeaBuffer[nmeaIndex++] = value;
                     gpsParseState = COMMAND;
-                }
+                } else if (value == UBX_SYNC_CHAR_1)
+                    gpsParseState = UBX_SYNC;
                 break;
 
                 ///////////////////////////////////////////////////////////////////////
@@ -104,30 +181,46 @@ void GpsUpdate() {
                     commandBuffer[index] = '\0'; // terminate command
                     calcChecksum ^= value;
                     index = 0;
+                    ProcessCommand(commandBuffer);
+
+                    // Only decode the sentences we use
+                    if (sentence == SENTENCE_NONE || value == '*') {
+                        gpsParseState = STARTOFMESSAGE;
+                        break;
+                    }
+
+                    fieldNum = 0;
+                    FieldStart();
                     gpsParseState = DATA; // goto get data state
                 }
                 break;
 
-                // Store data and check for end of sentence or checksum flag
+                // Decode data and check for end of sentence or checksum flag
             case DATA:
                 if (value == '*') { // checksum flag?
-                    dataBuffer[index] = '\0';
+                    FieldEnd();
                     gpsParseState = CHECKSUM_1;
                 } else {
                     // Check for end of sentence with no checksum
                     if (value == '\r') {
-                        dataBuffer[index] = '\0';
-                        ProcessCommand(commandBuffer, dataBuffer);
+                        FieldEnd();
+                        CommitSentence();
                         gpsParseState = STARTOFMESSAGE;
                         return;
                     }
 
                     //
-                    // Store data and calculate checksum
+                    // Decode data and calculate checksum
                     //
                     calcChecksum ^= value;
-                    dataBuffer[index] = value;
-                    if (++index >= MAX_DATA_LEN) // Check for buffer overflow
+                    if (value == ',') {
+                        FieldEnd();
+                        ++fieldNum;
+                        FieldStart();
+                    } else
+                        FieldChar(value);
+
+                    if (++index >= MAX_DATA_LEN) // Check for a sentence that's too long
                         gpsParseState = STARTOFMESSAGE;
                 }
                 break;
@@ -148,12 +241,84 @@ void GpsUpdate() {
                     receivedChecksum |= (value - 'A' + 10);
 
                 if (calcChecksum == receivedChecksum)
-                    ProcessCommand(commandBuffer, dataBuffer);
+                    CommitSentence();
 
                 gpsParseState = STARTOFMESSAGE;
                 printf("OK secs: %d\r\n", data.seconds);
                 break;
 
+                ///////////////////////////////////////////////////////////////////////
+                // UBX frame, sync bytes, class, ID, length, payload, and checksum
+            case UBX_SYNC:
+                if (value == UBX_SYNC_CHAR_2) {
+                    ubxCheckA = 0;
+                    ubxCheckB = 0;
+                    gpsParseState = UBX_CLASS;
+                } else
+                    gpsParseState = STARTOFMESSAGE;
+                break;
+
+            case UBX_CLASS:
+                UbxChecksum(value);
+                ubxClass = value;
+                gpsParseState = UBX_ID;
+                break;
+
+            case UBX_ID:
+                UbxChecksum(value);
+                ubxId = value;
+                gpsParseState = UBX_LENGTH_1;
+                break;
+
+            case UBX_LENGTH_1:
+                UbxChecksum(value);
+                ubxLength = value;
+                gpsParseState = UBX_LENGTH_2;
+                break;
+
+            case UBX_LENGTH_2:
+                UbxChecksum(value);
+                ubxLength |= (uint16_t) value << 8;
+                index = 0;
+
+                if (ubxLength > UBX_MAX_LENGTH) {
+                    gpsParseState = STARTOFMESSAGE;
+                    break;
+                }
+
+                // Only decode the messages we use, skip the rest
+                if (ubxClass == UBX_CLASS_NAV && ubxId == UBX_ID_NAV_PVT && ubxLength == UBX_NAV_PVT_LENGTH) {
+                    sentence = SENTENCE_NAV_PVT;
+                    staging = data;
+                } else
+                    sentence = SENTENCE_NONE;
+
+                gpsParseState = (ubxLength == 0 ? UBX_CHECKSUM_1 : UBX_PAYLOAD);
+                break;
+
+            case UBX_PAYLOAD:
+                UbxChecksum(value);
+                if (sentence == SENTENCE_NAV_PVT)
+                    UbxField(value);
+
+                if (++index == ubxLength)
+                    gpsParseState = UBX_CHECKSUM_1;
+                break;
+
+            case UBX_CHECKSUM_1:
+                if (value == ubxCheckA)
+                    gpsParseState = UBX_CHECKSUM_2;
+                else
+                    gpsParseState = STARTOFMESSAGE;
+                break;
+
+            case UBX_CHECKSUM_2:
+                if (value == ubxCheckB && sentence != SENTENCE_NONE)
+                    CommitSentence();
+
+                gpsParseState = STARTOFMESSAGE;
+                break;
+
                 ///////////////////////////////////////////////////////////////////////
             default:
                 gpsParseState = STARTOFMESSAGE;
@@ -163,302 +328,501 @@ void GpsUpdate() {
 }
 
 /**
- * Process NMEA sentence - switch on the NMEA command and call the
- * appropriate processor
+ * Add a character from the GPS to the log file.  The characters are written in chunks
+ * to keep the overhead of f_write() down.
  *
- * @param pCommand string containing the command in question
- * @param pData string containing the data associated with the command
+ * @param value character from the GPS
  */
-void ProcessCommand(uint8_t *pCommand, uint8_t *pData) {
+void LogChar(uint8_t value) {
     FRESULT res;
     UINT bytesWritten;
 
-    // log the string
-    nmeaBuffer[nmeaIndex++] = '\r';
-    nmeaBuffer[nmeaIndex++] = '\n';
-    res = f_write(&logFile, nmeaBuffer, nmeaIndex, &bytesWritten);
-    if (res || bytesWritten < nmeaIndex)
+    logBuffer[logIndex++] = value;
+    if (logIndex < LOG_CHUNK)
+        return;
+
+    res = f_write(&logFile, logBuffer, LOG_CHUNK, &bytesWritten);
+    if (res || bytesWritten < LOG_CHUNK)
         printf("Failed to log nmea: %d\r\n", res);
 
-    /*
-     * GPGGA
-     */
-    if (!strcmp((char *) pCommand, "GPGGA"))
-        ProcessGPGGA(pData);
-
-    /*
-     * GPRMC
-     */
-    else if (!strcmp((char *) pCommand, "GPRMC"))
-        ProcessGPRMC(pData);
+    logIndex = 0;
 }
 
 /**
- * This function will get the specified field in a NMEA string.
+ * Switch on the NMEA command and get ready to decode the sentence.  The command is a
+ * two letter talker ID, GP for GPS, GL for GLONASS, GN for a mix of them, and so on,
+ * then the three letter sentence type.  Only the type matters, so any receiver works.
  *
- * @param pData Pointer to NMEA string
- * @param pField Pointer to returned field
- * @param nFieldNum Field offset to get
- * @param nMaxFieldLen Maximum number of bytes pField can handle
+ * @param pCommand string containing the command in question
  */
-bool_t GetField(uint8_t *pData, uint8_t *pField, int8_t nFieldNum, int8_t nMaxFieldLen) {
-    /*
-     * Validate params
-     */
-    if (pData == NULL || pField == NULL || nMaxFieldLen <= 0) {
-        return FALSE;
-    }
+void ProcessCommand(uint8_t *pCommand) {
+    sentence = SENTENCE_NONE;
+
+    if (strlen((char *) pCommand) != 5)
+        return;
+
+    // The first letter of the type is enough to tell the ones we use apart
+    switch (pCommand[2]) {
+        case 'G':
+            if (pCommand[3] == 'G' && pCommand[4] == 'A') {
+                sentence = SENTENCE_GGA;
+                sentenceFields = ggaFields;
+                sentenceFieldCount = FIELD_COUNT(ggaFields);
+            }
+            break;
 
-    /*
-     * Go to the beginning of the selected field
-     */
-    int i = 0;
-    int nField = 0;
-    while (nField != nFieldNum && pData[i]) {
-        if (pData[i] == ',') {
-            nField++;
-        }
+        case 'R':
+            if (pCommand[3] == 'M' && pCommand[4] == 'C') {
+                sentence = SENTENCE_RMC;
+                sentenceFields = rmcFields;
+                sentenceFieldCount = FIELD_COUNT(rmcFields);
+            }
+            break;
 
-        i++;
+        case 'V':
+            if (pCommand[3] == 'T' && pCommand[4] == 'G') {
+                sentence = SENTENCE_VTG;
+                sentenceFields = vtgFields;
+                sentenceFieldCount = FIELD_COUNT(vtgFields);
+            }
+            break;
 
-        if (pData[i] == NULL) {
-            pField[0] = '\0';
-            return FALSE;
-        }
+        case 'Z':
+            if (pCommand[3] == 'D' && pCommand[4] == 'A') {
+                sentence = SENTENCE_ZDA;
+                sentenceFields = zdaFields;
+                sentenceFieldCount = FIELD_COUNT(zdaFields);
+            }
+            break;
     }
 
-    if (pData[i] == ',' || pData[i] == '*') {
-        pField[0] = '\0';
-        return FALSE;
-    }
+    if (sentence == SENTENCE_NONE)
+        return;
 
-    /*
-     * copy field from pData to Field
-     */
-    int i2 = 0;
-    while (pData[i] != ',' && pData[i] != '*' && pData[i]) {
-        pField[i2] = pData[i];
-        i2++;
-        i++;
-
-        /*
-         * check if field is too big to fit on passed parameter. If it is,
-         * crop returned field to its max length.
-         */
-        if (i2 >= nMaxFieldLen) {
-            i2 = nMaxFieldLen - 1;
-            break;
-        }
+    // Decode into a copy, so a sentence that fails its checksum doesn't change anything
+    staging = data;
+
+    // An RMC or VTG without a speed or course means we're not moving
+    if (sentence == SENTENCE_RMC || sentence == SENTENCE_VTG) {
+        staging.speed = 0;
+        staging.heading = 0;
     }
-    pField[i2] = '\0';
+}
+
+/**
+ * Keep the data from a sentence that was received intact.
+ */
+void CommitSentence(void) {
+    data = staging;
 
-    return TRUE;
+    // Set the data-ready flag.
+    if (sentence == SENTENCE_GGA || sentence == SENTENCE_NAV_PVT)
+        dataReadyFlag = TRUE;
 }
 
 /**
- * Parses an NMEA $GPGGA packet and inserts the data into the GPSData structure
+ * Add a byte to the UBX checksum, an 8 bit Fletcher sum of the class through the payload.
  *
- * @param pData string containing the data associated with a GPGGA packet
+ * @param value byte from the GPS
  */
-void ProcessGPGGA(uint8_t *pData) {
-    uint8_t pField[MAXFIELD];
-    char pBuff[10];
-
-    // Time (currently not used)
-    /*if (GetField(pData, pField, 0, MAXFIELD)) {
-        // Hour
-        pBuff[0] = pField[0];
-        pBuff[1] = pField[1];
-        pBuff[2] = '\0';
-        data.hours = atoi(pBuff);
-
-        // minute
-        pBuff[0] = pField[2];
-        pBuff[1] = pField[3];
-        pBuff[2] = '\0';
-        data.minutes = atoi(pBuff);
-
-        // Second
-        pBuff[0] = pField[4];
-        pBuff[1] = pField[5];
-        pBuff[2] = '\0';
-        data.seconds = atoi(pBuff);
-    } */
-
-    // Latitude (currently not used)
-    /*if (GetField(pData, pField, 1, MAXFIELD)) {
-        data.latitude = lroundf(10000000 * atof((char *) pField + 2) / 60.0);
-        pField[2] = '\0';
-        data.latitude += lroundf(10000000 * atof((char *) pField));
+void UbxChecksum(uint8_t value) {
+    ubxCheckA += value;
+    ubxCheckB += ubxCheckA;
+}
 
-    }
-    if (GetField(pData, pField, 2, MAXFIELD)) {
-        if (pField[0] == 'S')
-            data.latitude = -data.latitude;
-    }
+/**
+ * Decode the next byte of a NAV-PVT payload.  The fields we use all fill whole 4 byte
+ * words, so the bytes are collected in ubxField and stored as each word is finished.
+ *
+ * @param value byte from the GPS
+ */
+void UbxField(uint8_t value) {
+    ubxField.bytes[index & 3] = value;
+
+    switch (index) {
+        case 7:
+            // year, month, day
+            staging.year = ubxField.bytes[0] | ((uint16_t) ubxField.bytes[1] << 8);
+            staging.month = ubxField.bytes[2];
+            staging.day = ubxField.bytes[3];
+            break;
 
-    // Longitude (currently not used)
-    if (GetField(pData, pField, 3, MAXFIELD)) {
-        data.longitude = lroundf(10000000 * atof((char *) pField + 3) / 60.0);
-        pField[3] = '\0';
-        data.longitude += lroundf(10000000 * atof((char *) pField));
-    }
-    if (GetField(pData, pField, 4, MAXFIELD)) {
-        if (pField[0] == 'W')
-            data.longitude = -data.longitude;
-    } */
-
-    // Satellites in use
-    if (GetField(pData, pField, 6, MAXFIELD)) {
-        pBuff[0] = pField[0];
-        pBuff[1] = pField[1];
-        pBuff[2] = '\0';
-        data.trackedSats = atoi(pBuff);
-    }
+        case 11:
+            // hour, minute, second, and validity flags
+            if (ubxField.bytes[3] & 0x02) {
+                staging.hours = ubxField.bytes[0];
+                staging.minutes = ubxField.bytes[1];
+                staging.seconds = ubxField.bytes[2];
+            }
+
+            // Keep the last date until the receiver knows it
+            if ((ubxField.bytes[3] & 0x01) == 0) {
+                staging.year = data.year;
+                staging.month = data.month;
+                staging.day = data.day;
+            }
+            break;
 
-    // HDOP
-    if (GetField(pData, pField, 7, MAXFIELD)) {
-        data.dop = (uint16_t)round(atof((char *) pField) * 10);
+        case 23:
+            // fix type, flags, more flags, satellites used
+            if ((ubxField.bytes[1] & 0x01) == 0)
+                staging.fixType = NoFix;
+            else if (ubxField.bytes[0] == 2)
+                staging.fixType = Fix2D;
+            else if (ubxField.bytes[0] == 3 || ubxField.bytes[0] == 4)
+                staging.fixType = Fix3D;
+            else
+                staging.fixType = NoFix;
+
+            staging.trackedSats = ubxField.bytes[3];
+            break;
+
+        case 27:
+            // longitude in degrees * 10 ^ 7, the units we use.  There are no NMEA digits
+            // for Mic-E, so it falls back on the degrees.
+            staging.longitude = ubxField.value;
+            staging.longitudeDigits[0] = 0;
+            break;
+
+        case 31:
+            staging.latitude = ubxField.value;
+            staging.latitudeDigits[0] = 0;
+            break;
+
+        case 39:
+            // height above mean sea level, mm to cm
+            staging.altitude = (ubxField.value + (ubxField.value < 0 ? -5 : 5)) / 10;
+            break;
+
+        case 63:
+            // ground speed, mm/s to knots * 10 is * 36 / 1852, or * 9 / 463
+            staging.speed = (uint16_t) ((ubxField.value * 9 + 231) / 463);
+            break;
+
+        case 67:
+            // heading of motion, 0.00001 degrees to 0.01 degrees
+            staging.heading = (uint16_t) ((ubxField.value + 500) / 1000);
+            break;
+
+        case 79:
+            // position DOP in units of 0.01, to 0.1 like the HDOP from GGA
+            staging.dop = ((ubxField.bytes[0] | ((uint16_t) ubxField.bytes[1] << 8)) + 5) / 10;
+            break;
     }
+}
+
+/**
+ * Get ready to decode the next field of the sentence.
+ */
+void FieldStart(void) {
+    if (fieldNum < sentenceFieldCount)
+        fieldType = sentenceFields[fieldNum];
+    else
+        fieldType = FIELD_SKIP;
+
+    // Number of decimal places kept for each kind of number
+    switch (fieldType) {
+        case FIELD_LATITUDE:
+        case FIELD_LONGITUDE:
+            // Minutes in units of 0.00001
+            fieldDecimals = 5;
+            break;
+
+        case FIELD_SPEED:
+        case FIELD_HDOP:
+            fieldDecimals = 1;
+            break;
 
-    // Altitude
-    if (GetField(pData, pField, 8, MAXFIELD)) {
-        data.altitude = (int32_t)round(atof((char *) pField) * 100);
+        case FIELD_COURSE:
+        case FIELD_ALTITUDE:
+            fieldDecimals = 2;
+            break;
+
+        default:
+            fieldDecimals = 0;
+            break;
     }
 
-    // Set the data-ready flag.
-    dataReadyFlag = TRUE;
+    fieldLength = 0;
+    fieldValue = 0;
+    fieldPoint = FALSE;
+    fieldNegative = FALSE;
+    fieldDone = FALSE;
+    fieldDegrees = 0;
+    fieldDigits = 0;
 }
 
 /**
- * Parses an NMEA $GPRMC packet and inserts the data into the GPSData structure
+ * Decode the next character of a field.
  *
- * @param pData string containing the data associated with a GPRMC packet
+ * @param value character from the GPS
  */
-void ProcessGPRMC(uint8_t *pData)
-{
-    char pBuff[10];
-    uint8_t pField[MAXFIELD];
-
-    // Time
-    if(GetField(pData, pField, 0, MAXFIELD))
-    {
-        // Hour
-        pBuff[0] = pField[0];
-        pBuff[1] = pField[1];
-        pBuff[2] = '\0';
-        data.hours = atoi(pBuff);
-
-        // minute
-        pBuff[0] = pField[2];
-        pBuff[1] = pField[3];
-        pBuff[2] = '\0';
-        data.minutes = atoi(pBuff);
-
-        // Second
-        pBuff[0] = pField[4];
-        pBuff[1] = pField[5];
-        pBuff[2] = '\0';
-        data.seconds = atoi(pBuff);
+void FieldChar(uint8_t value) {
+    ++fieldLength;
+
+    switch (fieldType) {
+        case FIELD_SKIP:
+            break;
+
+        case FIELD_STATUS:
+        case FIELD_NORTH_SOUTH:
+        case FIELD_EAST_WEST:
+            // The first letter is all that matters
+            if (fieldLength == 1)
+                fieldValue = value;
+            break;
+
+        case FIELD_TIME:
+        case FIELD_DATE:
+            FieldPair(value);
+            break;
+
+        case FIELD_LATITUDE:
+            // DDMM.mmmm
+            FieldDigit(value, staging.latitudeDigits, 2);
+            if (fieldLength == 3) {
+                fieldDegrees = (uint8_t) fieldValue;
+                fieldValue = 0;
+            }
+            FieldNumber(value);
+            break;
+
+        case FIELD_LONGITUDE:
+            // DDDMM.mmmm
+            FieldDigit(value, staging.longitudeDigits, 3);
+            if (fieldLength == 4) {
+                fieldDegrees = (uint8_t) fieldValue;
+                fieldValue = 0;
+            }
+            FieldNumber(value);
+            break;
+
+        default:
+            FieldNumber(value);
+            break;
     }
+}
 
-    //
-    // Data valid
-    //
-    if(GetField(pData, pField, 1, MAXFIELD)) {
-        if(pField[0] == 'A') {
-            if(data.altitude > 0)
-                data.fixType = Fix3D;
-            else
-                data.fixType = Fix2D;
+/**
+ * Add the next character of a decimal field to fieldValue, without the floating point
+ * library.  Decimal places past the ones wanted are rounded off, half away from zero.
+ *
+ * @param value character from the GPS
+ */
+void FieldNumber(uint8_t value) {
+    if (fieldDone)
+        return;
+
+    if (value == '-' && fieldLength == 1)
+        fieldNegative = TRUE;
+    else if (value == '.' && !fieldPoint)
+        fieldPoint = TRUE;
+    else if (value >= '0' && value <= '9') {
+        if (fieldPoint) {
+            if (fieldDecimals == 0) {
+                if (value >= '5')
+                    ++fieldValue;
+                fieldDone = TRUE;
+                return;
+            }
+            --fieldDecimals;
         }
+        fieldValue = fieldValue * 10 + (value - '0');
+    } else
+        fieldDone = TRUE;
+}
+
+/**
+ * Decode the next character of a field made of 2 digit numbers, HHMMSS or DDMMYY.  Each
+ * number is stored as soon as its second digit arrives.
+ *
+ * @param value character from the GPS
+ */
+void FieldPair(uint8_t value) {
+    uint8_t pair;
+
+    if (fieldLength > 6)
+        return;
+
+    if (value >= '0' && value <= '9')
+        fieldValue = fieldValue * 10 + (value - '0');
+
+    if (fieldLength & 1)
+        return;
+
+    pair = (uint8_t) fieldValue;
+    fieldValue = 0;
+
+    if (fieldType == FIELD_TIME) {
+        if (fieldLength == 2)
+            staging.hours = pair;
+        else if (fieldLength == 4)
+            staging.minutes = pair;
+        else
+            staging.seconds = pair;
+    } else {
+        if (fieldLength == 2)
+            staging.day = pair;
+        else if (fieldLength == 4)
+            staging.month = pair;
         else
-            data.fixType = NoFix;
+            staging.year = 2000 + pair; // Year (Only two digits. I wonder why?)
     }
+}
 
-    //
-    // latitude
-    //
-    if(GetField(pData, pField, 2, MAXFIELD))
-    {
-        data.latitude = (int32_t)round(10000000 * atof((char *) pField + 2) / 60.0);
-        pField[2] = '\0';
-        data.latitude += (int32_t)(10000000 * atol((char *) pField));
+/**
+ * Copy the degrees, minutes, and hundredths of minutes of a latitude or longitude
+ * field as they arrive, for Mic-E.  The rest is truncated.
+ *
+ * @param value character from the GPS
+ * @param pDigits filled with nDegrees + 4 digits
+ * @param nDegrees number of degree digits, 2 or 3
+ */
+void FieldDigit(uint8_t value, char *pDigits, uint8_t nDegrees) {
+    bool_t digit;
 
-    }
-    if(GetField(pData, pField, 3, MAXFIELD))
-    {
-        if(pField[0] == 'S')
-        {
-            data.latitude = -data.latitude;
-        }
-    }
+    digit = (value >= '0' && value <= '9');
 
-    //
-    // Longitude
-    //
-    if(GetField(pData, pField, 4, MAXFIELD))
-    {
-        data.longitude = (int32_t)round(10000000 * atof((char *)pField+3) / 60.0);
-        pField[3] = '\0';
-        data.longitude += (int32_t)(10000000 * atol((char *)pField));
-    }
-    if(GetField(pData, pField, 5, MAXFIELD))
-    {
-        if(pField[0] == 'W')
-        {
-            data.longitude = -data.longitude;
-        }
+    if (fieldDigits < nDegrees + 2) {
+        // Degrees and whole minutes, all digits or the field is no use
+        if (digit)
+            pDigits[fieldDigits++] = value;
+        else
+            fieldDigits = 0xff;
+    } else if (fieldDigits < nDegrees + 4) {
+        if (digit)
+            pDigits[fieldDigits++] = value;
+        else if (value != '.' || fieldLength != nDegrees + 3)
+            FieldDigitsEnd(pDigits, nDegrees);
     }
+}
 
-    //
-    // Ground speed
-    //
-    if(GetField(pData, pField, 6, MAXFIELD))
-    {   // store as knots * 10
-        data.speed = (int16_t)round(10 * atof((char *)pField));
-    }
-    else
-    {
-        data.speed = 0;
+/**
+ * Finish copying the digits of a latitude or longitude field.  Missing decimal places
+ * are zeros.
+ *
+ * @param pDigits filled with nDegrees + 4 digits
+ * @param nDegrees number of degree digits, 2 or 3
+ */
+void FieldDigitsEnd(char *pDigits, uint8_t nDegrees) {
+    if (fieldDigits < nDegrees + 2 || fieldDigits == 0xff) {
+        // Not a position we can use, MicEEncode() will fall back on the degrees
+        pDigits[0] = 0;
+        return;
     }
 
-    //
-    // course over ground, degrees true converted 0.01 degree
-    //
-    if(GetField(pData, pField, 7, MAXFIELD))
-    {
-        data.heading = (int16_t)round(100 * atof((char *)pField));
-    }
-    else
-    {
-        data.heading = 0;
-    }
+    while (fieldDigits < nDegrees + 4)
+        pDigits[fieldDigits++] = '0';
+}
 
-    //
-    // Date
-    //
-    if(GetField(pData, pField, 8, MAXFIELD))
-    {
-        // Day
-        pBuff[0] = pField[0];
-        pBuff[1] = pField[1];
-        pBuff[2] = '\0';
-        data.day = atoi(pBuff);
-
-        // Month
-        pBuff[0] = pField[2];
-        pBuff[1] = pField[3];
-        pBuff[2] = '\0';
-        data.month = atoi(pBuff);
-
-        // Year (Only two digits. I wonder why?)
-        pBuff[0] = pField[4];
-        pBuff[1] = pField[5];
-        pBuff[2] = '\0';
-        data.year = atoi(pBuff);
-        data.year += 2000;             // make 4 digit date
+/**
+ * Convert a decoded latitude or longitude field to degrees * 10 ^ 7.
+ *
+ * @param pPosition set to the position
+ * @param nDegrees number of degree digits, 2 or 3
+ */
+void FieldPosition(int32_t *pPosition, uint8_t nDegrees) {
+    // A field too short to have minutes is all degrees
+    if (fieldLength <= nDegrees) {
+        fieldDegrees = (uint8_t) fieldValue;
+        fieldValue = 0;
+    } else
+        FieldPad();
+
+    // Minutes in units of 0.00001 to degrees * 10 ^ 7 is * 5 / 3, rounded
+    *pPosition = fieldDegrees * 10000000L + (fieldValue * 10 + 3) / 6;
+}
+
+/**
+ * Fill in the decimal places a number field didn't have with zeros.
+ */
+void FieldPad(void) {
+    for (; fieldDecimals != 0; --fieldDecimals)
+        fieldValue *= 10;
+}
+
+/**
+ * Store a field once all of it has arrived.
+ */
+void FieldEnd(void) {
+    // Empty fields don't change anything
+    if (fieldLength == 0)
+        return;
+
+    if (fieldNegative)
+        fieldValue = -fieldValue;
+
+    if (fieldType != FIELD_LATITUDE && fieldType != FIELD_LONGITUDE)
+        FieldPad();
+
+    switch (fieldType) {
+        case FIELD_STATUS:
+            if (fieldValue == 'A') {
+                if (staging.altitude > 0)
+                    staging.fixType = Fix3D;
+                else
+                    staging.fixType = Fix2D;
+            } else
+                staging.fixType = NoFix;
+            break;
+
+        case FIELD_LATITUDE:
+            FieldDigitsEnd(staging.latitudeDigits, 2);
+            FieldPosition(&staging.latitude, 2);
+            break;
+
+        case FIELD_NORTH_SOUTH:
+            if (fieldValue == 'S')
+                staging.latitude = -staging.latitude;
+            break;
+
+        case FIELD_LONGITUDE:
+            FieldDigitsEnd(staging.longitudeDigits, 3);
+            FieldPosition(&staging.longitude, 3);
+            break;
+
+        case FIELD_EAST_WEST:
+            if (fieldValue == 'W')
+                staging.longitude = -staging.longitude;
+            break;
+
+        case FIELD_SPEED:
+            // store as knots * 10
+            staging.speed = (uint16_t) fieldValue;
+            break;
+
+        case FIELD_COURSE:
+            // course over ground, degrees true converted 0.01 degree
+            staging.heading = (uint16_t) fieldValue;
+            break;
+
+        case FIELD_SATS:
+            staging.trackedSats = (uint16_t) fieldValue;
+            break;
+
+        case FIELD_HDOP:
+            staging.dop = (uint16_t) fieldValue;
+            break;
+
+        case FIELD_ALTITUDE:
+            staging.altitude = fieldValue;
+            break;
+
+        case FIELD_DAY:
+            staging.day = (uint8_t) fieldValue;
+            break;
+
+        case FIELD_MONTH:
+            staging.month = (uint8_t) fieldValue;
+            break;
+
+        case FIELD_YEAR:
+            staging.year = (uint16_t) fieldValue;
+            break;
+
+        default:
+            break;
     }
 }
 
-/** @} */
\ No newline at end of file
+/** @} */
@@ -75,6 +75,13 @@ typedef struct GPSData {
     /// Longitude in degrees * 10 ^ 7, where + is East, - is West.
     int32_t longitude;
 
+    /// Latitude digits as the GPS sent them, degrees, minutes, and hundredths of minutes
+    /// (DDMMmm).  Zeroed if the GPS doesn't send digits.
+    char latitudeDigits[6];
+
+    /// Longitude digits as the GPS sent them (DDDMMmm).
+    char longitudeDigits[7];
+
     /// Altitude from MSL in cm.
     int32_t altitude;
 
@@ -100,13 +107,57 @@ typedef struct GPSData {
     uint8_t timeToFirstFix;
 } GPSData;
 
-/// enumeration of the NMEA parser's states
+/// NMEA sentences the parser decodes
+typedef enum {
+    /// A sentence we don't use, skipped
+    SENTENCE_NONE,
+    /// GGA, satellites, HDOP, and altitude
+    SENTENCE_GGA,
+    /// RMC, time, date, position, speed, and course
+    SENTENCE_RMC,
+    /// VTG, speed and course
+    SENTENCE_VTG,
+    /// ZDA, time and date with a four digit year
+    SENTENCE_ZDA,
+    /// UBX NAV-PVT, the whole fix in binary
+    SENTENCE_NAV_PVT
+} GPS_SENTENCE;
+
+/// What an NMEA field holds, so the parser knows how to decode it as it arrives
+typedef enum {
+    FIELD_SKIP,
+    FIELD_TIME,
+    FIELD_DATE,
+    FIELD_DAY,
+    FIELD_MONTH,
+    FIELD_YEAR,
+    FIELD_STATUS,
+    FIELD_LATITUDE,
+    FIELD_NORTH_SOUTH,
+    FIELD_LONGITUDE,
+    FIELD_EAST_WEST,
+    FIELD_SPEED,
+    FIELD_COURSE,
+    FIELD_SATS,
+    FIELD_HDOP,
+    FIELD_ALTITUDE
+} GPS_FIELD;
+
+/// enumeration of the NMEA parser's states.  The UBX states come last.
 typedef enum {
     STARTOFMESSAGE,
     COMMAND,
     DATA,
     CHECKSUM_1,
-    CHECKSUM_2
+    CHECKSUM_2,
+    UBX_SYNC,
+    UBX_CLASS,
+    UBX_ID,
+    UBX_LENGTH_1,
+    UBX_LENGTH_2,
+    UBX_PAYLOAD,
+    UBX_CHECKSUM_1,
+    UBX_CHECKSUM_2
 } GPS_PARSE_STATE_MACHINE;
 
 
@@ -0,0 +1,207 @@
+#include "main.h"
+#include "il2p.h"
+#include "rs.h"
+
+/**
+ * @defgroup il2p IL2P Framing
+ *
+ * IL2P (Improved Layer 2 Protocol) carries an AX.25 packet without bit stuffing,
+ * flags, or NRZI.  A 24 bit sync word is followed by a 13 byte header with 2
+ * Reed-Solomon check bytes, then the payload with 16 check bytes per block.  The
+ * header and each payload block are scrambled on their own with x^9 + x^4 + 1
+ * before their check bytes are worked out, so long runs of the same bit don't
+ * reach the modulator.  Everything goes out MSB first.
+ *
+ * Only the transparent (type 0) header is used:  the payload is the whole AX.25
+ * packet less its CRC.  The compact type 1 header has no room for a digipeater path,
+ * and every packet we send has one.
+ *
+ * The Reed-Solomon codes are the same field as FX.25 but the generators' first root
+ * is alpha^0.
+ *
+ * @{
+ */
+
+/// Logarithms of the header generator polynomial coefficients, (x - a^0)(x - a^1)
+static const uint8_t il2pHeaderGenerator[2] = {25, 1};
+
+/// Logarithms of the payload generator polynomial coefficients, (x - a^0)...(x - a^15),
+/// highest power after x^16 first.
+static const uint8_t il2pPayloadGenerator[IL2P_CHECK_BYTES] = {
+    120, 104, 107, 109, 102, 161, 76, 3, 91, 191, 147, 169, 182, 194, 225, 120
+};
+
+/// Scrambler shift register, and the number of its first outputs left to drop
+static uint16_t il2pScrambler;
+static uint8_t il2pSkip;
+
+/// Scrambled bits being collected into a byte, MSB first, and how many there are
+static uint8_t il2pOut, il2pOutBits;
+
+/// Check bytes of the payload block so far
+static uint8_t il2pCheck[IL2P_CHECK_BYTES];
+
+/**
+ * Start scrambling a new block.  The scrambler's output runs 5 bits behind its input,
+ * so the first 5 are dropped and the block is flushed with zeros at the end.
+ */
+static void Il2pScramblerStart(void) {
+    il2pScrambler = 0x00f;
+    il2pSkip = 5;
+    il2pOutBits = 0;
+}
+
+/**
+ * Scramble one bit.
+ *
+ * @param bit bit of the block, 0 or 1
+ * @param out set to the scrambled byte when one is complete
+ *
+ * @return true if a scrambled byte is complete
+ */
+static bool_t Il2pScrambleBit(uint8_t bit, uint8_t *out) {
+    uint8_t scrambled;
+
+    scrambled = ((il2pScrambler >> 4) ^ il2pScrambler) & 0x01;
+    il2pScrambler = ((((bit ^ il2pScrambler) & 0x01) << 9) | (il2pScrambler ^ ((il2pScrambler & 0x01) << 4))) >> 1;
+
+    if (il2pSkip != 0) {
+        --il2pSkip;
+        return FALSE;
+    }
+
+    il2pOut = (il2pOut << 1) | scrambled;
+    if (++il2pOutBits != 8)
+        return FALSE;
+
+    il2pOutBits = 0;
+    *out = il2pOut;
+    return TRUE;
+}
+
+/**
+ * Scramble a byte, MSB first.  A byte in completes at most one byte out.
+ *
+ * @param value byte of the block
+ * @param out set to the scrambled byte when one is complete
+ *
+ * @return true if a scrambled byte is complete
+ */
+static bool_t Il2pScrambleByte(uint8_t value, uint8_t *out) {
+    uint8_t i;
+    bool_t ready;
+
+    ready = FALSE;
+    for (i = 0; i < 8; ++i) {
+        if (Il2pScrambleBit(value >> 7, out))
+            ready = TRUE;
+        value = value << 1;
+    }
+
+    return ready;
+}
+
+/**
+ * Flush the scrambler at the end of a block.
+ *
+ * @return the last scrambled byte of the block
+ */
+static uint8_t Il2pScramblerFlush(void) {
+    uint8_t out;
+
+    while (!Il2pScrambleBit(0, &out))
+        ;
+
+    return out;
+}
+
+/**
+ * Start a payload block.
+ */
+void Il2pBlockStart(void) {
+    uint8_t i;
+
+    Il2pScramblerStart();
+
+    for (i = 0; i < IL2P_CHECK_BYTES; ++i)
+        il2pCheck[i] = 0;
+}
+
+/**
+ * Scramble the next byte of the payload block and add the scrambled bytes to its
+ * check bytes.
+ *
+ * @param value payload byte
+ * @param out set to the next scrambled byte to send, when one is complete
+ *
+ * @return true if out is set
+ */
+bool_t Il2pBlockByte(uint8_t value, uint8_t *out) {
+    if (!Il2pScrambleByte(value, out))
+        return FALSE;
+
+    RsEncode(il2pCheck, il2pPayloadGenerator, IL2P_CHECK_BYTES, *out);
+    return TRUE;
+}
+
+/**
+ * Finish the payload block.  Send the byte returned, then the check bytes.
+ *
+ * @return the last scrambled byte of the block
+ */
+uint8_t Il2pBlockEnd(void) {
+    uint8_t out;
+
+    out = Il2pScramblerFlush();
+    RsEncode(il2pCheck, il2pPayloadGenerator, IL2P_CHECK_BYTES, out);
+
+    return out;
+}
+
+/**
+ * Get the check bytes of the payload block, valid after Il2pBlockEnd().
+ *
+ * @return pointer to IL2P_CHECK_BYTES check bytes
+ */
+uint8_t * Il2pGetCheckBytes(void) {
+    return il2pCheck;
+}
+
+/**
+ * Build a type 0 header block, scrambled and with its check bytes.  It shares the
+ * scrambler with the payload, so finish the payload block first.
+ *
+ * @param count number of payload bytes
+ * @param header filled with the IL2P_HEADER_BLOCK bytes to send
+ */
+void Il2pEncodeHeader(uint16_t count, uint8_t *header) {
+    uint8_t i, j, check[2];
+
+    for (i = 0; i < IL2P_HEADER_SIZE; ++i)
+        header[i] = 0;
+
+    // Bit 7 of byte 0 selects the maximum FEC level.  Bit 7 of byte 1 is the header
+    // type, 0.  Bit 7 of bytes 2 through 11 hold the payload size, MSB first.
+    header[0] = 0x80;
+    for (i = 0; i < 10; ++i)
+        if (count & (0x200 >> i))
+            header[2 + i] |= 0x80;
+
+    // The scrambled bytes lag behind, so they can go back in place
+    Il2pScramblerStart();
+    j = 0;
+    for (i = 0; i < IL2P_HEADER_SIZE; ++i)
+        if (Il2pScrambleByte(header[i], &header[j]))
+            ++j;
+    header[j] = Il2pScramblerFlush();
+
+    check[0] = 0;
+    check[1] = 0;
+    for (i = 0; i < IL2P_HEADER_SIZE; ++i)
+        RsEncode(check, il2pHeaderGenerator, 2, header[i]);
+
+    header[IL2P_HEADER_SIZE] = check[0];
+    header[IL2P_HEADER_SIZE + 1] = check[1];
+}
+
+/** @} */
@@ -0,0 +1,58 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     il2p.h                                                    *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef IL2P_H
+#define IL2P_H
+
+#include "main.h"
+
+/**
+ * @defgroup il2p IL2P Framing
+ *
+ * @{
+ */
+
+void Il2pBlockStart(void); // Start a payload block
+bool_t Il2pBlockByte(uint8_t value, uint8_t *out); // Scramble a payload byte
+uint8_t Il2pBlockEnd(void); // Last scrambled byte of the payload block
+uint8_t * Il2pGetCheckBytes(void); // Check bytes of the payload block
+void Il2pEncodeHeader(uint16_t count, uint8_t *header); // Build the header block for a payload
+
+/// Sync word sent ahead of the header, MSB first
+#define IL2P_SYNC_WORD 0xf15e48
+/// Header bytes before and after its check bytes are added
+#define IL2P_HEADER_SIZE 13
+#define IL2P_HEADER_BLOCK (IL2P_HEADER_SIZE + 2)
+/// Check bytes per payload block at the maximum FEC level
+#define IL2P_CHECK_BYTES 16
+/// Largest payload that fits in one block
+#define IL2P_MAX_BLOCK 239
+
+/** @} */
+
+#endif  // #ifndef IL2P_H
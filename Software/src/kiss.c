@@ -0,0 +1,197 @@
+#include <htc.h>
+#include "main.h"
+#include "kiss.h"
+#include "tnc.h"
+#include "fifo.h"
+
+/**
+ * @defgroup kiss KISS TNC
+ *
+ * Lets a host on the serial port send packets through us, like any other KISS
+ * TNC, for ground work and testing.  Data frames are unescaped a byte at a time
+ * straight into the TNC's tone queue, so the only buffer a frame waits in is the
+ * serial FIFO.  That's also where it waits while the queue is full or the packets
+ * ahead of it are on the air, since nothing can be queued until they're done.
+ * Command frames like TXDELAY don't touch the queue, so they never wait.
+ *
+ * At 9600 baud the FIFO covers about a quarter second of back to back frames; a
+ * host that sends more than the channel can carry will overrun it, the same as any
+ * TNC without flow control.  When that happens the frames the lost bytes belonged
+ * to are dropped whole, along with any waiting ahead of them, and we pick up again
+ * at the next FEND.  Nothing half received ever goes on the air.
+ *
+ * A data frame shorter than the two addresses and control byte every AX.25 frame
+ * starts with is dropped rather than keying up for a frame nobody can decode.
+ *
+ * Only transmitting is supported.  Received packets aren't passed to the host.
+ *
+ * @{
+ */
+
+/// Shortest data frame we send, two 7 byte addresses and the control byte
+#define KISS_MIN_FRAME 15
+
+/// Where we are in a KISS frame
+typedef enum {
+    /// A FEND was just received, the next byte is the command
+    KISS_COMMAND,
+    /// Holding a data frame in the FIFO until the queue has room for it
+    KISS_WAIT,
+    /// Adding a data frame to the transmit queue
+    KISS_FRAME,
+    /// Waiting for a command's parameter
+    KISS_PARAMETER,
+    /// Skipping to the end of a frame we don't use
+    KISS_SKIP
+} KISS_STATE;
+
+static KISS_STATE kissState;
+
+/// Command of the frame being received
+static uint8_t kissCommand;
+
+/// Bytes of the data frame added to the queue so far
+static uint16_t kissLength;
+
+/// Set when the last byte was a FESC
+static bool_t kissEscape;
+
+/**
+ * Start listening for KISS frames.  KISS mode is entered on the first FEND, so act
+ * like one was just received.
+ */
+void KissInit(void) {
+    kissState = KISS_COMMAND;
+    kissEscape = FALSE;
+}
+
+/**
+ * Apply a command's parameter to the TNC configuration.  Times from the host are in
+ * units of 10 mS.
+ *
+ * @param value parameter byte
+ */
+static void KissParameter(uint8_t value) {
+    uint16_t flags;
+
+    switch (kissCommand & 0x0f) {
+        case KISS_TX_DELAY:
+            // A flag takes 6.67 mS at 1200 baud.  At least one, so the receiver sees a flag.
+            flags = (value * 3) / 2;
+            if (flags == 0)
+                flags = 1;
+            config.txDelay = (flags > 255 ? 255 : flags);
+            break;
+
+        case KISS_PERSISTENCE:
+            config.persistence = value;
+            break;
+
+        case KISS_SLOT_TIME:
+            // In 50 mS ticks, at least one
+            config.slotTime = (value + 4) / 5;
+            if (config.slotTime == 0)
+                config.slotTime = 1;
+            break;
+    }
+}
+
+/**
+ * Handle one unescaped byte of a frame.
+ *
+ * @param value byte
+ */
+static void KissByte(uint8_t value) {
+    switch (kissState) {
+        case KISS_COMMAND:
+            kissCommand = value;
+
+            // There's no other mode to return to
+            if (value == KISS_RETURN)
+                kissState = KISS_SKIP;
+            else if ((value & 0x0f) == KISS_DATA)
+                kissState = KISS_WAIT;
+            else
+                kissState = KISS_PARAMETER;
+            break;
+
+        case KISS_FRAME:
+            // A frame too big for the queue is marked and dropped by TncFrameEnd()
+            TncFrameAppend(&value, 1);
+            ++kissLength;
+            break;
+
+        case KISS_PARAMETER:
+            KissParameter(value);
+            kissState = KISS_SKIP;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Read the bytes the host has sent and queue the packets in them.  Call it from
+ * the main loop.
+ */
+void KissUpdate(void) {
+    uint8_t value;
+
+    // The host overran the FIFO.  The frame being received and anything up to the
+    // gap are missing bytes, so drop them and start again at the next frame.
+    if (FifoOverflow()) {
+        FifoSkipToGap();
+        TncFrameAbort();
+        kissState = KISS_SKIP;
+        kissEscape = FALSE;
+    }
+
+    // Leave a data frame in the FIFO until the queue has room for the largest one
+    if (kissState == KISS_WAIT) {
+        if (!TncCanQueue(TNC_MAX_TX - 3))
+            return;
+        kissState = (TncFrameStartRaw() ? KISS_FRAME : KISS_SKIP);
+        kissLength = 0;
+    }
+
+    while (FifoHasData()) {
+        value = FifoRead();
+
+        if (value == KISS_FEND) {
+            // The end of a data frame, send it.  Hosts often send FENDs back to back.
+            if (kissState == KISS_FRAME) {
+                if (kissLength < KISS_MIN_FRAME)
+                    TncFrameAbort();
+                else if (TncFrameEnd())
+                    RadioTransmit();
+            }
+
+            kissState = KISS_COMMAND;
+            kissEscape = FALSE;
+            continue;
+        }
+
+        if (value == KISS_FESC) {
+            kissEscape = TRUE;
+            continue;
+        }
+
+        if (kissEscape) {
+            kissEscape = FALSE;
+            if (value == KISS_TFEND)
+                value = KISS_FEND;
+            else if (value == KISS_TFESC)
+                value = KISS_FESC;
+        }
+
+        KissByte(value);
+
+        // Start over so the new frame waits for room, and any overflow is caught
+        // before more of it is read
+        if (kissState == KISS_WAIT)
+            return;
+    }
+}
+
+/** @} */
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     kiss.h                                                    *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef KISS_H
+#define KISS_H
+
+#include "main.h"
+
+/**
+ * @defgroup kiss KISS TNC
+ *
+ * @{
+ */
+
+void KissInit(void);
+void KissUpdate(void);
+
+/// Frame end, starts and ends every frame
+#define KISS_FEND 0xc0
+/// Frame escape, the next byte stands for a FEND or FESC in the frame
+#define KISS_FESC 0xdb
+/// Escaped FEND
+#define KISS_TFEND 0xdc
+/// Escaped FESC
+#define KISS_TFESC 0xdd
+
+/// Commands, the low nibble of a frame's first byte.  The high nibble is the port.
+#define KISS_DATA 0x00
+#define KISS_TX_DELAY 0x01
+#define KISS_PERSISTENCE 0x02
+#define KISS_SLOT_TIME 0x03
+/// Leave KISS mode.  The whole first byte, not just the low nibble.
+#define KISS_RETURN 0xff
+
+/** @} */
+
+#endif  // #ifndef KISS_H
@@ -9,8 +9,13 @@
  * (GGA and RMC strings) in from a GPS on the hardware UART ports.  Currently
  * it's designed to run on a Microchip PIC18F2525 clocked at 32 Mhz although porting
  * to another architecture shouldn't be too difficult.  Timing during the packet
- * generation routine is pretty tight and requires interrupts to be disabled until
- * the packet is finished sending.  
+ * generation routine is pretty tight so it runs from the high priority timer 2
+ * interrupt, while the serial port and system tick are serviced at low priority.
+ * On boards with the radio's receive audio wired to AN4 (DEMOD_ENABLE), it's
+ * sampled and demodulated at low priority too, so we can wait for a clear
+ * channel and report the stations we hear.
+ * A host that sends a KISS frame in the first five seconds gets the serial port
+ * as a transmit-only KISS TNC instead of the GPS.
  *
  * @section copyright_sec Copyright
  *
@@ -55,13 +60,17 @@
 #include <string.h>
 #include "main.h"
 #include "tnc.h"
+#include "demod.h"
+#include "kiss.h"
 #include "serial.h"
 #include "Engineering.h"
 #include "led.h"
 #include "fifo.h"
 #include "gps.h"
 #include "mic-e.h"
-#include <math.h>
+#include "compress.h"
+#include "beacon.h"
+#include "flight.h"
 #include "ff.h"
 #include "sd.h"
 
@@ -72,6 +81,12 @@
 #define ONE_SEC     20
 #define FIVE_SEC    100
 
+/// Number of '`' in a row that ask for the console
+#define CONSOLE_KEYS 3
+
+/// Shortest time between status packets, in system ticks
+#define STATUS_PERIOD (60 * ONE_SEC)
+
 /*
  * Fuse settings
  */
@@ -87,12 +102,16 @@
  */
 void sysInit(void);
 void LedBootBlink(void);
+#if DEMOD_ENABLE
+void ReportFrame(void);
+#endif
 
 /// Enumeration of serial port modes
 typedef enum {
     STARTUP,
     GPS_MODE,
-    CONSOLE_MODE
+    CONSOLE_MODE,
+    KISS_MODE
 } SER_PORT_MODE;
 
 /// Holds the last received byte from the serial port
@@ -107,42 +126,137 @@ static uint32_t oneSecTick;
 /// keeps track of the GPS status LED's tick
 static uint32_t statusLedOffTick;
 
+/// system tick of the last status packet
+static uint32_t statusTick;
+
 /// Keeps track of whether the serial port is in console mode or GPS mode
 SER_PORT_MODE serMode;
 
+/// Mode a host asked for during startup, STARTUP until one does
+volatile static SER_PORT_MODE startupRequest;
+
 /**
- * Sends a MIC-E position packet
+ * Watches the bytes received during startup for a host asking for console or
+ * KISS mode.  A GPS sends '$' or the UBX sync characters within a second of power
+ * up, and after that nothing it sends can be taken for a request, since its
+ * binary payloads are full of bytes that look like one.  Before that a lone
+ * '`' or FEND still isn't enough: the console takes a few '`' in a row, and
+ * KISS a whole frame, a FEND and a port 0 command through to the closing FEND.
+ * That first frame only selects the mode and isn't sent.
+ *
+ * @param value byte received from the serial port
+ */
+void StartupDetect(uint8_t value) {
+    static uint8_t consoleKeys, kissBytes, lastValue;
+    static bool_t gpsSeen;
+
+    if (gpsSeen)
+        return;
+
+    // A '$' can be part of an APRS packet, so it only counts between KISS frames
+    if ((value == '$' && kissBytes == 0) || (lastValue == 0xb5 && value == 0x62)) {
+        gpsSeen = TRUE;
+        return;
+    }
+    lastValue = value;
+
+    if (value != '`')
+        consoleKeys = 0;
+    else if (++consoleKeys == CONSOLE_KEYS)
+        startupRequest = CONSOLE_MODE;
+
+    // kissBytes counts the FEND and what follows it, 0 outside of a frame
+    if (value == KISS_FEND) {
+        if (kissBytes > 1)
+            startupRequest = KISS_MODE;
+        kissBytes = 1;
+    } else if (kissBytes == 1 && value > KISS_SLOT_TIME)
+        kissBytes = 0;
+    else if (kissBytes != 0 && kissBytes < 255)
+        ++kissBytes;
+}
+
+/**
+ * Queues a MIC-E or compressed position packet, whichever is shorter on the air.
+ * Call RadioTransmit() to send it.
  *
  * @param gps GPSData structure containing location to send
+ *
+ * @return true if the packet was queued
  */
-void SendPosition(GPSData * gps) {
+bool_t SendPosition(GPSData * gps) {
+    uint8_t *info, *dest;
+
     MicEEncode(gps);
-    TncPreparePacket(MicEGetInfoField(), MicEGetDestAddress());
-    printf("Lat: %ld Long: %ld\r\n", gps->latitude, gps->longitude);
+    CompressEncode(gps);
+
+    // Mic-E carries both altitude and course, so it gets the tie
+    if (TncFrameTones(CompressGetInfoField(), config.destCallSign) < TncFrameTones(MicEGetInfoField(), MicEGetDestAddress())) {
+        info = CompressGetInfoField();
+        dest = config.destCallSign;
+    } else {
+        info = MicEGetInfoField();
+        dest = MicEGetDestAddress();
+    }
 
-    // transmit the Mic-E compressed packet
-    RadioTX();
-    TncSendPacket();
-    RadioRX();
+    if (!TncPreparePacket(info, dest)) {
+        printf("TNC queue full\r\n");
+        return FALSE;
+    }
+
+    printf("Lat: %ld Long: %ld\r\n", gps->latitude, gps->longitude);
+    return TRUE;
 }
 
 /**
- * Sends an AX.25 status packet
+ * Queues an AX.25 status packet.  Call RadioTransmit() to send it.
  *
  * @param gps GPSData structure from which to get altitude, dop, and number of tracked satelites
  */
 void SendStatus(GPSData * gps) {
-    char buffer[50];
-    sprintf(buffer, ">ANSR %ld' %d.%01ddop %dtrk www.ansr.org\015", (int32_t)(gps->altitude / 30.48), (uint16_t)(gps->dop / 10), (uint16_t)(gps->dop % 10), (uint16_t)gps->trackedSats);
-    TncPreparePacket(buffer, "APRS  ");
-    printf("%s\n", buffer);
-
-    // transmit the packet
-    RadioTX();
-    TncSendPacket();
-    RadioRX();
+    int32_t altitude;
+
+    // cm to feet, 30.48 cm each, in integer math.  Good to over 200 km before it overflows.
+    altitude = (gps->altitude * 100) / 3048;
+
+    // Build the packet in place rather than formatting it into a buffer and copying it
+    if (TncFrameStart("APRS  ")) {
+        TncFrameAppendString(">ANSR ");
+        TncFrameAppendNumber(altitude);
+        TncFrameAppendString("' ");
+        TncFrameAppendNumber(gps->dop / 10);
+        TncFrameAppendString(".");
+        TncFrameAppendNumber(gps->dop % 10);
+        TncFrameAppendString("dop ");
+        TncFrameAppendNumber(gps->trackedSats);
+        TncFrameAppendString("trk www.ansr.org\015");
+    }
+    if (!TncFrameEnd())
+        printf("TNC queue full\r\n");
+    printf(">ANSR %ld' %d.%01ddop %dtrk www.ansr.org\n", altitude, (uint16_t)(gps->dop / 10), (uint16_t)(gps->dop % 10), (uint16_t)gps->trackedSats);
 }
 
+#if DEMOD_ENABLE
+/**
+ * Prints the source call sign of a received packet, if there is one.
+ */
+void ReportFrame(void) {
+    uint8_t frame[14], i;
+    char callSign[7];
+
+    // Only the addresses are needed.  The CRC check makes sure they're there.
+    if (DemodGetFrame(frame, sizeof(frame)) == 0)
+        return;
+
+    // The source address follows the destination, shifted left one bit and padded with spaces
+    for (i = 0; i < 6 && frame[7 + i] != (' ' << 1); ++i)
+        callSign[i] = frame[7 + i] >> 1;
+    callSign[i] = 0;
+
+    printf("Heard %s-%d\r\n", callSign, (frame[13] >> 1) & 0x0f);
+}
+#endif
+
 FATFS fileSystem;   /* Work area (file system object) for logical drive */
 FIL logFile;
 
@@ -153,6 +267,7 @@ void main(void) {
     FRESULT res;
     WORD bw, btw;
     char buffer[80];
+    SER_PORT_MODE mode;
 
     sysInit();
     SerialInit();
@@ -161,21 +276,31 @@ void main(void) {
     // get the pointer to the GPS data structure
     gps = GpsGetData();
 
-    // configure the TNC
+    // configure the TNC and when it sends our position
     TncConfigDefault();
+    BeaconConfigDefault();
+    FlightInit();
+
+#if DEMOD_ENABLE
+    // listen to the radio so we don't transmit over someone else
+    DemodInit();
+    DemodStart();
+#endif
 
     // indicate the system is up and running
     LedBootBlink();
 
     SetLED(3, 1);
-    // wait for someone to press '`' a few times to enter console mode
-    SerialPutst("Press '`' to enter console mode\r\n");
-    while (sysTick < FIVE_SEC) {
-        if (serbuff == '`') {
-            serMode = CONSOLE_MODE;
-            break;
-        }
-    }
+    // wait for someone to press '`' a few times to enter console mode, or for a KISS host
+    SerialPutst("Press '`' three times to enter console mode\r\n");
+    while (sysTick < FIVE_SEC && startupRequest == STARTUP)
+        ;
+
+    // read the request once, the interrupt keeps listening until serMode changes
+    mode = startupRequest;
+    if (mode == KISS_MODE)
+        KissInit();
+    serMode = mode;
     SetLED(3, 0);
 
 
@@ -192,37 +317,49 @@ void main(void) {
     /* seek to end of the file */
     f_lseek(&logFile, f_size(&logFile));
 
-    // if console mode was not selected, default to using the GPS
-    if (serMode != CONSOLE_MODE) {
+    // if console or KISS mode was not selected, default to using the GPS
+    if (serMode == STARTUP) {
         serMode = GPS_MODE;
         
         TncPreparePacket(">Successful boot!\015", "APRS  ");
         // transmit the packet
-        RadioTX();
-        TncSendPacket();
-        RadioRX();
+        RadioTransmit();
     }
 
     while (1) {
+        // key the radio up and down around queued packets
+        RadioUpdate(sysTick);
+
+#if DEMOD_ENABLE
+        // report anyone we hear, unless the serial port belongs to a KISS host
+        if (serMode != KISS_MODE)
+            ReportFrame();
+#endif
+
         if (serMode == CONSOLE_MODE)
             EngineeringConsole();
+        else if (serMode == KISS_MODE)
+            KissUpdate();
         else {
             // Read data from the GPS
             GpsUpdate();
 
             if (GpsIsDataReady()) {
-                if (gps->fixType != NoFix) {
-                    switch (gps->seconds) {
-                        case 15:
-                        case 45:
-                            SendPosition(gps);
-                            break;
-
-                        case 23:
-                            // send a status packet
-                            SendStatus(gps);
-                            break;
+                // pick the digipeater path for our altitude and flight phase
+                if (gps->fixType != NoFix)
+                    FlightUpdate(gps);
+
+                // a position that couldn't be queued goes on the next fix
+                if (gps->fixType != NoFix && BeaconIsDue(gps, sysTick) && SendPosition(gps)) {
+                    BeaconSent(gps, sysTick);
+
+                    // send a status packet in the same burst as the position, once a minute at most
+                    if (sysTick - statusTick >= STATUS_PERIOD) {
+                        statusTick = sysTick;
+                        SendStatus(gps);
                     }
+
+                    RadioTransmit();
                 }
                 SetLED(1, 1);
                 if (gps->fixType == NoFix)
@@ -311,7 +448,16 @@ void sysInit(void) {
     // Prescale of 1:2
     T2CONbits.T2OUTPS0 = 0x1;
 
-    // GIE, PEIE Interrupts
+    // Timer2 clocks out the AFSK, so it's the only high priority interrupt.  It's
+    // enabled by TncSendPacket() for the length of each packet.
+    TMR2IE = 0x0;
+    TMR2IP = 0x1;
+    // Serial receive and the system tick can wait
+    RCIP = 0x0;
+    TMR1IP = 0x0;
+    IPEN = 0x1;
+
+    // GIEH, GIEL Interrupts
     GIE = 0x1;
     PEIE = 0x1;
     INTCON = 0b11000000;
@@ -326,18 +472,31 @@ void sysInit(void) {
     sysTick = 0;
     oneSecTick = 0;
     statusLedOffTick = 0;
+
+    // the first position brings a status packet along
+    statusTick = -STATUS_PERIOD;
 }
 
 /**
- * System interrupt handler
+ * High priority interrupt handler
  */
 interrupt isr(void) {
+    // Timer 2 interrupt for each step of the AFSK sin wave
+    if (TMR2IF && TMR2IE)
+        TncTimer2Interrupt();
+}
+
+/**
+ * Low priority interrupt handler
+ */
+interrupt low_priority isrLow(void) {
     // Serial receive interrupt
     if (RCIF) {
         serbuff = RCREG;
-        if (serMode != STARTUP) {
+        if (serMode != STARTUP)
             FifoWrite(serbuff);
-        }
+        else
+            StartupDetect(serbuff);
 
         // clear any overrun errors
         if (OERR)
@@ -347,6 +506,12 @@ interrupt isr(void) {
         }
     }
 
+#if DEMOD_ENABLE
+    // Radio audio sample
+    if (ADIF && ADIE)
+        DemodAdcInterrupt();
+#endif
+
     // Timer 1 interrupt every 50ms
     if (TMR1IF) {
         // Clear interrupt flag & reload timer
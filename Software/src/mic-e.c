@@ -15,12 +15,16 @@ static char destAddress[7];
 /// Informational text field as part of the AX.25 message.
 static char information[20];
 
-void MicEEncode (GPSData *gps)
+/**
+ * Encode the position from latitude and longitude in degrees * 10^7.  Used when the
+ * GPS didn't supply the digits, since it takes a handful of 32 bit divisions.
+ *
+ * @param gps GPSData structure containing the position
+ */
+static void MicEEncodeDegrees (GPSData *gps)
 {
     int32_t value;
 
-    // NOTE: The Message A/B/C bits are hard coded as 110 for Enroute.
-
     // Convert to units of decimal degrees.
     value = labs(gps->latitude);
     value /= 10000000;
@@ -38,21 +42,6 @@ void MicEEncode (GPSData *gps)
     destAddress[4] = '0' + (value / 100000) % 10;
     destAddress[5] = '0' + (value / 10000) % 10;
 
-    // Adjust for the N/S ordinal.
-    if (gps->latitude > 0)
-        destAddress[3] += 'P' - '0';
-
-    // Adjust for the E/W ordinal.
-    if (gps->longitude < 0)
-        destAddress[5] += 'P' - '0';
-
-    // NULL terminate the string.
-    destAddress[6] = 0;
-
-
-    // Set the Data Type ID.
-    information[0] = '`';
-
     // Convert to units of decimal degrees.
     value = labs(gps->longitude);
     value /= 10000000;
@@ -85,26 +74,137 @@ void MicEEncode (GPSData *gps)
 
     // Encode the longitude in decimal minutes.
     information[3] = value + 28;
+}
+
+/**
+ * Encode the position straight from the digits the GPS sent.  The destination
+ * address is the latitude digits with a few offsets, and the longitude bytes only
+ * need two digit numbers, so there's nothing to divide.
+ *
+ * @param gps GPSData structure containing the position digits
+ */
+static void MicEEncodeDigits (GPSData *gps)
+{
+    uint8_t i, value;
+
+    // Degrees, minutes, and hundredths of minutes in order.  The degrees are 'P' to 'Y'.
+    for (i = 0; i < 6; ++i)
+        destAddress[i] = gps->latitudeDigits[i];
+    destAddress[0] += 'P' - '0';
+    destAddress[1] += 'P' - '0';
+
+    // Longitude in degrees.
+    value = (gps->longitudeDigits[0] - '0') * 100 + (gps->longitudeDigits[1] - '0') * 10 +
+            (gps->longitudeDigits[2] - '0');
+
+    // Adjust the destination for the +100 longitude.
+    if (value <= 9 || value >= 100)
+        destAddress[4] += 'P' - '0';
+
+    // Encode the longitude in degrees.
+    if (value <= 9)
+        information[1] = value + 118;
+    else if (value <= 99)
+        information[1] = value + 28;
+    else if (value <= 109)
+        information[1] = value + 8;
+    else
+        information[1] = value - 72;
+
+    // Encode the longitude in minutes.
+    value = (gps->longitudeDigits[3] - '0') * 10 + (gps->longitudeDigits[4] - '0');
+    if (value <= 9)
+        information[2] = value + 88;
+    else
+        information[2] = value + 28;
+
+    // Encode the longitude in decimal minutes.
+    information[3] = (gps->longitudeDigits[5] - '0') * 10 + (gps->longitudeDigits[6] - '0') + 28;
+}
+
+/**
+ * Convert cm to meters, rounded toward zero like a division, with multiplies.
+ *
+ * @param cm distance in cm, less than 10^8
+ *
+ * @return distance in meters
+ */
+static uint32_t MicEMeters (uint32_t cm)
+{
+    uint16_t high;
+
+    // 65536 is 655 * 100 + 36, so the high half gives 655 meters and 36 cm each.
+    // The rest is under 2^17, and / 4 / 25 is exact as * 5243 >> 17 below 2^15.
+    high = cm >> 16;
+    cm = (uint32_t) high * 36 + (cm & 0xffff);
+
+    return (uint32_t) high * 655 + (((cm >> 2) * 5243) >> 17);
+}
+
+void MicEEncode (GPSData *gps)
+{
+    uint16_t value, knots;
+    uint32_t meters;
+    uint8_t digit;
+
+    // NOTE: The Message A/B/C bits are hard coded as 110 for Enroute.
+
+    // Set the Data Type ID.
+    information[0] = '`';
+
+    if (gps->latitudeDigits[0] != 0)
+        MicEEncodeDigits(gps);
+    else
+        MicEEncodeDegrees(gps);
+
+    // Adjust for the N/S ordinal.
+    if (gps->latitude > 0)
+        destAddress[3] += 'P' - '0';
+
+    // Adjust for the E/W ordinal.
+    if (gps->longitude < 0)
+        destAddress[5] += 'P' - '0';
+
+    // NULL terminate the string.
+    destAddress[6] = 0;
+
+    // The rest is all 16 bits but the altitude.  x / 10 is (x * 52429) >> 19 for any 16 bit x, and
+    // x / 100 is (x * 5243) >> 19 up to 36000.
 
     // Convert to units of 1 knot.
-    value = gps->speed / 10;
+    knots = ((uint32_t) gps->speed * 52429) >> 19;
+    value = ((uint32_t) knots * 52429) >> 19;
 
     // Encode the speed in knots and heading in degrees.
-    information[4] = 28 + (value / 10);
-    information[5] = 28 + ((value % 10) * 10);
-    information[5] += (gps->heading / 10000);
-    information[6] = 28 + (gps->heading / 100) % 100;
+    information[4] = 28 + value;
+    information[5] = 28 + (knots - value * 10) * 10;
+
+    value = ((uint32_t) gps->heading * 5243) >> 19;
+    for (digit = 0; value >= 100; ++digit)
+        value -= 100;
+    information[5] += digit;
+    information[6] = 28 + value;
 
     // APRS symbol setting for balloon.
     information[7] = 'O';
     information[8] = '/';
 
-    // Encode the altitude in meters above 10KM datum.
-    value = (gps->altitude / 100) + 10000;
-
-    information[9] = 33 + (value / 8281);
-    information[10] = 33 + ((value / 91) % 91);
-    information[11] = 33 + (value % 91);
+    // Encode the altitude in meters above 10KM datum.  It passes 16 bits at 55 km.
+    if (gps->altitude < 0)
+        meters = 10000 - MicEMeters(-gps->altitude);
+    else
+        meters = 10000 + MicEMeters(gps->altitude);
+
+    // Base 91.  The top digit is 7 for anything a balloon reaches, and x / 91 is
+    // (x * 2881) >> 18 below 8281.
+    for (digit = 0; meters >= 8281; ++digit)
+        meters -= 8281;
+    information[9] = 33 + digit;
+    value = meters;
+
+    digit = ((uint32_t) value * 2881) >> 18;
+    information[10] = 33 + digit;
+    information[11] = 33 + (value - digit * 91);
     information[12] = '}';
 
     // NULL terminate the string.
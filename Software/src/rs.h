@@ -0,0 +1,44 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     rs.h                                                      *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef RS_H
+#define RS_H
+
+#include "main.h"
+
+/**
+ * @defgroup rs Reed-Solomon Encoder
+ *
+ * @{
+ */
+
+void RsEncode(uint8_t *check, const uint8_t *generator, uint8_t roots, uint8_t value); // Add a byte to a code block's check bytes
+
+/** @} */
+
+#endif  // #ifndef RS_H
@@ -1,7 +1,11 @@
 #include <htc.h>
+#include <stdlib.h>
 #include <string.h>
 #include "main.h"
 #include "tnc.h"
+#include "demod.h"
+#include "fx25.h"
+#include "il2p.h"
 #include "fifo.h"
 #include "serial.h"
 
@@ -13,6 +17,35 @@
  * @{
  */
 
+#if TNC_OUTPUT == TNC_OUTPUT_PWM
+#if !TNC_DDS
+#error "The PWM output needs TNC_DDS since the PWM period is the timer 2 period"
+#endif
+
+/**
+ * Table of 8-bit PWM duty cycles to generate a sin wave, one full cycle in 64
+ * equal increments of time.
+ */
+static const uint8_t sinPWM[64] = {
+    128, 140, 152, 165, 176, 188, 198, 208, 218, 226, 234, 240, 245, 250, 253, 254,
+    255, 254, 253, 250, 245, 240, 234, 226, 218, 208, 198, 188, 176, 165, 152, 140,
+    128, 115, 103,  90,  79,  67,  57,  47,  37,  29,  21,  15,  10,   5,   2,   1,
+      0,   1,   2,   5,  10,  15,  21,  29,  37,  47,  57,  67,  79,  90, 103, 115
+};
+
+/// The PWM duty cycle is out of 4 * (PR2 + 1), center the 8-bit table in it.  In units of CCPR1L.
+#define TNC_PWM_OFFSET ((4 * (TNC_DDS_PR2 + 1) - 256) / 8)
+
+/// Put CCP1 into PWM mode
+#define TncOutputInit() CCP1CON = 0b00001100
+
+/// Output the sin wave sample for a DDS phase.  The top 6 bits index sinPWM.
+#define TncOutputSample(phase) {                                    \
+    uint8_t sample = sinPWM[(uint8_t) ((phase) >> 8) >> 2];         \
+    CCPR1L = (sample >> 2) + TNC_PWM_OFFSET;                        \
+    CCP1CONbits.DC1B = sample & 0x03;                               \
+}
+#else
 /**
  * Table of values to generate a sin wave.  Each value represents the value
  * to jump to after an equal increment in time.  Note this is highly dependant
@@ -24,14 +57,106 @@ static unsigned char sinDAC[] = {
     0b1000, 0b0000, 0b1000, 0b0100, 0b1010
 };
 
-static uint16_t tncIndex, tncLength;
-static uint8_t tncBitCount, tncShift, tncLastBit, tncMode;
-static uint8_t tncBitStuff, tncBuffer[TNC_MAX_TX], sinIndex;
+/// Nothing to set up for the resistor DAC
+#define TncOutputInit()
+
+/// Output the sin wave sample for a DDS phase.  The top 4 bits index sinDAC.
+#define TncOutputSample(phase) PORTA = sinDAC[(uint8_t) ((phase) >> 8) >> 4]
+#endif
+
+static uint16_t tncIndex, tncLength, tncToneCount;
+static uint8_t tncBitCount, tncShift, tncLastBit;
+static volatile uint8_t tncMode;
+static volatile bool_t tncSending;
+static uint8_t tncBitStuff;
+
+/// Modulation of the packets being sent, config.modulation when they started
+static uint8_t tncModulation;
+
+/// Number of sync flags to send before the packets
+static uint16_t tncSyncFlags;
+
+/// G3RUH scrambler shift register, the last 17 scrambled bits
+static uint32_t tncScrambler;
+
+/// G3RUH output level of the current bit, and whether the next sample is its second half
+static uint16_t tncLevel;
+static uint8_t tncHalfBit;
+
+#if TNC_DDS
+/// Phase of the sin wave, the top bits index the sin table.  tncPhaseStep is added every sample.
+static uint16_t tncPhase, tncPhaseStep;
+/// Phase of the bit clock, a new bit starts each time it wraps
+static uint16_t tncBaudPhase;
+#else
+static uint8_t sinIndex;
 static uint16_t timeElapsed = 0;
+#endif
+
+/// Bit stuffed, NRZI encoded tones of the queued packets, one bit per tone, LSB first.  1 is a mark.
+static uint8_t tncTones[TNC_QUEUE_TONES];
+
+/// Where TncEncodeBit() puts the next tone
+static uint8_t *tncToneOut, tncToneMask;
+
+/// Tones the interrupt may send, and tones it has sent.  tncTones is a ring so a streamed
+/// packet can be encoded while the start of it is going out.
+static volatile uint16_t tncToneReady, tncToneSent;
+
+/// Where the rest of a streamed packet's information field comes from, and how many bytes are left
+static TNC_SOURCE tncSource;
+static uint16_t tncSourceLength;
+
+/// Set while a streamed packet still has bytes or its CRC to encode
+static volatile bool_t tncStreaming;
+
+/// Framing of the packet being built, config.framing when it started, and of the last one queued
+static uint8_t tncFraming, tncQueueFraming;
+
+/// Tones of the sync flags sent ahead of the queue, picked by the first packet's framing
+static uint8_t tncSyncTones;
+
+/// Set while the bits being encoded belong to the FX.25 data block
+static bool_t tncFx25Collect;
+
+/// Bits of the FX.25 data block so far, and the byte they're being collected into
+static uint16_t tncFx25Bits;
+static uint8_t tncFx25Byte;
+
+/// Where the FX.25 correlation tag or IL2P header goes once it's known, and the tone before it
+static uint8_t *tncMarkOut, tncMarkMask, tncMarkLevel;
 
 /// Structure containing the TNC configuration (callsign, digi path, etc)
 CONFIG_STRUCT config;
 
+/// Address fields built from config by TncBuildHeader(), shifted and with their SSIDs
+static uint8_t tncHeader[TNC_MAX_HEADER], tncHeaderLength;
+
+/// CRC of tncHeader, good as long as the packet goes to config.destCallSign
+static uint16_t tncHeaderCrc;
+
+/// Running CRC of the packet TncFrameStart() started
+static uint16_t tncFrameCrc;
+
+/// Set when the packet being built outgrew TNC_MAX_TX or the queue
+static bool_t tncFrameOverflow;
+
+/// Set when the packet being built was started by TncFrameStartRaw()
+static bool_t tncFrameRaw;
+
+/// Where the packet being built starts in the tone queue, and tncMode before it started
+static uint16_t tncFrameToneCount;
+static uint8_t *tncFrameToneOut, tncFrameToneMask, tncFrameLastBit, tncFrameLastMode;
+
+/// Where the radio is in the key-up, transmit, key-down sequence
+static RADIO_STATE radioState;
+
+/// System tick when the radio's current state started
+static uint32_t radioTick;
+
+/// System tick of the next p-persistence slot
+static uint32_t radioSlotTick;
+
 #define _XTAL_FREQ 32000000
 
 /**
@@ -50,63 +175,39 @@ void TncConfigDefault() {
     // Number of TNC flag bytes sent before data stream starts.  (350mS) 1 byte = 6.6mS
     config.txDelay = 53;
 
-    // Flight operation time.
-    config.flightTime = 0;
-}
+    // Time for the radio to key up before the flags start, in 50mS ticks.  (200mS)
+    config.keyUpDelay = 4;
 
-/**
- * Calculate the CRC-16 CCITT of <b>buffer</b> that is <b>length</b> bytes long.
- *
- * @param buffer Pointer to data buffer.
- * @param length number of bytes in data buffer
- *
- * @return CRC-16 of buffer[0 .. length]
- */
-uint16_t CRC16(uint8_t *buffer, uint16_t length) {
-    uint16_t i, dbit, crc, value;
+    // Key up as soon as the channel is clear.  Slot time in 50mS ticks.
+    config.persistence = 255;
+    config.slotTime = 2;
 
-    crc = 0xffff;
+    // 1200 baud AFSK
+    config.modulation = TNC_AFSK_1200;
 
-    for (i = 0; i < length; ++i) {
-        value = buffer[i];
+    // Plain AX.25, no FX.25 or IL2P
+    config.framing = TNC_FRAMING_AX25;
 
-        for (dbit = 0; dbit < 8; ++dbit) {
-            crc ^= (value & 0x01);
-            crc = (crc & 0x01) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
-            value = value >> 1;
-        }
-    }
+    // Flight operation time.
+    config.flightTime = 0;
 
-    return crc ^ 0xffff;
+    TncBuildHeader();
 }
 
 /**
- * Prepare an AX.25 packet for transmission.  This function takes a char buffer as
- * input and operates on tncBuffer.
- *
- * @param message pointer to NULL terminate message string
- * @param destaddr pointer to the destination address
+ * Build the AX.25 address fields from the config so TncPreparePacket() can copy them
+ * instead of shifting every call sign for every packet.  Call it whenever the call
+ * signs, SSIDs, or path in the config change.
  */
-void TncPreparePacket(uint8_t * message, uint8_t * destaddr) {
-    uint16_t i, crc;
-    uint8_t *outBuffer;
-
-    // If we are currently sending, then ignore this packet.
-    if (tncMode == TNC_TX_PREPARE || tncMode == TNC_TX_SYNC || tncMode == TNC_TX_DATA || tncMode == TNC_TX_END)
-        return;
-
-    tncMode = TNC_TX_PREPARE;
+void TncBuildHeader(void) {
+    uint8_t i, *outBuffer;
 
-    // Set a pointer to our output buffer.
-    outBuffer = tncBuffer;
-
-    // Includes source (7), dest (7), control field (1), protocol ID (1), and end of message (1).
-    tncLength = 17;
+    outBuffer = tncHeader;
 
     // Set the destination address.  AX.25 requires all callsigns to be ASCI shifted one left.  This
     // essentially just drops the parity bit
     for (i = 0; i < 6; ++i)
-        *outBuffer++ = destaddr[i] << 1;
+        *outBuffer++ = config.destCallSign[i] << 1;
 
     // Set destination to SSID-0
     *outBuffer++ = 0x60;
@@ -123,7 +224,6 @@ void TncPreparePacket(uint8_t * message, uint8_t * destaddr) {
         for (i = 0; i < 6; ++i)
             *outBuffer++ = config.relayCallSign1[i] << 1;
         *outBuffer++ = 0x60 | (config.relayCallSignSSID1 << 1);
-        tncLength += 7;
     }
 
     // Add relay path 2.
@@ -131,39 +231,774 @@ void TncPreparePacket(uint8_t * message, uint8_t * destaddr) {
         for (i = 0; i < 6; ++i)
             *outBuffer++ = config.relayCallSign2[i] << 1;
         *outBuffer++ = 0x60 | (config.relayCallSignSSID2 << 1);
-        tncLength += 7;
     }
 
     // Set bit-0 of the last SSID.
     *(outBuffer - 1) |= 0x01;
 
+    tncHeaderLength = outBuffer - tncHeader;
+    tncHeaderCrc = CRC16_INIT;
+    for (i = 0; i < tncHeaderLength; ++i)
+        tncHeaderCrc = Crc16Update(tncHeaderCrc, tncHeader[i]);
+}
+
+/**
+ * CRC-16 CCITT (X.25, reflected polynomial 0x8408) of every byte value, so the
+ * CRC can be updated a byte at a time instead of a bit at a time.
+ */
+static const uint16_t crcTable[256] = {
+    0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
+    0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
+    0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
+    0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
+    0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
+    0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
+    0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
+    0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
+    0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
+    0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
+    0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
+    0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
+    0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
+    0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
+    0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
+    0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
+    0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
+    0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
+    0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
+    0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
+    0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
+    0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
+    0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
+    0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
+    0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
+    0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
+    0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
+    0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
+    0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
+    0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
+    0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
+    0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
+};
+
+/**
+ * Add one byte to a running CRC-16 CCITT.  Start with CRC16_INIT and exclusive-or
+ * the final value with 0xffff before sending it.
+ *
+ * @param crc CRC of the bytes so far
+ * @param value next byte
+ *
+ * @return CRC including value
+ */
+uint16_t Crc16Update(uint16_t crc, uint8_t value) {
+    return (crc >> 8) ^ crcTable[(uint8_t) crc ^ value];
+}
+
+/**
+ * Calculate the CRC-16 CCITT of <b>buffer</b> that is <b>length</b> bytes long.
+ *
+ * @param buffer Pointer to data buffer.
+ * @param length number of bytes in data buffer
+ *
+ * @return CRC-16 of buffer[0 .. length]
+ */
+uint16_t CRC16(uint8_t *buffer, uint16_t length) {
+    uint16_t crc;
+
+    crc = CRC16_INIT;
+
+    while (length-- != 0)
+        crc = Crc16Update(crc, *buffer++);
+
+    return crc ^ 0xffff;
+}
+
+/**
+ * NRZI encode one bit onto the end of the tone stream.  A zero changes the tone,
+ * a one keeps it.
+ *
+ * @param bit bit to send, zero or one
+ */
+static void TncEncodeBit(uint8_t bit) {
+    // The FX.25 check bytes cover the bit stream before NRZI, a byte at a time
+    if (tncFx25Collect) {
+        tncFx25Byte = tncFx25Byte >> 1;
+        if (bit)
+            tncFx25Byte |= 0x80;
+        if ((++tncFx25Bits & 0x07) == 0)
+            Fx25Encode(tncFx25Byte);
+    }
+
+    if (bit == 0)
+        tncLastBit ^= 1;
+
+    if (tncLastBit)
+        *tncToneOut |= tncToneMask;
+
+    tncToneMask = tncToneMask << 1;
+    if (tncToneMask == 0) {
+        tncToneMask = 0x01;
+        if (++tncToneOut == tncTones + TNC_QUEUE_TONES)
+            tncToneOut = tncTones;
+        *tncToneOut = 0;
+    }
+
+    ++tncToneCount;
+}
+
+/**
+ * Encode a byte onto the end of the tone stream, LSB first.
+ *
+ * @param value byte to send
+ * @param stuff non-zero to insert a zero after every 5 ones in a row (every byte but the flags)
+ */
+static void TncEncodeByte(uint8_t value, uint8_t stuff) {
+    uint8_t i;
+
+    for (i = 0; i < 8; ++i) {
+        TncEncodeBit(value & 0x01);
+
+        if (stuff) {
+            // Bitstuffing; If there's been 5 ones in a row, send a zero
+            if (value & 0x01) {
+                if (++tncBitStuff == 5) {
+                    TncEncodeBit(0);
+                    tncBitStuff = 0;
+                }
+            } else
+                tncBitStuff = 0;
+        }
+
+        value = value >> 1;
+    }
+}
+
+/**
+ * Encode a byte onto the end of the tone stream as is, MSB first, with no NRZI or bit
+ * stuffing.  A one is a mark.  IL2P is sent this way.
+ *
+ * @param value byte to send
+ */
+static void TncEncodeRawByte(uint8_t value) {
+    uint8_t i;
+
+    for (i = 0; i < 8; ++i) {
+        // No change in tone is a one to TncEncodeBit()
+        TncEncodeBit((value >> 7) == tncLastBit);
+        value = value << 1;
+    }
+}
+
+/**
+ * Overwrite the next tone at tncMarkOut, for the parts of a packet that can only be
+ * filled in once the rest of it is encoded.
+ *
+ * @param tone 1 for a mark
+ */
+static void TncPutTone(uint8_t tone) {
+    if (tone)
+        *tncMarkOut |= tncMarkMask;
+    else
+        *tncMarkOut &= ~tncMarkMask;
+
+    tncMarkMask = tncMarkMask << 1;
+    if (tncMarkMask == 0) {
+        tncMarkMask = 0x01;
+        if (++tncMarkOut == tncTones + TNC_QUEUE_TONES)
+            tncMarkOut = tncTones;
+    }
+}
+
+/**
+ * Encode one byte of the packet being built in its framing:  scrambled for IL2P, or
+ * bit stuffed for AX.25 and FX.25.
+ *
+ * @param value byte to send
+ */
+static void TncFrameEncode(uint8_t value) {
+    uint8_t out;
+
+    if (tncFraming == TNC_FRAMING_IL2P) {
+        if (Il2pBlockByte(value, &out))
+            TncEncodeRawByte(out);
+    } else
+        TncEncodeByte(value, 1);
+}
+
+/**
+ * Add one byte of the packet being built to its CRC and its tones.
+ *
+ * @param value byte to add
+ */
+static void TncFrameByte(uint8_t value) {
+    tncFrameCrc = Crc16Update(tncFrameCrc, value);
+    TncFrameEncode(value);
+    ++tncLength;
+}
+
+/**
+ * Check that bytes can be added to the packet being built.  The packet, with room
+ * for the end of message character and CRC, has to fit in TNC_MAX_TX, and its worst
+ * case tones (one stuffed bit for every 5, plus the two closing flags) have to fit
+ * in the queue.  If not, the packet is marked so TncFrameEnd() drops it.
+ *
+ * @param length number of bytes to add
+ *
+ * @return true if they fit
+ */
+static bool_t TncFrameReserve(uint16_t length) {
+    if (tncMode != TNC_TX_PREPARE || tncFrameOverflow)
+        return FALSE;
+
+    // Nothing can follow a streamed information field.
+    if (tncStreaming || tncLength + length + 3 > TNC_MAX_TX ||
+            tncToneCount + ((length + 3) * 8 * 6) / 5 + 16 > (TNC_QUEUE_TONES - 1) * 8) {
+        tncFrameOverflow = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Count the tones one byte of a packet takes once it's bit stuffed.
+ *
+ * @param value byte to count
+ * @param ones number of ones in a row before it, updated
+ *
+ * @return number of tones
+ */
+static uint8_t TncCountTones(uint8_t value, uint8_t *ones) {
+    uint8_t i, tones;
+
+    tones = 8;
+    for (i = 0; i < 8; ++i) {
+        if ((value & 0x01) == 0)
+            *ones = 0;
+        else if (++*ones == 5 && config.framing != TNC_FRAMING_IL2P) {
+            ++tones;
+            *ones = 0;
+        }
+        value = value >> 1;
+    }
+
+    return tones;
+}
+
+/**
+ * Count the tones a packet would take, without queuing it, to pick the shortest of
+ * ways to send the same thing.  The flags, FX.25 padding, and IL2P header are the
+ * same for any packet and aren't counted.
+ *
+ * @param message pointer to NULL terminated message string
+ * @param destaddr pointer to the destination address
+ *
+ * @return number of tones from the first address byte through the CRC
+ */
+uint16_t TncFrameTones(uint8_t * message, uint8_t * destaddr) {
+    uint16_t tones, crc;
+    uint8_t i, ones, value;
+
+    tones = 0;
+    ones = 0;
+    crc = CRC16_INIT;
+
+    for (i = 0; i < tncHeaderLength + 2; ++i) {
+        if (i < 6)
+            value = destaddr[i] << 1;
+        else if (i < tncHeaderLength)
+            value = tncHeader[i];
+        else
+            value = (i == tncHeaderLength ? 0x03 : 0xf0);
+
+        crc = Crc16Update(crc, value);
+        tones += TncCountTones(value, &ones);
+    }
+
+    // The message and its end of message character
+    do {
+        value = (*message != 0 ? *message++ : 0x0d);
+        crc = Crc16Update(crc, value);
+        tones += TncCountTones(value, &ones);
+    } while (value != 0x0d);
+
+    crc ^= 0xffff;
+    tones += TncCountTones(crc & 0xff, &ones);
+    tones += TncCountTones(crc >> 8, &ones);
+
+    return tones;
+}
+
+/**
+ * Determine if a packet could be queued right now, for callers that would rather
+ * wait than have it dropped.
+ *
+ * @param length number of bytes in the packet, not counting the end of message character or CRC
+ *
+ * @return true if a packet that size would fit in the queue
+ */
+bool_t TncCanQueue(uint16_t length) {
+    uint16_t count;
+
+    if (tncSending || tncStreaming || tncMode == TNC_TX_PREPARE)
+        return FALSE;
+
+    // The queue starts over once the last packets have gone out
+    count = (tncMode == TNC_RX_FLAG ? 0 : tncToneCount);
+
+    // Leave room for the FX.25 or IL2P wrapping and check bytes
+    if (config.framing != TNC_FRAMING_AX25)
+        length += 36;
+
+    return count + ((length + 3) * 8 * 6) / 5 + 16 <= (TNC_QUEUE_TONES - 1) * 8;
+}
+
+/**
+ * Drop the packet being built, leaving the queue the way TncFrameStart() found it.
+ */
+static void TncFrameDiscard(void) {
+    tncToneCount = tncFrameToneCount;
+    tncToneOut = tncFrameToneOut;
+    tncToneMask = tncFrameToneMask;
+    tncLastBit = tncFrameLastBit;
+
+    // Clear the tones this packet put after the last one queued
+    *tncToneOut &= tncToneMask - 1;
+
+    tncStreaming = FALSE;
+    tncFx25Collect = FALSE;
+    tncMode = tncFrameLastMode;
+}
+
+/**
+ * Start a packet in the tone queue, up to where its address fields go.
+ *
+ * @param length number of bytes the caller is about to add
+ *
+ * @return false if we're sending or there's no room for another packet
+ */
+static bool_t TncFrameOpen(uint16_t length) {
+    uint8_t i;
+
+    // Packets can't be queued while we are sending.
+    if (tncSending)
+        return FALSE;
+
+    // Drop a packet that was started but never finished.
+    if (tncMode == TNC_TX_PREPARE)
+        TncFrameDiscard();
+
+    // A streamed packet has to be the last one queued, its tones are still being encoded.
+    if (tncStreaming)
+        return FALSE;
+
+    // Start over at the beginning of the queue once the last packets have gone out.  The
+    // interrupt's count goes too, or a streamed packet would see the queue as empty.
+    if (tncMode == TNC_RX_FLAG) {
+        tncToneCount = 0;
+        tncToneSent = 0;
+    }
+
+    tncFrameLastMode = tncMode;
+    tncMode = TNC_TX_PREPARE;
+    tncFrameOverflow = FALSE;
+    tncFrameRaw = FALSE;
+    tncLength = 0;
+
+    // FX.25 adds the correlation tag and opening flag, 9 bytes.  IL2P adds the sync
+    // word and header block, 18 bytes.
+    if (!TncFrameReserve(length + (config.framing != TNC_FRAMING_AX25 ? 18 : 0))) {
+        tncMode = tncFrameLastMode;
+        return FALSE;
+    }
+
+    // Bit stuff and NRZI encode the packet and the two closing flags ahead of time so
+    // the interrupt only has to pick the next tone.  The first packet starts out on a
+    // space, same as the sync flags sent ahead of it.  The rest follow right behind the
+    // closing flags of the packet before them.
+    if (tncToneCount == 0) {
+        tncToneOut = tncTones;
+        tncToneMask = 0x01;
+        *tncToneOut = 0;
+        tncLastBit = 0;
+
+        // IL2P receivers want alternating tones ahead of the sync word.  Both end on a space.
+        tncSyncTones = (config.framing == TNC_FRAMING_IL2P ? 0x55 : TNC_FLAG_TONES);
+    } else if (tncQueueFraming == TNC_FRAMING_IL2P && config.framing == TNC_FRAMING_AX25)
+        // Nothing ahead of this packet closed with a flag
+        TncEncodeByte(0x7e, 0);
+    tncBitStuff = 0;
+
+    // Remember where this packet starts in case it has to be dropped.
+    tncFrameToneCount = tncToneCount;
+    tncFrameToneOut = tncToneOut;
+    tncFrameToneMask = tncToneMask;
+    tncFrameLastBit = tncLastBit;
+
+    tncFraming = config.framing;
+    tncFx25Collect = FALSE;
+    tncMarkOut = tncToneOut;
+    tncMarkMask = tncToneMask;
+    tncMarkLevel = tncLastBit;
+
+    if (tncFraming == TNC_FRAMING_FX25) {
+        // Hold the correlation tag's place until the packet's size picks the code.  Every
+        // tag has an even number of zeros, so the tone after it is the same as the one
+        // before whichever it turns out to be.
+        for (i = 0; i < 64; ++i)
+            TncEncodeBit(1);
+
+        // The data block is the HDLC bit stream, starting with the opening flag
+        Fx25Init();
+        tncFx25Bits = 0;
+        tncFx25Collect = TRUE;
+        TncEncodeByte(0x7e, 0);
+    } else if (tncFraming == TNC_FRAMING_IL2P) {
+        TncEncodeRawByte((IL2P_SYNC_WORD >> 16) & 0xff);
+        TncEncodeRawByte((IL2P_SYNC_WORD >> 8) & 0xff);
+        TncEncodeRawByte(IL2P_SYNC_WORD & 0xff);
+
+        // Hold the header's place until the payload size is known.  The payload's tones
+        // don't depend on the ones ahead of them.
+        tncMarkOut = tncToneOut;
+        tncMarkMask = tncToneMask;
+        for (i = 0; i < IL2P_HEADER_BLOCK * 8; ++i)
+            TncEncodeBit(1);
+
+        Il2pBlockStart();
+    }
+
+    return TRUE;
+}
+
+/**
+ * Start building an AX.25 packet to add to the transmit queue.  The information
+ * field is added with the TncFrameAppend functions, which bit stuff and NRZI
+ * encode it straight into the tone queue, so it never needs to be collected in a
+ * buffer first.  TncFrameEnd() finishes the packet.
+ *
+ * @param destaddr pointer to the destination address
+ *
+ * @return false if we're sending or there's no room for another packet
+ */
+bool_t TncFrameStart(uint8_t * destaddr) {
+    uint8_t i, value;
+
+    if (!TncFrameOpen(tncHeaderLength + 2))
+        return FALSE;
+
+    // Send the cached address fields.  Most packets go to config.destCallSign and can
+    // pick up the CRC after them; anything else, like a Mic-E destination, takes the
+    // place of the cached one.
+    if (memcmp(destaddr, config.destCallSign, 6) == 0) {
+        for (i = 0; i < tncHeaderLength; ++i)
+            TncFrameEncode(tncHeader[i]);
+        tncFrameCrc = tncHeaderCrc;
+        tncLength = tncHeaderLength;
+    } else {
+        tncFrameCrc = CRC16_INIT;
+        for (i = 0; i < tncHeaderLength; ++i) {
+            value = (i < 6 ? destaddr[i] << 1 : tncHeader[i]);
+            TncFrameByte(value);
+        }
+    }
+
     // Set the control field (UI) and protocol ID.
-    *outBuffer++ = 0x03;
-    *outBuffer++ = 0xf0;
+    TncFrameByte(0x03);
+    TncFrameByte(0xf0);
+
+    return TRUE;
+}
+
+/**
+ * Start building a packet whose address fields, control field, and protocol ID are
+ * added with TncFrameAppend() along with the rest of it, like a frame from a KISS
+ * host.  No end of message character is added; TncFrameEnd() only adds the CRC.
+ *
+ * @return false if we're sending or there's no room for another packet
+ */
+bool_t TncFrameStartRaw(void) {
+    if (!TncFrameOpen(0))
+        return FALSE;
+
+    tncFrameCrc = CRC16_INIT;
+    tncFrameRaw = TRUE;
+
+    return TRUE;
+}
+
+/**
+ * Add bytes to the information field of the packet being built.
+ *
+ * @param data pointer to the bytes
+ * @param length number of bytes
+ */
+void TncFrameAppend(uint8_t * data, uint16_t length) {
+    if (!TncFrameReserve(length))
+        return;
+
+    while (length-- != 0)
+        TncFrameByte(*data++);
+}
+
+/**
+ * Add a NULL terminated string to the information field of the packet being built.
+ *
+ * @param string pointer to the string
+ */
+void TncFrameAppendString(uint8_t * string) {
+    TncFrameAppend(string, strlen((char *) string));
+}
+
+/**
+ * Add a number in decimal to the information field of the packet being built.
+ *
+ * @param value number to add
+ */
+void TncFrameAppendNumber(int32_t value) {
+    uint8_t digits[11], i;
+    uint32_t magnitude;
+
+    magnitude = (value < 0 ? -(uint32_t) value : (uint32_t) value);
+
+    // Digits come out least significant first, so fill the buffer from the end
+    i = sizeof(digits);
+    do {
+        digits[--i] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0)
+        digits[--i] = '-';
+
+    TncFrameAppend(digits + i, sizeof(digits) - i);
+}
+
+/**
+ * Stream the rest of the information field of the packet being built from a source
+ * instead of memory.  Bytes are pulled from the source as room opens up in the tone
+ * queue, while the packet is being sent, so only the address fields and CRC are ever
+ * held in RAM.  This lets the information field go all the way to TNC_MAX_INFO bytes.
+ * It has to be the last part of the packet, and the packet the last one queued.  FX.25
+ * and IL2P packets can't be streamed.
+ *
+ * @param source called in the main loop for each byte
+ * @param length number of bytes to take from the source
+ */
+void TncFrameAppendSource(TNC_SOURCE source, uint16_t length) {
+    if (tncMode != TNC_TX_PREPARE || tncFrameOverflow)
+        return;
+
+    // The end of message character is part of the information field too.  An FX.25
+    // code block or IL2P payload has to be finished before the tag or header ahead of
+    // it can be filled in, so they can't stream.
+    if (tncStreaming || tncFraming != TNC_FRAMING_AX25 || tncLength - tncHeaderLength - 2 + length + 1 > TNC_MAX_INFO) {
+        tncFrameOverflow = TRUE;
+        return;
+    }
 
-    // Add the message to the buffer
-    while (*message != 0) {
-        *outBuffer++ = *message++;
-        ++tncLength;
+    tncSource = source;
+    tncSourceLength = length;
+    tncStreaming = TRUE;
+}
+
+/**
+ * Finish an FX.25 code block after the packet's CRC.  Closes the data block with a
+ * flag, pads it out to the smallest code that fits, adds the check bytes, and fills
+ * in the correlation tag.
+ *
+ * @return false if the packet is too big for any code or the queue
+ */
+static bool_t TncFx25Tail(void) {
+    const FX25_CODE *code;
+    uint8_t i, level, *check;
+
+    TncEncodeByte(0x7e, 0);
+
+    code = Fx25GetCode((tncFx25Bits + 7) / 8);
+    if (code == NULL || tncToneCount + code->dataSize * 8 - tncFx25Bits + (FX25_CHECK_BYTES + 1) * 8 >
+            (TNC_QUEUE_TONES - 1) * 8)
+        return FALSE;
+
+    // Pad with flags, cut off at the end of the block
+    for (i = 0; tncFx25Bits < code->dataSize * 8; ++i)
+        TncEncodeBit((0x7e >> (i & 0x07)) & 0x01);
+    tncFx25Collect = FALSE;
+
+    // The check bytes aren't bit stuffed.  A flag after them lets plain AX.25 receivers
+    // find the next packet.
+    check = Fx25GetCheckBytes();
+    for (i = 0; i < FX25_CHECK_BYTES; ++i)
+        TncEncodeByte(check[i], 0);
+    TncEncodeByte(0x7e, 0);
+
+    // NRZI encode the tag over its place holder, LSB first like everything else
+    level = tncMarkLevel;
+    for (i = 0; i < 64; ++i) {
+        if ((code->tag[i >> 3] & (1 << (i & 0x07))) == 0)
+            level ^= 1;
+        TncPutTone(level);
     }
 
-    // Add the end of message character.
-    *outBuffer++ = 0x0d;
+    return TRUE;
+}
+
+/**
+ * Finish an IL2P packet after its last payload byte.  Sends the rest of the payload
+ * block and its check bytes, then fills in the header block.
+ *
+ * @return false if the payload is too big for one block or the queue
+ */
+static bool_t TncIl2pTail(void) {
+    uint8_t i, *check, header[IL2P_HEADER_BLOCK];
+
+    if (tncLength > IL2P_MAX_BLOCK ||
+            tncToneCount + (IL2P_CHECK_BYTES + 2) * 8 > (TNC_QUEUE_TONES - 1) * 8)
+        return FALSE;
 
-    // Calculate and append the CRC.
-    crc = CRC16(tncBuffer, tncLength);
-    *outBuffer++ = crc & 0xff;
-    *outBuffer = (crc >> 8) & 0xff;
+    TncEncodeRawByte(Il2pBlockEnd());
 
-    // Update the length to include the 2 CRC bytes.
-    tncLength += 2;
+    check = Il2pGetCheckBytes();
+    for (i = 0; i < IL2P_CHECK_BYTES; ++i)
+        TncEncodeRawByte(check[i]);
 
-    // Prepare to send the packet
-    tncBitCount = 0;
-    tncShift = 0x7e;
-    tncLastBit = 0;
-    tncIndex = 0;
+    // The interrupt stops part way through the last tone, so give it one to spare
+    TncEncodeRawByte(0x55);
+
+    // The payload is the whole packet less its CRC
+    Il2pEncodeHeader(tncLength, header);
+    for (i = 0; i < IL2P_HEADER_BLOCK * 8; ++i)
+        TncPutTone((header[i >> 3] >> (7 - (i & 0x07))) & 0x01);
+
+    return TRUE;
+}
+
+/**
+ * Encode the end of the packet:  the end of message character, the CRC, and the two
+ * closing flags, or the rest of the FX.25 code block or IL2P packet.
+ *
+ * @return false if an FX.25 or IL2P packet doesn't fit
+ */
+static bool_t TncFrameTail(void) {
+    uint16_t crc;
+
+    // Add the end of message character, unless the packet came whole from somewhere else.
+    if (!tncFrameRaw)
+        TncFrameByte(0x0d);
+
+    if (tncFraming == TNC_FRAMING_IL2P)
+        return TncIl2pTail();
+
+    // Append the CRC.
+    crc = tncFrameCrc ^ 0xffff;
+    TncEncodeByte(crc & 0xff, 1);
+    TncEncodeByte((crc >> 8) & 0xff, 1);
+
+    if (tncFraming == TNC_FRAMING_FX25)
+        return TncFx25Tail();
+
+    TncEncodeByte(0x7e, 0);
+    TncEncodeByte(0x7e, 0);
+
+    return TRUE;
+}
+
+/**
+ * Encode as much of a streamed packet as fits in the tone queue and hand it to the
+ * interrupt.  The queue holds about 2 seconds of tones at 1200 baud, so as long as
+ * the main loop comes around that often the interrupt never catches up.
+ */
+static void TncStreamUpdate(void) {
+    uint16_t sent;
+
+    if (!tncStreaming)
+        return;
+
+    // Read the interrupt's count in one piece.  It only goes up, so an old value just
+    // leaves a bit less room than there really is.
+    GIEH = 0;
+    sent = tncToneSent;
+    GIEH = 1;
+
+    // A byte is at most 10 tones after stuffing
+    while (tncSourceLength != 0 && tncToneCount - sent + 10 <= (TNC_QUEUE_TONES - 1) * 8) {
+        TncFrameByte(tncSource());
+        --tncSourceLength;
+    }
+
+    // The end of message character, CRC, and flags are at most 46 tones
+    if (tncSourceLength == 0 && tncToneCount - sent + 46 <= (TNC_QUEUE_TONES - 1) * 8) {
+        TncFrameTail();
+
+        GIEH = 0;
+        tncToneReady = tncToneCount;
+        tncStreaming = FALSE;
+        GIEH = 1;
+    } else {
+        GIEH = 0;
+        tncToneReady = tncToneCount;
+        GIEH = 1;
+    }
+}
+
+/**
+ * Finish the packet being built and add it to the transmit queue.  Queued packets
+ * are sent back to back by the next TncSendPacket(), so they share one key-up and
+ * one set of sync flags.  A streamed packet keeps being encoded from RadioUpdate().
+ *
+ * @return true if the packet was queued, false if it didn't fit or none was started
+ */
+bool_t TncFrameEnd(void) {
+    if (tncMode != TNC_TX_PREPARE)
+        return FALSE;
+
+    if (tncFrameOverflow) {
+        TncFrameDiscard();
+        return FALSE;
+    }
+
+    // Ready to send
     tncMode = TNC_TX_SYNC;
+
+    if (tncStreaming) {
+        TncStreamUpdate();
+        return TRUE;
+    }
+
+    if (!TncFrameTail()) {
+        TncFrameDiscard();
+        return FALSE;
+    }
+    tncToneReady = tncToneCount;
+    tncQueueFraming = tncFraming;
+
+    return TRUE;
+}
+
+/**
+ * Drop the packet being built, if there is one, for a caller that finds out part way
+ * through that it can't finish it.
+ */
+void TncFrameAbort(void) {
+    if (tncMode == TNC_TX_PREPARE)
+        TncFrameDiscard();
+}
+
+/**
+ * Prepare an AX.25 packet for transmission and add it to the transmit queue.
+ *
+ * @param message pointer to NULL terminate message string
+ * @param destaddr pointer to the destination address
+ *
+ * @return true if the packet was queued, false if we're sending or the queue is full
+ */
+bool_t TncPreparePacket(uint8_t * message, uint8_t * destaddr) {
+    if (!TncFrameStart(destaddr))
+        return FALSE;
+
+    TncFrameAppendString(message);
+
+    return TncFrameEnd();
 }
 
 /**
@@ -172,6 +1007,26 @@ void TncPreparePacket(uint8_t * message, uint8_t * destaddr) {
  * @param bitValue zero for a 1200hz tone, non-zero for a 2200hz tone
  */
 void TncCalTones(unsigned bitValue) {
+#if TNC_DDS
+    TncOutputInit();
+    PR2 = TNC_DDS_PR2;
+
+    if (bitValue)
+        tncPhaseStep = TNC_DDS_MARK;
+    else
+        tncPhaseStep = TNC_DDS_SPACE;
+
+    while (FifoRead() != 'q') {
+        // Output the next sample of the sin wave
+        tncPhase += tncPhaseStep;
+        TncOutputSample(tncPhase);
+
+        while (!TMR2IF) {
+            // wait for the timer to overflow.  This sets the sample rate
+        }
+        TMR2IF = 0;
+    } // end while loop
+#else
     while (FifoRead() != 'q') {
         // Output the next step of the sin wave.  The rest of the code in this function determines the
         // frequency of this wave.
@@ -189,149 +1044,185 @@ void TncCalTones(unsigned bitValue) {
         }
         TMR2IF = 0;
     } // end while loop
+#endif
 }
 
 /**
- * Send the prepared packet via the onboard 4-bit resistor DAC.  
+ * Start sending the queued packets via the onboard 4-bit resistor DAC or PWM.  The
+ * packets are clocked out by TncTimer2Interrupt() so this returns right away;
+ * poll TncIsSending() to find out when the last flag has gone out.
  */
 void TncSendPacket(void) {
-    // disable interrupts so as not to mess up packet timing
-    uint8_t temp = INTCON;
-    INTCON &= 0x3F;
+    // Nothing to do unless TncPreparePacket() has a packet ready for us.
+    if (tncMode != TNC_TX_SYNC)
+        return;
+
+    tncBitCount = 0;
+    tncShift = tncSyncTones;
+    tncIndex = 0;
+    tncToneSent = 0;
+    tncModulation = config.modulation;
+    tncSending = TRUE;
+    tncHalfBit = 0;
+
+    TncOutputInit();
+
+    if (tncModulation == TNC_G3RUH_9600) {
+        // 9600 baud is 8 times faster, send 8 times the flags to keep the same txDelay time.
+        tncSyncFlags = config.txDelay * 8;
+        tncLevel = TNC_G3RUH_LOW;
+        PR2 = TNC_G3RUH_PR2;
+    } else {
+        tncSyncFlags = config.txDelay;
+
+#if TNC_DDS
+        // Fixed sample rate.  Start the bit clock just short of wrapping so the first
+        // sample starts the first bit.
+        PR2 = TNC_DDS_PR2;
+        tncBaudPhase = -TNC_DDS_BAUD;
+#endif
+    }
+
+    // Force the first interrupt right away so the first sin step goes out at once.
+    TMR2IF = 1;
+    TMR2IE = 1;
+}
+
+/**
+ * Determine if a packet is still being sent.
+ *
+ * @return true until the last closing flag of the packet has been sent
+ */
+bool_t TncIsSending(void) {
+    return tncSending;
+}
+
+/**
+ * Timer 2 interrupt handler.  Runs once per step of the sin wave while a packet
+ * is being sent and walks the packet through the sync and data states.
+ * Must be called from the high priority interrupt so nothing delays the steps.
+ */
+void TncTimer2Interrupt(void) {
+    uint8_t bit;
+
+    TMR2IF = 0;
+
+    // The last closing flag has gone out, so stop here.  A G3RUH bit finishes its second half first.
+    if (tncMode == TNC_RX_FLAG && !tncHalfBit) {
+        TMR2IE = 0;
+        tncSending = FALSE;
+        return;
+    }
+
+    if (tncModulation == TNC_G3RUH_9600) {
+        // Two samples per bit.  The second half of the bit sits at the bit's level.
+        if (tncHalfBit) {
+            tncHalfBit = 0;
+            TncOutputSample(tncLevel);
+            return;
+        }
+        tncHalfBit = 1;
 
-    while (tncMode != TNC_RX_FLAG) {
+        // Scramble the NRZI encoded bit with x^17 + x^12 + 1 so the receiver sees plenty of transitions
+        bit = tncShift & 0x01;
+        if (tncScrambler & 0x00000800)
+            bit ^= 1;
+        if (tncScrambler & 0x00010000)
+            bit ^= 1;
+        tncScrambler = (tncScrambler << 1) | bit;
+
+        // Send the next bit as a peak or a trough of the sin table, stopping at the zero
+        // crossing for the first half of a bit that changes level.
+        if ((tncLevel == TNC_G3RUH_HIGH) == bit) {
+            TncOutputSample(tncLevel);
+        } else {
+            TncOutputSample(0);
+            tncLevel = bit ? TNC_G3RUH_HIGH : TNC_G3RUH_LOW;
+        }
+    } else {
+#if TNC_DDS
+        // Output the next sample of the sin wave.  tncPhaseStep determines the frequency of this wave,
+        // and changing it doesn't break the phase.
+        tncPhase += tncPhaseStep;
+        TncOutputSample(tncPhase);
+
+        // Advance the bit clock, a whole number of bits is exactly 1200 baud on average.
+        tncBaudPhase += TNC_DDS_BAUD;
+        if (tncBaudPhase >= TNC_DDS_BAUD)
+            return;
+
+        // Send the next tone.  tncShift holds the tones of the current byte, LSB first.
+        if (tncShift & 0x01)
+            tncPhaseStep = TNC_DDS_MARK;
+        else
+            tncPhaseStep = TNC_DDS_SPACE;
+#else
         // Output the next step of the sin wave.  The rest of the code in this function determines the
         // frequency of this wave.
         PORTA = sinDAC[sinIndex];
         sinIndex++;
-        //index &= 0x1F;
         sinIndex &= 0x0F;
 
-        if (timeElapsed >= BAUD) {
-            timeElapsed = timeElapsed - BAUD;
-
-            switch (tncMode) {
-                    // Send the flag 0x7E to begin the packet.  No bitstuffing here.  This lets the RX end sync up, and
-                    // is the only time it'll see 5 1's in a row
-                case TNC_TX_SYNC:
-                    // The variable tncShift contains the lastest data byte.  Data is sent LSB first
-                    // NRZI enocde the data stream.
-                    if ((tncShift & 0x01) == 0x00) {
-                        if (tncLastBit == 0) {
-                            tncLastBit = 1;
-                            PR2 = MARK;
-                        } else {
-                            tncLastBit = 0;
-                            PR2 = SPACE;
-                        }
-                    }
-                    // When the flag is done, determine if we need to send more or data.
-                    if (++tncBitCount == 8) {
-                        tncBitCount = 0;
-                        tncShift = 0x7e;
-
-                        // Once we transmit x mS of flags, send the data.
-                        // txDelay bytes * 8 bits/byte * 833uS/bit = x mS
-                        if (++tncIndex == config.txDelay) {
-                            tncIndex = 0;
-                            tncShift = tncBuffer[0];
-                            tncBitStuff = 0;
-                            tncMode = TNC_TX_DATA;
-                        } // END if
-                    } else
-                        tncShift = tncShift >> 1;
-                    break;
-
-                case TNC_TX_DATA:
-                    // Start sending the prepared message.  This includes src and dest callsigns
-                    // Bitstuffing; If there's been 5 ones in a row, send a zero
-                    if (tncBitStuff == 0x1f) {
-                        if (tncLastBit == 0) {
-                            tncLastBit = 1;
-                            PR2 = MARK;
-                        } else {
-                            tncLastBit = 0;
-                            PR2 = SPACE;
-                        }
-                        tncBitStuff = 0x00;
-                        //timeElapsed = 0;
-                    } else {
-                        // The variable tncShift contains the lastest data byte.
-                        // NRZI enocde the data stream.
-                        if ((tncShift & 0x01) == 0x00) {
-                            if (tncLastBit == 0) {
-                                tncLastBit = 1;
-                                PR2 = MARK;
-                            } else {
-                                tncLastBit = 0;
-                                PR2 = SPACE;
-                            }
-                        }
-
-                        // Save the data stream so we can determine if bit stuffing is
-                        // required on the next bit time.
-                        tncBitStuff = ((tncBitStuff << 1) | (tncShift & 0x01)) & 0x1f;
-
-                        // If all the bits were shifted, get the next byte.
-                        if (++tncBitCount == 8) {
-                            tncBitCount = 0;
-
-                            // If everything was sent, transmit closing flags.
-                            if (++tncIndex == tncLength) {
-                                tncShift = 0x7e;
-                                tncIndex = 0;
-                                tncMode = TNC_TX_END;
-                            } else {
-                                tncShift = tncBuffer[tncIndex];
-                            }
-                        } else {
-                            tncShift = tncShift >> 1;
-                        }
-                    }
-                    break;
-
-                case TNC_TX_END:
-                    // Transmit the closing flags.  No bitstuffing here either
-                    // NRZI enocde the data stream.
-                    if ((tncShift & 0x01) == 0x00) {
-                        if (tncLastBit == 0) {
-                            tncLastBit = 1;
-                            PR2 = MARK;
-                        } else {
-                            tncLastBit = 0;
-                            PR2 = SPACE;
-                        }
-                    }
-                    // If all the bits were shifted, get the next one.
-                    if (++tncBitCount == 8) {
-                        tncBitCount = 0;
-                        tncShift = 0x7e;
-
-                        // Transmit two closing flags.
-                        if (++tncIndex == 2) {
-                            // Reset to the receive mode.
-                            tncIndex = 0;
-                            tncShift = 0;
-                            tncMode = TNC_RX_FLAG;
-                        }
-                    } else
-                        tncShift = tncShift >> 1;
-                    break;
-            } // end switch
+        // Count the time each step of the sin wave takes.  PR2 holds the period of the step
+        // that was just started.
+        if (timeElapsed < BAUD) {
+            timeElapsed += PR2;
+            return;
         }
+        timeElapsed = timeElapsed - BAUD;
+
+        // Send the next tone.  tncShift holds the tones of the current byte, LSB first.
+        if (tncShift & 0x01)
+            PR2 = MARK;
+        else
+            PR2 = SPACE;
 
-        while (!TMR2IF) {
-            // wait for the timer to overflow.  This wait time determines the frequency of the sin
-        }
-        TMR2IF = 0;
         timeElapsed += PR2;
-    } // end while loop
+#endif
+    }
+
+    switch (tncMode) {
+            // Send the flag 0x7E to begin the packet.  This lets the RX end sync up, and
+            // is the only time it'll see 6 1's in a row
+        case TNC_TX_SYNC:
+            if (++tncBitCount == 8) {
+                tncBitCount = 0;
+                tncShift = tncSyncTones;
+
+                // Once we transmit x mS of flags, send the data.
+                // txDelay bytes * 8 bits/byte * 833uS/bit = x mS.  A txDelay of 0 still sends one.
+                if (++tncIndex >= tncSyncFlags) {
+                    tncIndex = 0;
+                    tncShift = tncTones[0];
+                    tncMode = TNC_TX_DATA;
+                } // END if
+            } else
+                tncShift = tncShift >> 1;
+            break;
 
-    // restore interrupts
-    INTCON = temp;
+        case TNC_TX_DATA:
+            // Send the prepared tones.  This includes the message and closing flags
+            if (++tncToneSent == tncToneReady) {
+                if (!tncStreaming) {
+                    // Reset to the receive mode.
+                    tncIndex = 0;
+                    tncShift = 0;
+                    tncMode = TNC_RX_FLAG;
+                    break;
+                }
 
-    // clear any UART errors in the event a character was received while interrupts were disabled
-    SerialClearErrors();
+                // The main loop fell behind on a streamed packet.  Hold this tone until it
+                // catches up; the packet is lost, but the ones after it aren't.
+                --tncToneSent;
+            } else if (++tncBitCount == 8) {
+                tncBitCount = 0;
+                if (++tncIndex == TNC_QUEUE_TONES)
+                    tncIndex = 0;
+                tncShift = tncTones[tncIndex];
+            } else
+                tncShift = tncShift >> 1;
+            break;
+    } // end switch
 }
 
 /**
@@ -342,15 +1233,109 @@ void RadioRX(void) {
 }
 
 /**
- * Puts the radio into transmit mode
+ * Puts the radio into transmit mode.  The radio needs config.keyUpDelay ticks
+ * before it's ready for audio; RadioTransmit() takes care of that.
  */
 void RadioTX(void) {
-    int i;
     PORTC |= (1u << 1);
-    
-    // give the radio time to key up
-    for (i = 0; i < 20; i++)
-        __delay_ms(10);
 }
 
-/** @} */
\ No newline at end of file
+/**
+ * Key up the radio and send the queued packets.  This only starts the sequence;
+ * RadioUpdate() waits for the channel to clear, then walks it through key-up,
+ * transmit, and key-down.  Packets can still be queued until the radio has keyed up.
+ * Packets queued while it's waiting to key down go out before it does.
+ */
+void RadioTransmit(void) {
+    if (radioState == RADIO_IDLE)
+        radioState = RADIO_START;
+    else if (radioState == RADIO_TAIL) {
+        // Still keyed, so they only need new sync flags
+        TncSendPacket();
+        radioState = RADIO_TRANSMITTING;
+    }
+}
+
+/**
+ * Determine if the radio is keyed or about to be.
+ *
+ * @return true until the radio is back in receive mode
+ */
+bool_t RadioIsBusy(void) {
+    return radioState != RADIO_IDLE;
+}
+
+/**
+ * Steps the key-up, transmit, key-down sequence.  Call it from the main loop.
+ *
+ * @param tick current system tick (50 mS)
+ */
+void RadioUpdate(uint32_t tick) {
+    // Keep a streamed packet's tones ahead of the interrupt
+    TncStreamUpdate();
+
+    switch (radioState) {
+        case RADIO_IDLE:
+            break;
+
+        case RADIO_START:
+            radioTick = tick;
+            radioSlotTick = tick;
+            radioState = RADIO_CHANNEL_BUSY;
+            break;
+
+        case RADIO_CHANNEL_BUSY:
+            // Don't step on someone else's packet, but don't wait forever on a stuck carrier either.
+            // Once it's clear, go with a chance of config.persistence in 256 each slot time so
+            // stations that were all waiting don't key up at once.
+            if (tick - radioTick <= RADIO_BUSY_TIMEOUT) {
+#if DEMOD_ENABLE
+                if (DemodIsChannelBusy())
+                    break;
+#endif
+                if ((int32_t) (tick - radioSlotTick) < 0)
+                    break;
+
+                if ((uint8_t) rand() > config.persistence) {
+                    radioSlotTick = tick + config.slotTime;
+                    break;
+                }
+            }
+
+#if DEMOD_ENABLE
+            DemodStop();
+#endif
+            RadioTX();
+            radioTick = tick;
+            radioState = RADIO_KEYING;
+            break;
+
+        case RADIO_KEYING:
+            // give the radio time to key up.  Wait for whole ticks since the first may be partial.
+            if (tick - radioTick > config.keyUpDelay) {
+                TncSendPacket();
+                radioState = RADIO_TRANSMITTING;
+            }
+            break;
+
+        case RADIO_TRANSMITTING:
+            if (!TncIsSending()) {
+                radioTick = tick;
+                radioState = RADIO_TAIL;
+            }
+            break;
+
+        case RADIO_TAIL:
+            // Let the last flag get through the radio before dropping it.
+            if (tick != radioTick) {
+                RadioRX();
+#if DEMOD_ENABLE
+                DemodStart();
+#endif
+                radioState = RADIO_IDLE;
+            }
+            break;
+    }
+}
+
+/** @} */
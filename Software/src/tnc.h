@@ -32,13 +32,33 @@
  * @{
  */
 
+/// Supplies the next byte of a streamed information field, see TncFrameAppendSource()
+typedef uint8_t (*TNC_SOURCE)(void);
+
 void TncConfigDefault(); // Configure the TNC
-void TncPreparePacket(uint8_t * message, uint8_t * destaddr); // Prepare a packet to send
-void TncSendPacket(void); // Send a packet via the 4 bit DAC
+void TncBuildHeader(void); // Rebuild the cached address fields after the config changes
+bool_t TncPreparePacket(uint8_t * message, uint8_t * destaddr); // Prepare a packet and queue it to send
+bool_t TncFrameStart(uint8_t * destaddr); // Start building a packet to queue
+bool_t TncFrameStartRaw(void); // Start building a packet that brings its own address fields
+void TncFrameAppend(uint8_t * data, uint16_t length); // Add bytes to the packet's information field
+void TncFrameAppendString(uint8_t * string); // Add a string to the packet's information field
+void TncFrameAppendNumber(int32_t value); // Add a decimal number to the packet's information field
+void TncFrameAppendSource(TNC_SOURCE source, uint16_t length); // Stream the rest of the information field from a source
+bool_t TncFrameEnd(void); // Finish the packet and queue it to send
+void TncFrameAbort(void); // Drop the packet being built
+bool_t TncCanQueue(uint16_t length); // True if a packet that size would fit in the queue
+uint16_t TncFrameTones(uint8_t * message, uint8_t * destaddr); // Count the tones a packet would take
+void TncSendPacket(void); // Start sending the queued packets via the 4 bit DAC
+bool_t TncIsSending(void); // True while a packet is being sent
+void TncTimer2Interrupt(void); // Timer 2 interrupt handler, clocks out the packet
 void RadioRX(void);
 void RadioTX(void);
+void RadioTransmit(void); // Key up and send the queued packets
+bool_t RadioIsBusy(void); // True until the radio is back in receive mode
+void RadioUpdate(uint32_t tick); // Step the key-up and key-down sequence
 void TncCalTones(unsigned bitValue); // generate a mark or space tone to allow calibration
 uint16_t CRC16(uint8_t *buffer, uint16_t length); // Generate a 16 bit CRC
+uint16_t Crc16Update(uint16_t crc, uint8_t value); // Add a byte to a running 16 bit CRC
 
 /*
  * Declare global vars and data structures
@@ -48,6 +68,16 @@ uint16_t CRC16(uint8_t *buffer, uint16_t length); // Generate a 16 bit CRC
 typedef struct {
     /// Sets how many sync flags we'll send at the beginning of the packet
     uint8_t txDelay;
+    /// How long the radio gets to key up before the sync flags, in system ticks (50 mS)
+    uint8_t keyUpDelay;
+    /// Chance of keying up each slot time once the channel is clear, (persistence + 1) / 256
+    uint8_t persistence;
+    /// Time between p-persistence tries, in system ticks (50 mS)
+    uint8_t slotTime;
+    /// How packets are sent, TNC_AFSK_1200 or TNC_G3RUH_9600
+    uint8_t modulation;
+    /// How packets are framed, TNC_FRAMING_AX25, TNC_FRAMING_FX25, or TNC_FRAMING_IL2P
+    uint8_t framing;
     /// The Beacon's Callsign
     uint8_t callSign[7];
     /// Destination Callsign
@@ -66,19 +96,61 @@ typedef struct {
     uint16_t flightTime;
 } CONFIG_STRUCT;
 
+/// The TNC configuration, set up by TncConfigDefault()
+extern CONFIG_STRUCT config;
+
+/// Steps of keying the radio to send packets
+typedef enum {
+    /// The radio is in receive mode
+    RADIO_IDLE,
+    /// RadioTransmit() was called, check the channel on the next RadioUpdate()
+    RADIO_START,
+    /// Waiting for someone else to finish sending
+    RADIO_CHANNEL_BUSY,
+    /// Waiting for the radio to key up
+    RADIO_KEYING,
+    /// Sending the queued packets
+    RADIO_TRANSMITTING,
+    /// Waiting for the last flag to get through the radio
+    RADIO_TAIL
+} RADIO_STATE;
 
-/// The maximum number of characters we can send through the TNC
+/// Longest we'll wait for a busy channel to clear before sending anyway, in 50 mS ticks
+#define RADIO_BUSY_TIMEOUT 60
+
+/// The maximum size of a packet built from memory, including the CRC.  Sizes the tone queue.
 #define TNC_MAX_TX 128
+/// The maximum AX.25 information field, reachable by streaming it with TncFrameAppendSource()
+#define TNC_MAX_INFO 256
 /// The TNC is currently not sending
 #define TNC_RX_FLAG 0
 /// We're currently preparing a packet to send
 #define TNC_TX_PREPARE 3
-/// We're sending sync flags to start the packet(0x7E)
+/// Packets are queued, or we're sending sync flags to start them (0x7E)
 #define TNC_TX_SYNC 4
-/// We're sending the packet data
+/// We're sending the packets and their closing flags
 #define TNC_TX_DATA 5
-/// We're closing the packet
-#define TNC_TX_END 6
+
+/// Room for the encoded destination, source, and two relay addresses
+#define TNC_MAX_HEADER (4 * 7)
+
+/// Starting value for Crc16Update()
+#define CRC16_INIT 0xffff
+
+/// Room for the tones of a packet after bit stuffing (1 in 6 worst case), plus the two closing flags
+#define TNC_MAX_TONES (((TNC_MAX_TX * 8 * 6) / 5 + 16) / 8 + 1)
+/// Room for the tones of the transmit queue, two of the largest packets
+#define TNC_QUEUE_TONES (2 * TNC_MAX_TONES)
+
+/// Plain AX.25 packets
+#define TNC_FRAMING_AX25 0
+/// AX.25 packets wrapped in FX.25 forward error correction.  Plain AX.25 receivers still decode them.
+#define TNC_FRAMING_FX25 1
+/// IL2P packets:  scrambled instead of bit stuffed, with Reed-Solomon check bytes.  Needs an IL2P receiver.
+#define TNC_FRAMING_IL2P 2
+
+/// Tones of a flag sent starting from a space.  It ends on a space, so every sync flag is the same.
+#define TNC_FLAG_TONES 0x7f
 
 /// 1200 Hz tone for a mark.  Calculated by (Fosc/4/2)/(1200*16)
 #define     MARK    207
@@ -87,6 +159,45 @@ typedef struct {
 /// 1200 Baud.  In units of timer 2 (no pre, post scalar 1:2), so calculated by (Fosc/4/2)/(1200)
 #define     BAUD    3300
 
+/// Bell 202 AFSK, 1200 baud with 1200 Hz mark and 2200 Hz space tones
+#define TNC_AFSK_1200 0
+/// G3RUH 9600 baud scrambled baseband FSK, for radios with a 9600 data port.  The audio filter
+/// after the DAC has to pass it.
+#define TNC_G3RUH_9600 1
+
+/// Timer 2 period for G3RUH.  With the 1:2 post scalar that's 2 samples per bit at 9615 baud
+#define TNC_G3RUH_PR2 207
+/// G3RUH high and low levels as sin table phases, the peak and the trough.  Phase 0 is the middle.
+#define TNC_G3RUH_HIGH 0x4000
+#define TNC_G3RUH_LOW 0xc000
+
+/// Set to 1 to generate the tones by direct digital synthesis: timer 2 runs at a fixed sample
+/// rate and a phase accumulator steps through the sin table, instead of changing PR2 per tone.
+#ifndef TNC_DDS
+#define TNC_DDS 0
+#endif
+
+/// Audio comes out of the 4-bit resistor DAC on PORTA
+#define TNC_OUTPUT_DAC 0
+/// Audio comes out of the CCP1 PWM on RC2 from a 64 step, 8-bit sin table.  Needs TNC_DDS.  RC2 is
+/// the SD card chip select on the PICTrack board, so this is only for boards wired for it.
+#define TNC_OUTPUT_PWM 1
+/// Selects where the audio comes out
+#ifndef TNC_OUTPUT
+#define TNC_OUTPUT TNC_OUTPUT_DAC
+#endif
+
+/// Timer 2 period in DDS mode.  With the 1:2 post scalar the sample rate is (Fosc/4/2)/(PR2 + 1), 38461 Hz
+#define TNC_DDS_PR2 103
+/// Phase accumulator step for frequency f at the DDS sample rate, 65536 * f / sample rate, rounded
+#define TNC_DDS_STEP(f) ((uint16_t) (((f) * (TNC_DDS_PR2 + 1UL) * 2048UL + _XTAL_FREQ / 512) / (_XTAL_FREQ / 256)))
+/// 1200 Hz mark tone in DDS mode
+#define TNC_DDS_MARK TNC_DDS_STEP(1200)
+/// 2200 Hz space tone in DDS mode
+#define TNC_DDS_SPACE TNC_DDS_STEP(2200)
+/// 1200 baud bit clock in DDS mode
+#define TNC_DDS_BAUD TNC_DDS_STEP(1200)
+
 /** @} */
 
 #endif /* AX25_H */
\ No newline at end of file
@@ -0,0 +1,11 @@
+/*
+ * Stand-in for Microchip's GenericTypeDefs.h on a host build.
+ */
+
+#ifndef GENERIC_TYPE_DEFS_H
+#define GENERIC_TYPE_DEFS_H
+
+#define TRUE 1
+#define FALSE 0
+
+#endif  // #ifndef GENERIC_TYPE_DEFS_H
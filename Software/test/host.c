@@ -0,0 +1,317 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <htc.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+
+/**
+ * @defgroup host Host Test Harness
+ *
+ * Runs the firmware on a PC, so the modulator can be heard and measured without
+ * the hardware.  The registers in htc.h are variables here.  Timer 2 runs at its
+ * real rate, Fosc/4 through the 1:2 post scalar:  each interrupt comes PR2 + 1
+ * ticks after the last, counting the PR2 that interrupt set up, the same as the
+ * hardware.  The system tick RadioUpdate() sees comes from the same clock.
+ *
+ * Every sample TncTimer2Interrupt() puts on the DAC is logged with its time and
+ * the timer period, or the PWM duty cycle when it's built for TNC_OUTPUT_PWM, and HostWriteWav() resamples the log to a WAV file for a
+ * software TNC or an audio editor.
+ *
+ * @{
+ */
+
+volatile uint8_t PORTA, PORTC, PR2, INTCON;
+volatile uint8_t TMR2IF, TMR2IE, GIEH;
+volatile uint8_t CCPR1L, CCP1CON;
+volatile CCP1CONbits_t CCP1CONbits;
+volatile uint8_t ADRESH, ADIF, ADIE, ADIP, ADCON0, ADCON1, ADCON2;
+volatile uint8_t T3CON, CCPR2H, CCPR2L, CCP2CON;
+volatile TRISAbits_t TRISAbits;
+
+/// Every DAC write since HostReset()
+HOST_DAC_WRITE *hostDac;
+uint32_t hostDacCount;
+
+/// Room in hostDac
+static uint32_t hostDacSize;
+
+/// Timer 2 ticks since HostReset()
+uint64_t hostTime;
+
+/// Time of the next timer 2 match
+static uint64_t hostMatch;
+
+/// Checks made and checks failed
+static uint32_t hostChecks, hostFailures;
+
+/**
+ * Start over with power-on registers, the clock at zero, and an empty DAC log.
+ */
+void HostReset(void) {
+    free(hostDac);
+    hostDac = NULL;
+    hostDacCount = 0;
+    hostDacSize = 0;
+
+    hostTime = 0;
+    hostMatch = 0;
+
+    PORTA = 0;
+    PORTC = 0;
+    CCPR1L = 0;
+    CCP1CON = 0;
+    CCP1CONbits.DC1B = 0;
+    PR2 = 255;
+    INTCON = 0;
+    TMR2IF = 0;
+    TMR2IE = 0;
+    GIEH = 1;
+}
+
+/**
+ * Convert what was written to PORTA to a DAC level.  The resistor ladder has RA0
+ * as its most significant bit.
+ *
+ * @param port PORTA
+ *
+ * @return level from 0 to 15
+ */
+static uint8_t HostDacLevel(uint8_t port) {
+    return ((port & 0x01) << 3) | ((port & 0x02) << 1) | ((port & 0x04) >> 1) | ((port & 0x08) >> 3);
+}
+
+/**
+ * Add the sample the interrupt just wrote to the DAC log.
+ */
+static void HostLogDac(void) {
+    if (hostDacCount == hostDacSize) {
+        hostDacSize = (hostDacSize == 0 ? 65536 : hostDacSize * 2);
+        hostDac = realloc(hostDac, hostDacSize * sizeof(HOST_DAC_WRITE));
+        if (hostDac == NULL) {
+            fprintf(stderr, "Out of memory for the DAC log\n");
+            exit(1);
+        }
+    }
+
+    hostDac[hostDacCount].time = hostTime;
+#if TNC_OUTPUT == TNC_OUTPUT_PWM
+    hostDac[hostDacCount].level = (CCPR1L << 2) | CCP1CONbits.DC1B;
+#else
+    hostDac[hostDacCount].level = HostDacLevel(PORTA);
+#endif
+    hostDac[hostDacCount].pr2 = PR2;
+    ++hostDacCount;
+}
+
+/**
+ * Run whatever happens next:  a pending timer 2 interrupt, or the clock up to
+ * the next timer 2 match or system tick, whichever comes first.  The main loop
+ * should call RadioUpdate() between steps.
+ */
+void HostStep(void) {
+    uint64_t tick;
+
+    if (TMR2IF && TMR2IE) {
+        TncTimer2Interrupt();
+
+        // Each interrupt puts a sample on the DAC, except the last that turns itself off
+        if (TMR2IE)
+            HostLogDac();
+
+        // The timer restarted at the match, so the new PR2 sets the period that's running now
+        hostMatch = hostTime + PR2 + 1;
+        return;
+    }
+
+    tick = (hostTime / HOST_SYS_TICK + 1) * HOST_SYS_TICK;
+    if (TMR2IE && hostMatch < tick) {
+        hostTime = hostMatch;
+        TMR2IF = 1;
+    } else
+        hostTime = tick;
+}
+
+/**
+ * Get the system tick for the simulated time.
+ *
+ * @return 50 mS ticks since HostReset()
+ */
+uint32_t HostSysTick(void) {
+    return (uint32_t) (hostTime / HOST_SYS_TICK);
+}
+
+/**
+ * Send the queued packets the way the main loop does, then come back once the
+ * radio is back in receive mode.
+ */
+void HostRadioSend(void) {
+    RadioTransmit();
+
+    while (RadioIsBusy()) {
+        RadioUpdate(HostSysTick());
+        HostStep();
+    }
+}
+
+/**
+ * Write a 16 bit little endian value.
+ */
+static void HostPut16(FILE *file, uint16_t value) {
+    fputc(value & 0xff, file);
+    fputc(value >> 8, file);
+}
+
+/**
+ * Write a 32 bit little endian value.
+ */
+static void HostPut32(FILE *file, uint32_t value) {
+    HostPut16(file, value & 0xffff);
+    HostPut16(file, value >> 16);
+}
+
+/**
+ * Resample the DAC log to HOST_WAV_RATE, from the first DAC write to the end of
+ * the last.  Each sample is the average DAC level over its period, so the steps
+ * don't alias into the audio.  Full scale is about +/-30000.
+ *
+ * @param samples set to the samples, which the caller frees
+ *
+ * @return number of samples
+ */
+uint32_t HostAudio(int16_t **samples) {
+    uint64_t start, end;
+    uint32_t count, i, n;
+    double from, to, sum, edge;
+
+    *samples = NULL;
+    if (hostDacCount == 0)
+        return 0;
+
+    // The last sample lasts one more timer period
+    start = hostDac[0].time;
+    end = hostDac[hostDacCount - 1].time + hostDac[hostDacCount - 1].pr2 + 1;
+    count = (uint32_t) (((end - start) * HOST_WAV_RATE) / HOST_TIMER2_RATE);
+
+    *samples = malloc(count * sizeof(int16_t) + 1);
+    if (*samples == NULL) {
+        fprintf(stderr, "Out of memory for the audio\n");
+        exit(1);
+    }
+
+    i = 0;
+    for (n = 0; n < count; ++n) {
+        // Timer ticks this sample covers, after the first DAC write
+        from = (double) n * HOST_TIMER2_RATE / HOST_WAV_RATE;
+        to = (double) (n + 1) * HOST_TIMER2_RATE / HOST_WAV_RATE;
+
+        // Add up the levels held over it, around the middle of the DAC
+        sum = 0;
+        while (from < to) {
+            while (i + 1 < hostDacCount && hostDac[i + 1].time - start <= from)
+                ++i;
+            edge = (i + 1 < hostDacCount ? (double) (hostDac[i + 1].time - start) : to);
+            if (edge > to)
+                edge = to;
+            sum += (edge - from) * (2 * hostDac[i].level - HOST_DAC_FULL);
+            from = edge;
+        }
+
+        (*samples)[n] = (int16_t) (sum * HOST_WAV_RATE / HOST_TIMER2_RATE * 30000 / HOST_DAC_FULL);
+    }
+
+    return count;
+}
+
+/**
+ * Save the DAC log as a 16 bit mono WAV file at HOST_WAV_RATE, with 50 mS of
+ * silence on either end.
+ *
+ * @param name file to write
+ *
+ * @return true if it was written
+ */
+bool_t HostWriteWav(const char *name) {
+    FILE *file;
+    int16_t *samples;
+    uint32_t count, pad, n;
+
+    count = HostAudio(&samples);
+    if (count == 0)
+        return FALSE;
+    pad = HOST_WAV_RATE / 20;
+
+    file = fopen(name, "wb");
+    if (file == NULL) {
+        free(samples);
+        return FALSE;
+    }
+
+    fputs("RIFF", file);
+    HostPut32(file, 36 + (count + 2 * pad) * 2);
+    fputs("WAVEfmt ", file);
+    HostPut32(file, 16);
+    HostPut16(file, 1);
+    HostPut16(file, 1);
+    HostPut32(file, HOST_WAV_RATE);
+    HostPut32(file, HOST_WAV_RATE * 2);
+    HostPut16(file, 2);
+    HostPut16(file, 16);
+    fputs("data", file);
+    HostPut32(file, (count + 2 * pad) * 2);
+
+    for (n = 0; n < pad; ++n)
+        HostPut16(file, 0);
+    for (n = 0; n < count; ++n)
+        HostPut16(file, (uint16_t) samples[n]);
+    for (n = 0; n < pad; ++n)
+        HostPut16(file, 0);
+
+    free(samples);
+    return fclose(file) == 0;
+}
+
+/**
+ * Count a check, and print what it was if it failed.
+ *
+ * @param ok result of the check
+ * @param format printf format describing it, followed by its arguments
+ *
+ * @return ok
+ */
+bool_t HostCheck(bool_t ok, const char *format, ...) {
+    va_list args;
+
+    ++hostChecks;
+    if (ok)
+        return TRUE;
+
+    ++hostFailures;
+    fprintf(stderr, "FAIL: ");
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+
+    return FALSE;
+}
+
+/**
+ * Print how the checks went.
+ *
+ * @param name name of the test
+ *
+ * @return exit status for main(), 0 if they all passed
+ */
+int HostReport(const char *name) {
+    if (hostFailures != 0) {
+        printf("%s: %u of %u checks failed\n", name, hostFailures, hostChecks);
+        return 1;
+    }
+
+    printf("%s: %u checks passed\n", name, hostChecks);
+    return 0;
+}
+
+/** @} */
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     host.h                                                    *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef HOST_H
+#define HOST_H
+
+#include "main.h"
+#include "tnc.h"
+
+/**
+ * @defgroup host Host Test Harness
+ *
+ * @{
+ */
+
+/// One write to the DAC, and the timer 2 period that was running when it was made
+typedef struct {
+    /// Timer 2 ticks since HostReset()
+    uint64_t time;
+    /// DAC level or PWM duty cycle, 0 to HOST_DAC_FULL
+    uint16_t level;
+    /// PR2 after the interrupt
+    uint8_t pr2;
+} HOST_DAC_WRITE;
+
+void HostReset(void); // Clear the registers, the clock, and the DAC log
+void HostStep(void); // Run the clock to the next timer 2 interrupt or system tick
+uint32_t HostSysTick(void); // System tick (50 mS) for the current time
+void HostRadioSend(void); // Key up, send the queued packets, and wait for key down
+uint32_t HostAudio(int16_t **samples); // Resample the DAC log to HOST_WAV_RATE
+bool_t HostWriteWav(const char *name); // Save the DAC log as a 48 kHz WAV file
+bool_t HostCheck(bool_t ok, const char *format, ...); // Count a check, and print it if it failed
+int HostReport(const char *name); // Print the checks' results and get the exit status
+
+/// Every DAC write since HostReset()
+extern HOST_DAC_WRITE *hostDac;
+extern uint32_t hostDacCount;
+
+/// Timer 2 ticks since HostReset()
+extern uint64_t hostTime;
+
+/// Timer 2 ticks a second, Fosc/4 through the 1:2 post scalar.  32 MHz / 8.
+#define HOST_TIMER2_RATE 4000000UL
+/// Timer 2 ticks in a system tick
+#define HOST_SYS_TICK (HOST_TIMER2_RATE / 20)
+#if TNC_OUTPUT == TNC_OUTPUT_PWM
+/// Full scale output, the PWM duty cycle is out of 4 * (PR2 + 1)
+#define HOST_DAC_FULL (4 * (TNC_DDS_PR2 + 1))
+#else
+/// Full scale output, the top DAC level
+#define HOST_DAC_FULL 15
+#endif
+
+/// Sample rate of the WAV files
+#define HOST_WAV_RATE 48000UL
+
+/** @} */
+
+#endif  // #ifndef HOST_H
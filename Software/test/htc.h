@@ -0,0 +1,26 @@
+/*
+ * Stand-in for the XC8 device header on a host build.  The special function
+ * registers the firmware touches are plain variables, defined in host.c, so the
+ * tests can set inputs and read back what was written.
+ */
+
+#ifndef HTC_H
+#define HTC_H
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTA, PORTC, PR2, INTCON;
+extern volatile uint8_t TMR2IF, TMR2IE, GIEH;
+extern volatile uint8_t CCPR1L, CCP1CON;
+typedef struct { unsigned DC1B : 2; } CCP1CONbits_t;
+extern volatile CCP1CONbits_t CCP1CONbits;
+extern volatile uint8_t ADRESH, ADIF, ADIE, ADIP, ADCON0, ADCON1, ADCON2;
+extern volatile uint8_t T3CON, CCPR2H, CCPR2L, CCP2CON;
+typedef struct { unsigned TRISA5 : 1; } TRISAbits_t;
+extern volatile TRISAbits_t TRISAbits;
+
+#define interrupt
+#define low_priority
+#define __delay_ms(x)
+
+#endif  // #ifndef HTC_H
@@ -0,0 +1,570 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/**
+ * @defgroup modem Reference Modem
+ *
+ * What the tests hold the firmware to.  It's written from the specs, a bit at a
+ * time, and shares no code with tnc.c:  a bit by bit CRC, an AX.25 frame builder,
+ * an HDLC bit stuffer, demodulators that take the DAC log back to frames, and a
+ * Reed-Solomon decoder for the FX.25 and IL2P code blocks.  The AFSK demodulator
+ * correlates the resampled audio against both tones over a bit, the way a software
+ * TNC would, so it only sees what's really on the air.
+ *
+ * @{
+ */
+
+/// Tones from the last demodulation, 1 for a mark
+uint8_t *modemTones;
+uint32_t modemToneCount;
+
+/// Frames from the last ModemDeframe()
+MODEM_FRAME modemFrames[MODEM_MAX_FRAMES];
+uint8_t modemFrameCount;
+
+/// The audio ModemAfskTones() demodulated, and the tone it heard at each sample
+int16_t *modemAudio;
+uint8_t *modemSampleTones;
+uint32_t modemSampleCount;
+
+/**
+ * CRC-16/X.25 a bit at a time, straight from the definition:  reflected polynomial
+ * 0x8408, preset to all ones, and inverted at the end.
+ *
+ * @param data bytes to check
+ * @param length number of bytes
+ *
+ * @return the CRC, sent low byte first
+ */
+uint16_t ModemCrc(const uint8_t *data, uint16_t length) {
+    uint16_t crc;
+    uint8_t i;
+
+    crc = 0xffff;
+    while (length-- != 0) {
+        crc ^= *data++;
+        for (i = 0; i < 8; ++i)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+
+    return crc ^ 0xffff;
+}
+
+/**
+ * Add an address field:  six characters shifted left one bit, then the SSID byte.
+ */
+static uint16_t ModemAddress(uint8_t *frame, const uint8_t *call, uint8_t ssid) {
+    uint8_t i;
+
+    for (i = 0; i < 6; ++i)
+        frame[i] = call[i] << 1;
+    frame[6] = 0x60 | (ssid << 1);
+
+    return 7;
+}
+
+/**
+ * Build the frame TncPreparePacket() should send for the configured station and
+ * path:  the address fields, UI control field, no layer 3 protocol ID, the
+ * information field, and the end of message character.  No CRC.
+ *
+ * @param frame where to build it
+ * @param dest six character destination, padded with spaces
+ * @param info information field
+ * @param infoLength length of the information field
+ *
+ * @return length of the frame
+ */
+uint16_t ModemFrame(uint8_t *frame, const char *dest, const uint8_t *info, uint16_t infoLength) {
+    uint16_t length;
+
+    length = ModemAddress(frame, (const uint8_t *) dest, 0);
+    length += ModemAddress(frame + length, config.callSign, config.callSignSSID);
+    if (config.relayCallSign1[0] != 0)
+        length += ModemAddress(frame + length, config.relayCallSign1, config.relayCallSignSSID1);
+    if (config.relayCallSign2[0] != 0)
+        length += ModemAddress(frame + length, config.relayCallSign2, config.relayCallSignSSID2);
+    frame[length - 1] |= 0x01;
+
+    frame[length++] = 0x03;
+    frame[length++] = 0xf0;
+    memcpy(frame + length, info, infoLength);
+    length += infoLength;
+    frame[length++] = 0x0d;
+
+    return length;
+}
+
+/**
+ * Bit stuff a frame and its CRC, LSB first, a zero after every five ones.
+ *
+ * @param bits where to put the bits, one per byte
+ * @param frame frame without its CRC
+ * @param length length of the frame
+ *
+ * @return number of bits
+ */
+uint32_t ModemHdlcBits(uint8_t *bits, const uint8_t *frame, uint16_t length) {
+    uint8_t data[MODEM_MAX_FRAME + 2], ones, i, bit;
+    uint16_t crc, n;
+    uint32_t count;
+
+    memcpy(data, frame, length);
+    crc = ModemCrc(frame, length);
+    data[length] = crc & 0xff;
+    data[length + 1] = crc >> 8;
+
+    count = 0;
+    ones = 0;
+    for (n = 0; n < length + 2; ++n)
+        for (i = 0; i < 8; ++i) {
+            bit = (data[n] >> i) & 1;
+            bits[count++] = bit;
+            ones = (bit ? ones + 1 : 0);
+            if (ones == 5) {
+                bits[count++] = 0;
+                ones = 0;
+            }
+        }
+
+    return count;
+}
+
+/**
+ * Add a flag's bits, LSB first.
+ *
+ * @param bits where to put them
+ *
+ * @return 8
+ */
+uint32_t ModemFlag(uint8_t *bits) {
+    uint8_t i;
+
+    for (i = 0; i < 8; ++i)
+        bits[i] = (0x7e >> i) & 1;
+
+    return 8;
+}
+
+/**
+ * NRZI encode bits into tones in place:  a zero changes the tone, a one keeps it.
+ *
+ * @param bits bits to encode, one per byte
+ * @param count number of bits
+ * @param tone tone before the first bit, 1 for a mark, updated to the last
+ */
+void ModemNrzi(uint8_t *bits, uint32_t count, uint8_t *tone) {
+    uint32_t n;
+
+    for (n = 0; n < count; ++n) {
+        if (bits[n] == 0)
+            *tone ^= 1;
+        bits[n] = *tone;
+    }
+}
+
+/**
+ * Make room for the tones of a demodulation.
+ */
+static void ModemToneBuffer(uint32_t count) {
+    free(modemTones);
+    modemTones = malloc(count + 1);
+    modemToneCount = 0;
+}
+
+/**
+ * Running sums of the audio times a tone's cos and sin, so any window's
+ * correlation is the difference of two entries.
+ */
+static void ModemCorrelate(const int16_t *audio, uint32_t count, double frequency, double *cosSum, double *sinSum) {
+    uint32_t n;
+
+    cosSum[0] = 0;
+    sinSum[0] = 0;
+    for (n = 0; n < count; ++n) {
+        cosSum[n + 1] = cosSum[n] + audio[n] * cos(2 * M_PI * frequency * n / HOST_WAV_RATE);
+        sinSum[n + 1] = sinSum[n] + audio[n] * sin(2 * M_PI * frequency * n / HOST_WAV_RATE);
+    }
+}
+
+/**
+ * Demodulate the Bell 202 AFSK in the DAC log.  Each sample is called a mark or a
+ * space by correlating the bit around it against both tones, and the bit clock is
+ * pulled to every tone change and sampled half way between.
+ *
+ * @return number of tones, in modemTones
+ */
+uint32_t ModemAfskTones(void) {
+    int16_t *audio;
+    double *markCos, *markSin, *spaceCos, *spaceSin, mark, space, phase;
+    uint32_t count, window, n;
+    uint8_t tone, lastTone;
+
+    free(modemAudio);
+    free(modemSampleTones);
+    count = HostAudio(&audio);
+    modemAudio = audio;
+    modemSampleTones = calloc(count + 1, 1);
+    modemSampleCount = count;
+
+    window = HOST_WAV_RATE / 1200;
+
+    // A tone change restarts the clock, so there can be one every half bit
+    ModemToneBuffer(count / (window / 2) + 1);
+    if (count <= window)
+        return 0;
+
+    markCos = malloc((count + 1) * sizeof(double));
+    markSin = malloc((count + 1) * sizeof(double));
+    spaceCos = malloc((count + 1) * sizeof(double));
+    spaceSin = malloc((count + 1) * sizeof(double));
+    ModemCorrelate(audio, count, 1200, markCos, markSin);
+    ModemCorrelate(audio, count, 2200, spaceCos, spaceSin);
+
+    phase = 0;
+    lastTone = 2;
+    for (n = 0; n + window <= count; ++n) {
+        mark = pow(markCos[n + window] - markCos[n], 2) + pow(markSin[n + window] - markSin[n], 2);
+        space = pow(spaceCos[n + window] - spaceCos[n], 2) + pow(spaceSin[n + window] - spaceSin[n], 2);
+        tone = (mark > space);
+        modemSampleTones[n + window / 2] = tone;
+
+        if (tone != lastTone) {
+            phase = 0;
+            lastTone = tone;
+        }
+
+        phase += 1200.0 / HOST_WAV_RATE;
+        if (phase >= 0.5 && phase - 1200.0 / HOST_WAV_RATE < 0.5)
+            modemTones[modemToneCount++] = tone;
+        if (phase >= 1)
+            phase -= 1;
+    }
+
+    free(markCos);
+    free(markSin);
+    free(spaceCos);
+    free(spaceSin);
+
+    return modemToneCount;
+}
+
+/**
+ * Take the AFSK tones back out of the DAC log exactly, by replaying the 1200 baud
+ * bit clock:  each sin step adds its PR2 to the time elapsed, and once that
+ * reaches BAUD the step starts a new bit.  The clock isn't reset between packets,
+ * so the log has to hold every step since the program started.
+ *
+ * @return number of tones, in modemTones
+ */
+uint32_t ModemDacTones(void) {
+    uint32_t timeElapsed, n;
+
+    ModemToneBuffer(hostDacCount);
+
+    timeElapsed = 0;
+    for (n = 0; n < hostDacCount; ++n) {
+        if (timeElapsed >= BAUD) {
+            timeElapsed -= BAUD;
+            modemTones[modemToneCount++] = (hostDac[n].pr2 == MARK);
+        }
+        timeElapsed += hostDac[n].pr2;
+    }
+
+    return modemToneCount;
+}
+
+/**
+ * Take the G3RUH levels in the DAC log back to tones.  Each bit is two DAC writes
+ * and the second always sits at the bit's level, high for a one.  The scrambler
+ * is self synchronizing, so the tones are right from the 18th bit on.
+ *
+ * @return number of tones, in modemTones
+ */
+uint32_t ModemG3ruhTones(void) {
+    uint32_t received, n;
+    uint8_t bit;
+
+    ModemToneBuffer(hostDacCount / 2 + 1);
+
+    received = 0;
+    for (n = 1; n < hostDacCount; n += 2) {
+        bit = (2 * hostDac[n].level > HOST_DAC_FULL);
+        modemTones[modemToneCount++] = bit ^ ((received >> 11) & 1) ^ ((received >> 16) & 1);
+        received = (received << 1) | bit;
+    }
+
+    return modemToneCount;
+}
+
+/**
+ * Keep a frame that was closed by a flag, if its CRC checks out.
+ */
+static void ModemKeepFrame(const uint8_t *bits, uint32_t count) {
+    uint8_t data[MODEM_MAX_FRAME + 2];
+    uint16_t length, n;
+    uint8_t i;
+
+    if (count % 8 != 0 || count < 8 * 4 || count > 8 * (MODEM_MAX_FRAME + 2) || modemFrameCount == MODEM_MAX_FRAMES)
+        return;
+
+    length = count / 8;
+    for (n = 0; n < length; ++n) {
+        data[n] = 0;
+        for (i = 0; i < 8; ++i)
+            data[n] |= bits[n * 8 + i] << i;
+    }
+
+    length -= 2;
+    if (ModemCrc(data, length) != (data[length] | (data[length + 1] << 8)))
+        return;
+
+    memcpy(modemFrames[modemFrameCount].data, data, length);
+    modemFrames[modemFrameCount].length = length;
+    ++modemFrameCount;
+}
+
+/**
+ * Pull the frames out of an HDLC bit stream.  A zero after five ones is dropped,
+ * six ones are a flag, and seven or more abort the frame.
+ *
+ * @param stream bits, one per byte, before NRZI
+ * @param length number of bits
+ *
+ * @return number of frames with good CRCs, in modemFrames
+ */
+uint8_t ModemHdlcDeframe(const uint8_t *stream, uint32_t length) {
+    static uint8_t bits[8 * (MODEM_MAX_FRAME + 4)];
+    uint32_t count, n;
+    uint8_t ones, bit;
+
+    modemFrameCount = 0;
+    count = 0;
+    ones = 0;
+
+    for (n = 0; n < length; ++n) {
+        bit = stream[n];
+
+        if (bit) {
+            if (++ones > 6)
+                count = 0;
+            else if (ones < 6 && count < sizeof(bits))
+                bits[count++] = 1;
+            continue;
+        }
+
+        if (ones == 6) {
+            // A flag.  Its leading zero and first five ones were taken for data.
+            if (count >= 6)
+                ModemKeepFrame(bits, count - 6);
+            count = 0;
+        } else if (ones != 5 && count < sizeof(bits))
+            bits[count++] = 0;
+        ones = 0;
+    }
+
+    return modemFrameCount;
+}
+
+/**
+ * NRZI decode the tones, no change is a one, and pull out the frames between
+ * flags.
+ *
+ * @return number of frames with good CRCs, in modemFrames
+ */
+uint8_t ModemDeframe(void) {
+    uint8_t *bits;
+    uint32_t n;
+
+    if (modemToneCount < 2) {
+        modemFrameCount = 0;
+        return 0;
+    }
+
+    bits = malloc(modemToneCount);
+    for (n = 1; n < modemToneCount; ++n)
+        bits[n - 1] = (modemTones[n] == modemTones[n - 1]);
+    ModemHdlcDeframe(bits, modemToneCount - 1);
+    free(bits);
+
+    return modemFrameCount;
+}
+
+/// Powers of alpha in GF(2^8) with polynomial 0x11d, twice over so products don't wrap, and their logarithms
+static uint8_t modemExp[512], modemLog[256];
+
+/**
+ * Build the field's power and logarithm tables the first time they're needed.
+ */
+static void ModemGfInit(void) {
+    uint16_t n, value;
+
+    if (modemExp[0] != 0)
+        return;
+
+    value = 1;
+    for (n = 0; n < 512; ++n) {
+        modemExp[n] = value;
+        if (n < 255)
+            modemLog[value] = n;
+        value <<= 1;
+        if (value & 0x100)
+            value ^= 0x11d;
+    }
+}
+
+/**
+ * Multiply in GF(2^8).
+ */
+static uint8_t ModemGfMul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0)
+        return 0;
+
+    return modemExp[modemLog[a] + modemLog[b]];
+}
+
+/**
+ * Divide in GF(2^8).  b can't be 0.
+ */
+static uint8_t ModemGfDiv(uint8_t a, uint8_t b) {
+    if (a == 0)
+        return 0;
+
+    return modemExp[modemLog[a] + 255 - modemLog[b]];
+}
+
+/**
+ * Evaluate a polynomial, lowest power first.
+ */
+static uint8_t ModemPolyEval(const uint8_t *poly, uint16_t count, uint8_t x) {
+    uint8_t value;
+    uint16_t n;
+
+    value = 0;
+    for (n = count; n > 0; --n)
+        value = ModemGfMul(value, x) ^ poly[n - 1];
+
+    return value;
+}
+
+/**
+ * Correct a Reed-Solomon code block over GF(2^8) with polynomial 0x11d, the way a
+ * receiving TNC would:  syndromes, Berlekamp-Massey for the error locator, a
+ * Chien search for its roots, and Forney's formula for the error values.  The
+ * block is the codeword's highest power first, data then check bytes, so it can
+ * be shortened.
+ *
+ * @param block data and check bytes as sent, corrected in place
+ * @param length number of bytes in the block
+ * @param roots number of check bytes
+ * @param firstRoot power of alpha of the generator's first root
+ *
+ * @return number of bytes corrected, or -1 if there are too many to correct
+ */
+int ModemRsDecode(uint8_t *block, uint16_t length, uint8_t roots, uint8_t firstRoot) {
+    uint8_t syndromes[255], locator[256], previous[256], last[256], omega[255], derivative[255];
+    uint8_t x, inverse, delta, lastDelta, errors, value;
+    uint16_t n, i, shift, position, found;
+    bool_t clean;
+
+    ModemGfInit();
+
+    // The syndromes are the block at the roots of the generator, all zero if it's clean
+    clean = TRUE;
+    for (i = 0; i < roots; ++i) {
+        x = modemExp[firstRoot + i];
+        value = 0;
+        for (n = 0; n < length; ++n)
+            value = ModemGfMul(value, x) ^ block[n];
+        syndromes[i] = value;
+        if (value != 0)
+            clean = FALSE;
+    }
+    if (clean)
+        return 0;
+
+    // Berlekamp-Massey, polynomials lowest power first
+    memset(locator, 0, sizeof(locator));
+    memset(previous, 0, sizeof(previous));
+    locator[0] = 1;
+    previous[0] = 1;
+    errors = 0;
+    shift = 1;
+    lastDelta = 1;
+
+    for (n = 0; n < roots; ++n) {
+        delta = syndromes[n];
+        for (i = 1; i <= errors; ++i)
+            delta ^= ModemGfMul(locator[i], syndromes[n - i]);
+
+        if (delta == 0) {
+            ++shift;
+            continue;
+        }
+
+        memcpy(last, locator, sizeof(last));
+        value = ModemGfDiv(delta, lastDelta);
+        for (i = 0; i + shift < 256; ++i)
+            locator[i + shift] ^= ModemGfMul(value, previous[i]);
+
+        if (2 * errors <= n) {
+            errors = n + 1 - errors;
+            memcpy(previous, last, sizeof(previous));
+            lastDelta = delta;
+            shift = 1;
+        } else
+            ++shift;
+    }
+
+    if (errors > roots / 2)
+        return -1;
+
+    // omega = syndromes * locator mod x^roots, and the locator's formal derivative
+    for (i = 0; i < roots; ++i) {
+        omega[i] = 0;
+        for (n = 0; n <= i && n <= errors; ++n)
+            omega[i] ^= ModemGfMul(syndromes[i - n], locator[n]);
+    }
+    for (i = 0; i < errors; ++i)
+        derivative[i] = ((i + 1) & 1 ? locator[i + 1] : 0);
+
+    // The byte at position has locator alpha^(length - 1 - position)
+    found = 0;
+    for (position = 0; position < length; ++position) {
+        x = modemExp[(length - 1 - position) % 255];
+        inverse = ModemGfDiv(1, x);
+        if (ModemPolyEval(locator, errors + 1, inverse) != 0)
+            continue;
+
+        // Forney, with x^(1 - firstRoot) for generators that don't start at alpha^1
+        value = ModemGfDiv(ModemPolyEval(omega, roots, inverse), ModemPolyEval(derivative, errors, inverse));
+        for (i = firstRoot; i < 1; ++i)
+            value = ModemGfMul(value, x);
+        for (i = 1; i < firstRoot; ++i)
+            value = ModemGfDiv(value, x);
+        block[position] ^= value;
+        ++found;
+    }
+
+    if (found != errors)
+        return -1;
+
+    return found;
+}
+
+/**
+ * Demodulate the AFSK in the DAC log and pull out its frames.
+ *
+ * @return number of frames with good CRCs, in modemFrames
+ */
+uint8_t ModemAfskDecode(void) {
+    ModemAfskTones();
+    return ModemDeframe();
+}
+
+/** @} */
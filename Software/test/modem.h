@@ -0,0 +1,79 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     modem.h                                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+
+
+#ifndef MODEM_H
+#define MODEM_H
+
+#include "main.h"
+
+/**
+ * @defgroup modem Reference Modem
+ *
+ * @{
+ */
+
+/// Largest frame the decoders keep, without its CRC
+#define MODEM_MAX_FRAME 512
+/// Most frames the decoders keep from one transmission
+#define MODEM_MAX_FRAMES 16
+
+/// A frame that came through the decoder with a good CRC
+typedef struct {
+    uint8_t data[MODEM_MAX_FRAME];
+    uint16_t length;
+} MODEM_FRAME;
+
+uint16_t ModemCrc(const uint8_t *data, uint16_t length); // Bit at a time CRC-16/X.25
+uint16_t ModemFrame(uint8_t *frame, const char *dest, const uint8_t *info, uint16_t length); // Build the frame the TNC should send
+uint32_t ModemHdlcBits(uint8_t *bits, const uint8_t *frame, uint16_t length); // Bit stuff a frame and its CRC
+uint32_t ModemFlag(uint8_t *bits); // Add a flag's bits
+void ModemNrzi(uint8_t *bits, uint32_t count, uint8_t *tone); // NRZI encode bits into tones
+uint32_t ModemDacTones(void); // Take the tones back out of the DAC log with the modulator's timing
+uint32_t ModemAfskTones(void); // Demodulate the DAC log's AFSK, a tone per bit
+uint32_t ModemG3ruhTones(void); // Descramble the DAC log's G3RUH levels, a tone per bit
+uint8_t ModemHdlcDeframe(const uint8_t *bits, uint32_t length); // Find the frames in an HDLC bit stream
+uint8_t ModemDeframe(void); // Find the HDLC frames in the tones
+int ModemRsDecode(uint8_t *block, uint16_t length, uint8_t roots, uint8_t firstRoot); // Correct a Reed-Solomon code block
+uint8_t ModemAfskDecode(void); // Demodulate and deframe the DAC log's AFSK
+
+/// Tones from the last demodulation, 1 for a mark
+extern uint8_t *modemTones;
+extern uint32_t modemToneCount;
+
+/// The audio ModemAfskTones() demodulated, and the tone it heard at each sample
+extern int16_t *modemAudio;
+extern uint8_t *modemSampleTones;
+extern uint32_t modemSampleCount;
+
+/// Frames from the last ModemDeframe()
+extern MODEM_FRAME modemFrames[MODEM_MAX_FRAMES];
+extern uint8_t modemFrameCount;
+
+/** @} */
+
+#endif  // #ifndef MODEM_H
@@ -0,0 +1,374 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "gps.h"
+#include "fifo.h"
+#include "ff.h"
+#include "nmea.h"
+
+/**
+ * @defgroup nmea Reference NMEA Parser
+ *
+ * What the GPS tests hold gps.c to.  The reference keeps the parser gps.c started
+ * out with:  each sentence is stored whole, and GetField() counts commas from the
+ * start for every field it's asked for.  Its numbers can be converted the way that
+ * parser did, with atof() and round(), or exactly in decimal, so the fixed point
+ * results can be told apart from the float library's rounding.
+ *
+ * The file system and the serial debug output gps.c uses are stubbed out here, and
+ * what they were given is kept for the tests to look at.
+ *
+ * @{
+ */
+
+/// Longest field the reference copies, like MAXFIELD in the original
+#define NMEA_MAX_FIELD 25
+
+/// The log file gps.c writes the raw characters to, and what it wrote
+FIL logFile;
+uint8_t *nmeaLog;
+uint32_t nmeaLogLength;
+static uint32_t nmeaLogSize;
+
+/// Lines of serial debug output
+uint32_t nmeaPrints;
+
+/// State of NmeaRandom()
+static uint32_t nmeaSeed = 1;
+
+/**
+ * Keep what gps.c logs.
+ */
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+    if (nmeaLogLength + btw > nmeaLogSize) {
+        nmeaLogSize = (nmeaLogLength + btw) * 2;
+        nmeaLog = realloc(nmeaLog, nmeaLogSize);
+    }
+    memcpy(nmeaLog + nmeaLogLength, buff, btw);
+    nmeaLogLength += btw;
+
+    *bw = btw;
+    return FR_OK;
+}
+
+/**
+ * Count gps.c's serial debug output instead of printing it.  The test build points
+ * printf() here.
+ */
+int NmeaPrintf(const char *format, ...) {
+    ++nmeaPrints;
+    return 0;
+}
+
+/**
+ * Repeatable pseudo random numbers, so the tests build the same sentences every time.
+ *
+ * @return 31 random bits
+ */
+uint32_t NmeaRandom(void) {
+    nmeaSeed = nmeaSeed * 1103515245 + 12345;
+    return (nmeaSeed >> 1) & 0x7fffffff;
+}
+
+/**
+ * Wrap a sentence body in its $, checksum, and CR LF.
+ *
+ * @param sentence filled with the sentence, up to NMEA_MAX_SENTENCE
+ * @param body everything between the $ and the *
+ *
+ * @return length of the sentence
+ */
+uint16_t NmeaSentence(char *sentence, const char *body) {
+    uint8_t checksum;
+    const char *c;
+
+    checksum = 0;
+    for (c = body; *c != 0; ++c)
+        checksum ^= *c;
+
+    return snprintf(sentence, NMEA_MAX_SENTENCE, "$%s*%02X\r\n", body, checksum);
+}
+
+/**
+ * Pass characters to the parser through the serial FIFO, the way the UART
+ * interrupt would, calling GpsUpdate() after each chunk until it's all read.
+ *
+ * @param text characters from the GPS
+ * @param length number of characters
+ * @param chunk characters written between calls, less than the FIFO holds
+ */
+void NmeaFeed(const char *text, uint32_t length, uint16_t chunk) {
+    uint32_t i;
+
+    while (length != 0) {
+        for (i = 0; i < chunk && i < length; ++i)
+            FifoWrite(text[i]);
+        text += i;
+        length -= i;
+
+        while (FifoHasData())
+            GpsUpdate();
+    }
+}
+
+/**
+ * Get a field of a sentence, counting commas from the start, as the original did.
+ *
+ * @param data the sentence after the command and its comma, without the checksum
+ * @param field filled with the field, cropped to NMEA_MAX_FIELD - 1 characters
+ * @param number which field, from 0
+ *
+ * @return false if the field is empty or missing
+ */
+static bool_t NmeaGetField(const char *data, char *field, uint8_t number) {
+    uint8_t length;
+
+    for (; number != 0 && *data != 0; ++data)
+        if (*data == ',')
+            --number;
+
+    if (number != 0 || *data == ',' || *data == 0) {
+        field[0] = 0;
+        return FALSE;
+    }
+
+    for (length = 0; *data != ',' && *data != 0 && length < NMEA_MAX_FIELD - 1; ++data)
+        field[length++] = *data;
+    field[length] = 0;
+
+    return TRUE;
+}
+
+/**
+ * Convert decimal text to an integer in units of 10^-decimals, rounded half away
+ * from zero.  Digits stop at the first character that isn't one.
+ *
+ * @return the value, or 0 if there are no digits
+ */
+static int64_t NmeaDecimal(const char *text, uint8_t decimals, NMEA_CONVERSION conversion) {
+    int64_t value, scale;
+    uint8_t places;
+    bool_t negative, point;
+
+    if (conversion == NMEA_FLOAT)
+        return (int64_t) round(atof(text) * pow(10, decimals));
+
+    negative = (*text == '-');
+    if (negative)
+        ++text;
+
+    value = 0;
+    places = 0;
+    point = FALSE;
+    for (; *text != 0; ++text) {
+        if (*text == '.' && !point)
+            point = TRUE;
+        else if (*text >= '0' && *text <= '9' && places < 15) {
+            value = value * 10 + (*text - '0');
+            if (point)
+                ++places;
+        } else if (*text < '0' || *text > '9')
+            break;
+    }
+
+    // Scale to the decimals wanted, and round off the rest
+    for (; places < decimals; ++places)
+        value *= 10;
+    for (scale = 1; places > decimals; --places)
+        scale *= 10;
+    value = (value * 2 + scale) / (scale * 2);
+
+    return negative ? -value : value;
+}
+
+/**
+ * Convert a DDMM.mmmm or DDDMM.mmmm field to degrees * 10^7.
+ */
+static int32_t NmeaPosition(char *field, uint8_t degrees, NMEA_CONVERSION conversion) {
+    int64_t minutes, scale;
+    int32_t whole;
+    uint8_t places;
+    const char *c;
+
+    if (conversion == NMEA_FLOAT) {
+        whole = (int32_t) round(10000000 * atof(field + degrees) / 60.0);
+        field[degrees] = 0;
+        return whole + (int32_t) (10000000 * atol(field));
+    }
+
+    // Minutes with every decimal place, then to degrees * 10^7 in one rounding
+    for (places = 0, c = strchr(field + degrees, '.'); c != NULL && c[1] >= '0' && c[1] <= '9' && places < 10; ++c)
+        ++places;
+    for (scale = 1; places != 0; --places)
+        scale *= 10;
+    minutes = NmeaDecimal(field + degrees, (uint8_t) log10((double) scale), NMEA_EXACT);
+
+    field[degrees] = 0;
+    return atol(field) * 10000000 + (int32_t) ((minutes * 10000000 * 2 + 60 * scale) / (60 * scale * 2));
+}
+
+/**
+ * The degrees, minutes, and hundredths of minutes of a position field, for Mic-E.
+ * A field that doesn't start with all of the degrees and minutes gets none.
+ */
+static void NmeaDigits(const char *field, char *digits, uint8_t degrees) {
+    uint8_t i;
+
+    for (i = 0; i < degrees + 2; ++i)
+        if (field[i] < '0' || field[i] > '9') {
+            digits[0] = 0;
+            return;
+        }
+
+    memcpy(digits, field, degrees + 2);
+    field += degrees + 2;
+    if (*field == '.')
+        ++field;
+    for (i = 0; i < 2; ++i)
+        digits[degrees + 2 + i] = (*field >= '0' && *field <= '9' ? *field++ : '0');
+}
+
+/**
+ * Decode a GGA sentence's fields, as the original ProcessGPGGA() did.
+ */
+static void NmeaRefGga(GPSData *data, const char *body, NMEA_CONVERSION conversion) {
+    char field[NMEA_MAX_FIELD];
+
+    if (NmeaGetField(body, field, 6))
+        data->trackedSats = (uint16_t) NmeaDecimal(field, 0, NMEA_EXACT);
+    if (NmeaGetField(body, field, 7))
+        data->dop = (uint16_t) NmeaDecimal(field, 1, conversion);
+    if (NmeaGetField(body, field, 8))
+        data->altitude = (int32_t) NmeaDecimal(field, 2, conversion);
+}
+
+/**
+ * Decode an RMC sentence's fields, as the original ProcessGPRMC() did.
+ */
+static void NmeaRefRmc(GPSData *data, const char *body, NMEA_CONVERSION conversion) {
+    char field[NMEA_MAX_FIELD];
+
+    if (NmeaGetField(body, field, 0)) {
+        data->hours = (field[0] - '0') * 10 + (field[1] - '0');
+        data->minutes = (field[2] - '0') * 10 + (field[3] - '0');
+        data->seconds = (field[4] - '0') * 10 + (field[5] - '0');
+    }
+
+    if (NmeaGetField(body, field, 1)) {
+        if (field[0] == 'A')
+            data->fixType = (data->altitude > 0 ? Fix3D : Fix2D);
+        else
+            data->fixType = NoFix;
+    }
+
+    if (NmeaGetField(body, field, 2)) {
+        NmeaDigits(field, data->latitudeDigits, 2);
+        data->latitude = NmeaPosition(field, 2, conversion);
+    }
+    if (NmeaGetField(body, field, 3) && field[0] == 'S')
+        data->latitude = -data->latitude;
+
+    if (NmeaGetField(body, field, 4)) {
+        NmeaDigits(field, data->longitudeDigits, 3);
+        data->longitude = NmeaPosition(field, 3, conversion);
+    }
+    if (NmeaGetField(body, field, 5) && field[0] == 'W')
+        data->longitude = -data->longitude;
+
+    data->speed = (NmeaGetField(body, field, 6) ? (uint16_t) NmeaDecimal(field, 1, conversion) : 0);
+    data->heading = (NmeaGetField(body, field, 7) ? (uint16_t) NmeaDecimal(field, 2, conversion) : 0);
+
+    if (NmeaGetField(body, field, 8)) {
+        data->day = (field[0] - '0') * 10 + (field[1] - '0');
+        data->month = (field[2] - '0') * 10 + (field[3] - '0');
+        data->year = 2000 + (field[4] - '0') * 10 + (field[5] - '0');
+    }
+}
+
+/**
+ * Decode a whole sentence with the reference parser.  The checksum has to be right
+ * if there is one, and only the GGA and RMC sentences the original knew are decoded, from
+ * any talker.
+ *
+ * @param data updated from the sentence
+ * @param sentence from the $ on, with or without the CR LF
+ * @param conversion how the numbers are converted
+ *
+ * @return true if it was a GGA, the one that marks the data ready
+ */
+bool_t NmeaRefDecode(GPSData *data, const char *sentence, NMEA_CONVERSION conversion) {
+    char body[NMEA_MAX_SENTENCE];
+    const char *star;
+    uint8_t checksum;
+    unsigned received;
+    size_t length;
+
+    // A sentence without a checksum ends at the CR
+    star = sentence + strcspn(sentence, "*\r");
+    if (sentence[0] != '$' || *star == 0)
+        return FALSE;
+
+    length = star - sentence - 1;
+    if (length < 6 || length >= sizeof(body))
+        return FALSE;
+    memcpy(body, sentence + 1, length);
+    body[length] = 0;
+
+    for (checksum = 0; length != 0; --length)
+        checksum ^= body[length - 1];
+    if (*star == '*' && (sscanf(star + 1, "%2X", &received) != 1 || checksum != received))
+        return FALSE;
+    if (body[5] != ',')
+        return FALSE;
+
+    if (strncmp(body + 2, "GGA", 3) == 0) {
+        NmeaRefGga(data, body + 6, conversion);
+        return TRUE;
+    }
+    if (strncmp(body + 2, "RMC", 3) == 0)
+        NmeaRefRmc(data, body + 6, conversion);
+
+    return FALSE;
+}
+
+/**
+ * Compare the fields the parsers fill in.  The position digits only count when
+ * there are some.
+ *
+ * @return name of the first field that differs, or NULL if none do
+ */
+const char *NmeaDifference(const GPSData *data, const GPSData *ref) {
+    if (data->hours != ref->hours || data->minutes != ref->minutes || data->seconds != ref->seconds)
+        return "time";
+    if (data->day != ref->day || data->month != ref->month || data->year != ref->year)
+        return "date";
+    if (data->latitude != ref->latitude)
+        return "latitude";
+    if (data->longitude != ref->longitude)
+        return "longitude";
+    if ((data->latitudeDigits[0] != 0) != (ref->latitudeDigits[0] != 0) ||
+            (ref->latitudeDigits[0] != 0 && memcmp(data->latitudeDigits, ref->latitudeDigits, 6) != 0))
+        return "latitude digits";
+    if ((data->longitudeDigits[0] != 0) != (ref->longitudeDigits[0] != 0) ||
+            (ref->longitudeDigits[0] != 0 && memcmp(data->longitudeDigits, ref->longitudeDigits, 7) != 0))
+        return "longitude digits";
+    if (data->altitude != ref->altitude)
+        return "altitude";
+    if (data->speed != ref->speed)
+        return "speed";
+    if (data->heading != ref->heading)
+        return "course";
+    if (data->dop != ref->dop)
+        return "HDOP";
+    if (data->trackedSats != ref->trackedSats)
+        return "satellites";
+    if (data->fixType != ref->fixType)
+        return "fix type";
+
+    return NULL;
+}
+
+/** @} */
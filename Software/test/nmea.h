@@ -0,0 +1,64 @@
+/***************************************************************************
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the Free Software            *
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA    *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ *               (c) Copyright, 2014 AD7ZJ                                 *
+ *                                                                         *
+ ***************************************************************************
+ *                                                                         *
+ * Filename:     nmea.h                                                    *
+ *                                                                         *
+ ***************************************************************************/
+
+
+#ifndef NMEA_H
+#define NMEA_H
+
+#include "main.h"
+#include "gps.h"
+
+/**
+ * @defgroup nmea Reference NMEA Parser
+ *
+ * @{
+ */
+
+/// Longest sentence the helpers build, with its $, checksum, and CR LF
+#define NMEA_MAX_SENTENCE 256
+
+/// How the reference turns decimal text into the GPSData units
+typedef enum {
+    /// atof() and round(), the way gps.c first did it
+    NMEA_FLOAT,
+    /// Exact decimal arithmetic, rounded half away from zero
+    NMEA_EXACT
+} NMEA_CONVERSION;
+
+uint16_t NmeaSentence(char *sentence, const char *body); // Wrap a body in $, its checksum, and CR LF
+void NmeaFeed(const char *text, uint32_t length, uint16_t chunk); // Pass characters to GpsUpdate() through the serial FIFO
+bool_t NmeaRefDecode(GPSData *data, const char *sentence, NMEA_CONVERSION conversion); // Decode a sentence with the reference parser
+const char *NmeaDifference(const GPSData *data, const GPSData *ref); // Name the first field two decodes differ in
+uint32_t NmeaRandom(void); // Repeatable pseudo random numbers for building sentences
+
+/// Everything gps.c wrote to the log file, and its serial debug output
+extern uint8_t *nmeaLog;
+extern uint32_t nmeaLogLength;
+extern uint32_t nmeaPrints;
+
+/** @} */
+
+#endif  // #ifndef NMEA_H
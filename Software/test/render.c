@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+
+/**
+ * @defgroup render Modem Renderer
+ *
+ * Sends packets through the real modulator on the host and saves the audio as a
+ * WAV file, so it can be checked with a software TNC or an audio editor instead
+ * of a radio and a scope.
+ *
+ *     render [-9] [-f ax25|fx25|il2p] out.wav [info ...]
+ *
+ * Each info argument is queued as a packet from the default call sign, and they
+ * all go out in one transmission.  -9 sends G3RUH 9600 baud instead of 1200 baud
+ * AFSK.
+ *
+ * @{
+ */
+
+/**
+ * Print how to run us.
+ */
+static void Usage(void) {
+    fprintf(stderr, "usage: render [-9] [-f ax25|fx25|il2p] out.wav [info ...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *wav;
+    int arg;
+
+    HostReset();
+    TncConfigDefault();
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (strcmp(argv[arg], "-9") == 0)
+            config.modulation = TNC_G3RUH_9600;
+        else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+            ++arg;
+            if (strcmp(argv[arg], "ax25") == 0)
+                config.framing = TNC_FRAMING_AX25;
+            else if (strcmp(argv[arg], "fx25") == 0)
+                config.framing = TNC_FRAMING_FX25;
+            else if (strcmp(argv[arg], "il2p") == 0)
+                config.framing = TNC_FRAMING_IL2P;
+            else
+                Usage();
+        } else
+            Usage();
+    }
+
+    if (arg == argc)
+        Usage();
+    wav = argv[arg++];
+
+    if (arg == argc)
+        TncPreparePacket((uint8_t *) ">PICAprs host render", config.destCallSign);
+
+    for (; arg < argc; ++arg)
+        if (!TncPreparePacket((uint8_t *) argv[arg], config.destCallSign)) {
+            fprintf(stderr, "Packet doesn't fit in the queue: %s\n", argv[arg]);
+            return 1;
+        }
+
+    HostRadioSend();
+
+    if (!HostWriteWav(wav)) {
+        perror(wav);
+        return 1;
+    }
+
+    printf("%u DAC writes, %.3f seconds\n", hostDacCount,
+            (double) (hostDac[hostDacCount - 1].time - hostDac[0].time) / HOST_TIMER2_RATE);
+    return 0;
+}
+
+/** @} */
@@ -0,0 +1,193 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "gps.h"
+#include "beacon.h"
+#include "host.h"
+
+/*
+ * Smart beaconing, over synthetic tracks with a fix a second.  The intervals
+ * stopped, cruising, and flat out have to come out as configured, turns have
+ * to peg a beacon only past their angle and hold off, and a beacon that
+ * couldn't be queued has to be tried again on the next fix.  Then a balloon
+ * flight with wind shear and swinging headings is run against a floating
+ * point reference, decision for decision.
+ */
+
+/// Ticks between fixes
+#define FIX_TICKS BEACON_TICK_RATE
+
+/**
+ * Follow a steady track, sending whenever a beacon is due, and return the gap
+ * between the 2nd and 3rd beacons.
+ *
+ * @return seconds between beacons, or 0 if there weren't enough in an hour
+ */
+static uint32_t Interval(uint16_t speed, uint16_t heading) {
+    GPSData gps;
+    uint32_t tick, sent[3];
+    uint8_t n;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.speed = speed;
+    gps.heading = heading;
+    BeaconReset();
+
+    n = 0;
+    for (tick = 1000; tick < 1000 + 3600 * FIX_TICKS && n < 3; tick += FIX_TICKS)
+        if (BeaconIsDue(&gps, tick)) {
+            BeaconSent(&gps, tick);
+            sent[n++] = tick;
+        }
+
+    return (n == 3 ? (sent[2] - sent[1]) / FIX_TICKS : 0);
+}
+
+/**
+ * Go straight long enough that the rate isn't due for a while, then turn, and
+ * see whether the turn sends a beacon.
+ *
+ * @param speed knots * 10
+ * @param turn degrees * 100, + for right
+ * @param after seconds after the last beacon the turn happens
+ *
+ * @return true if the fix after the turn was due
+ */
+static bool_t Turn(uint16_t speed, uint16_t heading, int16_t turn, uint16_t after) {
+    GPSData gps;
+    uint32_t tick;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.speed = speed;
+    gps.heading = heading;
+    BeaconReset();
+
+    tick = 5000;
+    BeaconIsDue(&gps, tick);
+    BeaconSent(&gps, tick);
+
+    gps.heading = (uint16_t) ((heading + turn + 36000) % 36000);
+    return BeaconIsDue(&gps, tick + (uint32_t) after * FIX_TICKS);
+}
+
+/**
+ * The reference:  interval by division and the turn threshold in degrees.
+ */
+static bool_t RefIsDue(double speed, double heading, double elapsed, double lastHeading, bool_t first) {
+    double rate, turn, knots;
+
+    if (first)
+        return TRUE;
+    if (speed <= beaconConfig.lowSpeed / 10.0)
+        return elapsed >= beaconConfig.slowRate - 1e-9;
+
+    knots = fmin(speed, beaconConfig.highSpeed / 10.0);
+    rate = beaconConfig.fastRate * (beaconConfig.highSpeed / 10.0) / knots;
+    if (elapsed >= rate - 1e-9)
+        return TRUE;
+
+    turn = fabs(heading - lastHeading);
+    if (turn > 180)
+        turn = 360 - turn;
+    return elapsed >= beaconConfig.turnTime && turn > beaconConfig.turnAngle + beaconConfig.turnSlope / speed + 1e-9;
+}
+
+int main(void) {
+    GPSData gps;
+    uint32_t tick, seconds, lastSent, sent, agreed, fixes;
+    uint16_t speed, lastHeading;
+    bool_t due, ok;
+    double altitude, wind;
+
+    BeaconConfigDefault();
+    memset(&gps, 0, sizeof(gps));
+
+    // The first fix is due, and asking again doesn't use it up
+    tick = 100;
+    HostCheck(BeaconIsDue(&gps, tick), "first fix isn't due");
+    HostCheck(BeaconIsDue(&gps, tick + FIX_TICKS), "first fix isn't due when asked again");
+
+    // A beacon that couldn't be queued is tried on every fix until one is
+    BeaconSent(&gps, tick);
+    for (seconds = 1; seconds < beaconConfig.slowRate && !BeaconIsDue(&gps, tick + seconds * FIX_TICKS); ++seconds)
+        ;
+    HostCheck(seconds == beaconConfig.slowRate, "stopped beacon due after %lu s", (unsigned long) seconds);
+    HostCheck(BeaconIsDue(&gps, tick + (seconds + 1) * FIX_TICKS) && BeaconIsDue(&gps, tick + (seconds + 5) * FIX_TICKS),
+            "unsent beacon isn't due on the next fixes");
+    BeaconSent(&gps, tick + (seconds + 5) * FIX_TICKS);
+    HostCheck(!BeaconIsDue(&gps, tick + (seconds + 6) * FIX_TICKS), "still due after it was sent");
+
+    // BeaconReset sends on the next fix
+    BeaconReset();
+    HostCheck(BeaconIsDue(&gps, tick + (seconds + 6) * FIX_TICKS), "not due after a reset");
+
+    // The tick wrapping doesn't matter
+    BeaconSent(&gps, 0xffffffff - 10 * FIX_TICKS);
+    HostCheck(!BeaconIsDue(&gps, 100 * FIX_TICKS), "due early across the tick wrapping");
+    HostCheck(BeaconIsDue(&gps, (beaconConfig.slowRate - 10) * FIX_TICKS), "not due across the tick wrapping");
+
+    // Intervals, stopped, in between, and flat out
+    ok = TRUE;
+    for (speed = 0; speed <= 1000; speed += 5) {
+        if (speed <= beaconConfig.lowSpeed)
+            seconds = beaconConfig.slowRate;
+        else
+            seconds = (uint32_t) ceil((double) beaconConfig.fastRate * beaconConfig.highSpeed /
+                    (speed < beaconConfig.highSpeed ? speed : beaconConfig.highSpeed) - 1e-9);
+        if (Interval(speed, 9000) != seconds)
+            ok = HostCheck(FALSE, "%u knots * 10 beacons every %lu s, not %lu", speed, (unsigned long) Interval(speed, 9000),
+                    (unsigned long) seconds);
+    }
+    HostCheck(ok, "intervals");
+    HostCheck(Interval(0, 0) == 180 && Interval(300, 0) == 60 && Interval(600, 0) == 30 && Interval(2000, 0) == 30,
+            "default intervals aren't 180, 60 and 30 s");
+
+    // Turns:  at 20 knots the angle is 28 + 255 / 20 = 40.75 degrees
+    HostCheck(Turn(200, 9000, 4100, 16), "41 degree right turn at 20 knots didn't send");
+    HostCheck(Turn(200, 9000, -4100, 16), "41 degree left turn at 20 knots didn't send");
+    HostCheck(!Turn(200, 9000, 4000, 16), "40 degree turn at 20 knots sent");
+    HostCheck(Turn(200, 35000, 4100, 16), "turn through north didn't send");
+    HostCheck(!Turn(200, 35000, 2000, 16), "20 degree turn through north sent");
+    HostCheck(!Turn(200, 9000, 9000, beaconConfig.turnTime - 1), "turn sent before the turn time");
+    HostCheck(Turn(200, 9000, 9000, beaconConfig.turnTime), "turn didn't send at the turn time");
+    HostCheck(!Turn(beaconConfig.lowSpeed, 9000, 18000, 60), "turn sent while stopped");
+    HostCheck(Turn(1000, 9000, 3100, 16) && !Turn(1000, 9000, 3000, 16), "turn at 100 knots isn't past 30.55 degrees");
+
+    // A balloon flight:  up through wind shear to 30 km, and a fast descent, with
+    // the heading swinging back and forth
+    BeaconReset();
+    memset(&gps, 0, sizeof(gps));
+    lastSent = 0;
+    lastHeading = 0;
+    sent = agreed = fixes = 0;
+    tick = 12345;
+    for (seconds = 0; seconds < 3 * 3600; ++seconds, tick += FIX_TICKS) {
+        altitude = (seconds < 7200 ? seconds * 4.2 : 30240 - (seconds - 7200) * 10.0);
+        if (altitude < 0)
+            altitude = 0;
+        wind = (altitude < 12000 ? altitude / 12000 * 90 : 90 - (altitude - 12000) / 18000 * 75);
+        if (altitude <= 0)
+            wind = 0;
+        gps.speed = (uint16_t) (wind * 10 * (1 + 0.2 * sin(seconds / 37.0)));
+        gps.heading = (uint16_t) fmod(27000 + 6000 * sin(seconds / 150.0) + 2500 * sin(seconds / 11.0) + 36000, 36000);
+
+        due = BeaconIsDue(&gps, tick);
+        agreed += (due == RefIsDue(gps.speed / 10.0, gps.heading / 100.0, (tick - lastSent) / (double) FIX_TICKS,
+                lastHeading / 100.0, sent == 0));
+        ++fixes;
+
+        // Every 10th beacon can't be queued and waits for the next fix
+        if (due && (sent % 10 != 9 || seconds % 2 == 0)) {
+            BeaconSent(&gps, tick);
+            lastSent = tick;
+            lastHeading = gps.heading;
+            ++sent;
+        }
+    }
+    HostCheck(agreed == fixes, "flight: %lu of %lu fixes agree with the reference", (unsigned long) agreed, (unsigned long) fixes);
+    HostCheck(sent > 3 * 3600 / 180 && sent < 3 * 3600 / 10, "flight sent %lu beacons", (unsigned long) sent);
+    printf("beacon: %lu beacons in a 3 hour flight\n", (unsigned long) sent);
+
+    return HostReport("beacon");
+}
@@ -0,0 +1,142 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "gps.h"
+#include "compress.h"
+#include "host.h"
+
+/*
+ * Compressed position reports, against the examples in the APRS spec and a
+ * reference decoder written from it in floating point.  Latitude and longitude
+ * have to come back within the base-91 unit they were rounded down into, the
+ * course within its 4 degree step, the speed on the largest step that doesn't go
+ * over, and the altitude on the 1.002 step nearest the whole feet, give or take
+ * the resolution of the log, over a grid of fixes out to the poles and the date
+ * line.
+ */
+
+/// A fix decoded from a report
+typedef struct {
+    double latitude, longitude, course, speed, feet;
+    bool_t altitude;
+} DECODED;
+
+/**
+ * Decode 4 base-91 digits.
+ */
+static double Base91(const char *digits) {
+    return (((double) (digits[0] - 33) * 91 + (digits[1] - 33)) * 91 + (digits[2] - 33)) * 91 + (digits[3] - 33);
+}
+
+/**
+ * Decode a report the way the spec describes, checking every character is base-91.
+ *
+ * @return false if it's malformed
+ */
+static bool_t Decode(const char *info, DECODED *fix) {
+    uint8_t i;
+
+    if (strlen(info) != 14 || info[0] != '!' || info[1] != '/' || info[10] != 'O')
+        return FALSE;
+    for (i = 2; i < 14; ++i)
+        if (i != 10 && (info[i] < 33 || info[i] > 33 + 90))
+            return FALSE;
+
+    fix->latitude = 90 - Base91(info + 2) / 380926;
+    fix->longitude = -180 + Base91(info + 6) / 190463;
+
+    // The type byte's NMEA source bits say whether it's altitude, from a GGA sentence
+    fix->altitude = (((info[13] - 33) >> 3) & 0x03) == 0x02;
+    if (fix->altitude)
+        fix->feet = pow(1.002, (info[11] - 33) * 91 + (info[12] - 33));
+    else {
+        fix->course = (info[11] - 33) * 4;
+        fix->speed = pow(1.08, info[12] - 33) - 1;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Encode a fix and check what comes back.
+ */
+static void Check(int32_t latitude, int32_t longitude, int32_t altitude, uint16_t heading, uint16_t speed, FixType fixType) {
+    GPSData gps;
+    DECODED fix;
+    double error, feet;
+
+    memset(&gps, 0, sizeof(gps));
+    memset(&fix, 0, sizeof(fix));
+    gps.latitude = latitude;
+    gps.longitude = longitude;
+    gps.altitude = altitude;
+    gps.heading = heading;
+    gps.speed = speed;
+    gps.fixType = fixType;
+    CompressEncode(&gps);
+
+    if (!HostCheck(Decode(CompressGetInfoField(), &fix), "%ld %ld: malformed report \"%s\"", (long) latitude, (long) longitude,
+            CompressGetInfoField()))
+        return;
+
+    // Rounded down in base-91 units, which are south from 90 N and east from 180 W
+    error = (latitude / 1e7 - fix.latitude) * 380926;
+    HostCheck(error > -1 - 1e-6 && error < 1e-6, "latitude %ld is %.3f units off", (long) latitude, error);
+    error = (fix.longitude - longitude / 1e7) * 190463;
+    HostCheck(error > -1 - 1e-6 && error < 1e-6, "longitude %ld is %.3f units off", (long) longitude, error);
+
+    HostCheck(fix.altitude == (fixType == Fix3D), "%s for a %s fix", fix.altitude ? "altitude" : "course and speed",
+            fixType == Fix3D ? "3D" : "2D");
+    if (fix.altitude) {
+        feet = floor((altitude > 0 ? altitude : 0) / 30.48 + 0.5);
+        if (feet >= 1.5 && feet < pow(1.002, 8280))
+            HostCheck(fabs(log(fix.feet / feet) / log(1.002)) < 0.6, "%ld cm decodes as %.0f ft", (long) altitude, fix.feet);
+    } else {
+        HostCheck(fix.course <= heading / 100.0 && fix.course > heading / 100.0 - 4, "course %u decodes as %.0f", heading, fix.course);
+        if (speed / 10.0 < pow(1.08, 89) - 1)
+            HostCheck(fix.speed <= speed / 10.0 * 1.001 + 1e-9 && (fix.speed + 1) * 1.08 - 1 > speed / 10.0 - 1e-9,
+                    "speed %u decodes as %.2f knots", speed, fix.speed);
+    }
+}
+
+int main(void) {
+    GPSData gps;
+    int32_t latitude, longitude;
+    uint32_t feet;
+
+    memset(&gps, 0, sizeof(gps));
+
+    // The spec's examples:  49 30.00 N, 72 45.00 W, course 88, 36.2 knots, and 10004 ft
+    gps.latitude = 495000000;
+    gps.longitude = -727500000;
+    gps.heading = 8800;
+    gps.speed = 363;
+    gps.fixType = Fix2D;
+    CompressEncode(&gps);
+    HostCheck(strncmp(CompressGetInfoField(), "!/5L!!<*e7O7P", 13) == 0, "spec course and speed example is \"%s\"", CompressGetInfoField());
+
+    gps.altitude = 304922;
+    gps.fixType = Fix3D;
+    CompressEncode(&gps);
+    HostCheck(strncmp(CompressGetInfoField(), "!/5L!!<*e7OS]", 13) == 0, "spec altitude example is \"%s\"", CompressGetInfoField());
+
+    // The grid, both fix types, and the edges of the map
+    for (latitude = -900000000; latitude <= 900000000; latitude += 12345677)
+        for (longitude = -1800000000; longitude < 1800000000; longitude += 23456789) {
+            Check(latitude, longitude, (latitude / 10000 + 90000) * 2, (uint16_t) (longitude / 50000 + 36000) % 36000,
+                    (uint16_t) (latitude / 1000000 + 90) * 7, Fix2D);
+            Check(latitude, longitude, (longitude / 1000 + 1800000) * 5, 0, 0, Fix3D);
+        }
+    Check(900000000, -1800000000, 0, 0, 0, Fix3D);
+    Check(-900000000, 1799999999, -5000, 35999, 0, Fix2D);
+    Check(0, 0, 0, 0, 10000, Fix2D);
+
+    // Every altitude a balloon could reach, and courses and speeds all the way around
+    for (feet = 0; feet < 200000; feet += feet / 50 + 1)
+        Check(333333333, -1111111111, (int32_t) (feet * 3048 / 100), 0, 0, Fix3D);
+    for (gps.heading = 0; gps.heading < 36000; gps.heading += 37)
+        Check(333333333, -1111111111, 0, gps.heading, gps.heading / 10, Fix2D);
+
+    return HostReport("compress");
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * The table driven CRC-16/X.25.  The catalog check value, the bit at a time
+ * reference over random data of every length a frame can have, a running CRC a
+ * byte at a time, and the residue a receiver sees over a frame and its CRC.
+ * Then both CRCs are timed against the bit at a time CRC16() it replaced.
+ */
+
+/// Where the timed CRCs go, so the compiler can't leave them out
+static volatile uint16_t sink;
+
+/**
+ * CRC16() the way it was before the table, a bit at a time.
+ */
+static uint16_t BitCrc16(uint8_t *buffer, uint16_t length) {
+    uint16_t i, dbit, crc, value;
+
+    crc = 0xffff;
+
+    for (i = 0; i < length; ++i) {
+        value = buffer[i];
+
+        for (dbit = 0; dbit < 8; ++dbit) {
+            crc ^= (value & 0x01);
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+            value = value >> 1;
+        }
+    }
+
+    return crc ^ 0xffff;
+}
+
+int main(void) {
+    static const uint8_t check[] = "123456789";
+    uint8_t data[400];
+    uint16_t length, crc, i;
+    uint32_t n;
+    bool_t same, running, residue, original;
+    clock_t start;
+    double tableTime, bitTime;
+
+    HostCheck(CRC16((uint8_t *) check, 9) == 0x906e, "CRC of \"123456789\" is %04x, expected 906e", CRC16((uint8_t *) check, 9));
+    HostCheck(CRC16(data, 0) == 0x0000, "CRC of nothing is %04x, expected 0000", CRC16(data, 0));
+
+    srand(1);
+    same = TRUE;
+    original = TRUE;
+    running = TRUE;
+    residue = TRUE;
+    for (length = 0; length <= 330; ++length) {
+        for (i = 0; i < length; ++i)
+            data[i] = rand();
+
+        if (CRC16(data, length) != ModemCrc(data, length))
+            same = FALSE;
+        if (CRC16(data, length) != BitCrc16(data, length))
+            original = FALSE;
+
+        crc = CRC16_INIT;
+        for (i = 0; i < length; ++i)
+            crc = Crc16Update(crc, data[i]);
+        if ((crc ^ 0xffff) != ModemCrc(data, length))
+            running = FALSE;
+
+        // Run over the CRC too, low byte first, and what's left is always the same
+        crc ^= 0xffff;
+        data[length] = crc & 0xff;
+        data[length + 1] = crc >> 8;
+        crc = CRC16_INIT;
+        for (i = 0; i < length + 2; ++i)
+            crc = Crc16Update(crc, data[i]);
+        if (crc != 0xf0b8)
+            residue = FALSE;
+    }
+
+    HostCheck(same, "CRC16() matches the bit at a time CRC for 0 to 330 bytes");
+    HostCheck(original, "CRC16() matches the one it replaced");
+    HostCheck(running, "Crc16Update() a byte at a time matches");
+    HostCheck(residue, "a frame and its CRC leave the f0b8 residue");
+
+    // A 100 byte frame, about what a position packet is, over and over
+    start = clock();
+    for (n = 0; n < 200000; ++n)
+        sink = CRC16(data + n % 200, 100);
+    tableTime = (double) (clock() - start) / CLOCKS_PER_SEC / 200000;
+
+    start = clock();
+    for (n = 0; n < 200000; ++n)
+        sink = BitCrc16(data + n % 200, 100);
+    bitTime = (double) (clock() - start) / CLOCKS_PER_SEC / 200000;
+
+    printf("crc: %.1f ns a byte from the table, %.1f ns a bit at a time\n", tableTime * 1e9 / 100,
+            bitTime * 1e9 / 100);
+
+    return HostReport("crc");
+}
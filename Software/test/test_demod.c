@@ -0,0 +1,193 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <htc.h>
+#include "main.h"
+#include "tnc.h"
+#include "demod.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * The receive demodulator, fed our own modulator's audio.  The DAC log is
+ * resampled to the ADC's 9604 Hz with silence on either side, scaled and biased
+ * into ADRESH, and run through DemodAdcInterrupt() a sample at a time, with the
+ * main loop's DemodGetFrame() polled between samples.  Every packet has to come
+ * out, quiet or noisy, and nothing that isn't one of them ever may.  The channel
+ * has to be busy while the packets are on the air, and clear before and after.
+ */
+
+/// ADC sample rate, the timer 3 clock over DEMOD_CCPR2
+#define TEST_ADC_RATE (8000000.0 / DEMOD_CCPR2)
+
+/// Seconds of silence before and after the packets
+#define TEST_SILENCE 0.2
+
+/// A packet's information field
+typedef struct {
+    const uint8_t *data;
+    uint16_t length;
+} INFO;
+
+static const uint8_t text[] = "!3316.25N/11152.68W>demod test";
+static const uint8_t ones[] = {0xff, 0xff, 0xff, 0x7e, 0x7e, 0x3f, 0xfc, 0x1f, 0xf8, 0x00, 0xff, 0x1f};
+static const uint8_t binary[] = {0x00, 0x01, 0x80, 0xc0, 0xdb, 0xdc, 0xdd, 0xfe, 0x0f, 0xf0};
+
+static const INFO packets[] = {{text, sizeof(text) - 1}, {ones, sizeof(ones)}, {binary, sizeof(binary)}};
+
+/// ADC samples of the packets, full scale is +/-1
+static double *adc;
+static uint32_t adcCount;
+
+/**
+ * Send the packets in one transmission and resample the audio to the ADC rate.
+ *
+ * @param count number of packets
+ */
+static void Send(uint8_t count) {
+    int16_t *audio;
+    uint32_t samples, silence, n;
+    double t;
+    uint8_t i;
+
+    HostReset();
+    for (i = 0; i < count; ++i) {
+        TncFrameStart(config.destCallSign);
+        TncFrameAppend((uint8_t *) packets[i].data, packets[i].length);
+        TncFrameEnd();
+    }
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+
+    samples = HostAudio(&audio);
+    silence = (uint32_t) (TEST_SILENCE * TEST_ADC_RATE);
+    adcCount = (uint32_t) ((double) samples * TEST_ADC_RATE / HOST_WAV_RATE) + 2 * silence;
+    free(adc);
+    adc = calloc(adcCount, sizeof(double));
+
+    // Linear between the 48 kHz samples
+    for (n = 0; n + 2 * silence < adcCount; ++n) {
+        t = n * HOST_WAV_RATE / TEST_ADC_RATE;
+        if ((uint32_t) t + 1 < samples)
+            adc[silence + n] = (audio[(uint32_t) t] + (t - floor(t)) * (audio[(uint32_t) t + 1] - audio[(uint32_t) t])) / 32768.0;
+    }
+
+    free(audio);
+}
+
+/**
+ * Gaussian noise, the same every run.
+ */
+static double Noise(void) {
+    double u, v;
+
+    u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/**
+ * Run the samples through the demodulator and check what comes out.
+ *
+ * @param name what's being tried, for the messages
+ * @param count number of packets sent
+ * @param amplitude peak of the audio, out of the ADC's full scale
+ * @param noise RMS noise, out of the ADC's full scale
+ * @param expected number of packets that have to be received
+ */
+static void Receive(const char *name, uint8_t count, double amplitude, double noise, uint8_t expected) {
+    uint8_t frame[DEMOD_MAX_FRAME], sent[MODEM_MAX_FRAME], received, bad, i;
+    uint16_t length;
+    uint32_t silence, busyBefore, busyDuring, busyAfter, n;
+    double level;
+
+    silence = (uint32_t) (TEST_SILENCE * TEST_ADC_RATE);
+    received = 0;
+    bad = 0;
+    busyBefore = 0;
+    busyDuring = 0;
+    busyAfter = 0;
+
+    srand(1);
+    DemodStart();
+
+    for (n = 0; n < adcCount; ++n) {
+        level = 128 + 127 * (amplitude * adc[n] + noise * Noise());
+        ADRESH = (uint8_t) (level < 0 ? 0 : (level > 255 ? 255 : level + 0.5));
+        ADIF = 1;
+        DemodAdcInterrupt();
+
+        // The demodulator takes a bit to hear the flags and DEMOD_DCD_BITS to let go
+        if (n < silence)
+            busyBefore += DemodIsChannelBusy();
+        else if (n > silence + 16 * DEMOD_SAMPLES_PER_BIT && n < adcCount - silence)
+            busyDuring += DemodIsChannelBusy();
+        else if (n > adcCount - silence + (DEMOD_DCD_BITS + 8) * DEMOD_SAMPLES_PER_BIT)
+            busyAfter += DemodIsChannelBusy();
+
+        length = DemodGetFrame(frame, sizeof(frame));
+        if (length == 0)
+            continue;
+
+        for (i = 0; i < count; ++i)
+            if (ModemFrame(sent, "APRS  ", packets[i].data, packets[i].length) == length && memcmp(sent, frame, length) == 0)
+                break;
+        if (i < count && i == received)
+            ++received;
+        else
+            ++bad;
+    }
+
+    DemodStop();
+
+    HostCheck(received >= expected, "%s: %u of %u packets received, expected %u", name, received, count, expected);
+    HostCheck(bad == 0, "%s: %u frames out of order or not sent", name, bad);
+    if (expected == count) {
+        HostCheck(busyBefore == 0, "%s: channel busy for %u samples of silence before", name, busyBefore);
+        HostCheck(busyDuring > (adcCount - 2 * silence) * 9 / 10, "%s: channel busy for only %u of %u samples of packets",
+                name, busyDuring, adcCount - 2 * silence);
+        HostCheck(busyAfter == 0, "%s: channel still busy for %u samples after", name, busyAfter);
+    }
+}
+
+int main(void) {
+    uint8_t frame[DEMOD_MAX_FRAME], length;
+    uint32_t n;
+
+    TncConfigDefault();
+    DemodInit();
+
+    HostCheck(DemodGetFrame(frame, sizeof(frame)) == 0, "no frame before any audio");
+
+    Send(1);
+    Receive("one packet", 1, 0.9, 0, 1);
+    Receive("quiet", 1, 0.1, 0, 1);
+    Receive("noisy", 1, 0.5, 0.1, 1);
+    Receive("silence", 1, 0, 0.2, 0);
+
+    // The main loop polls between samples, so the double buffer keeps up with back to back packets
+    Send(3);
+    Receive("three back to back", 3, 0.9, 0, 3);
+    Receive("three noisy", 3, 0.5, 0.1, 3);
+
+    // Too much noise loses packets, but never lets a bad one through
+    Receive("buried", 3, 0.3, 0.5, 0);
+
+    // A short buffer gets the start of the frame and the whole length
+    Send(1);
+    memset(frame, 0xaa, sizeof(frame));
+    DemodStart();
+    length = 0;
+    for (n = 0; n < adcCount && length == 0; ++n) {
+        ADRESH = (uint8_t) (128 + 115 * adc[n]);
+        DemodAdcInterrupt();
+        length = DemodGetFrame(frame, 10);
+    }
+    HostCheck(length == ModemFrame(frame + 20, "APRS  ", text, sizeof(text) - 1), "short buffer gets length %u", length);
+    HostCheck(memcmp(frame, frame + 20, 10) == 0 && frame[10] == 0xaa, "short buffer gets only its 10 bytes");
+
+    return HostReport("demod");
+}
@@ -0,0 +1,267 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "gps.h"
+#include "tnc.h"
+#include "flight.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * Flight phases and digipeater paths, over synthetic flights with a fix a
+ * second, GPS noise on the altitude, and the odd glitch.  Each phase has to be picked up
+ * within a bounded time of the balloon doing it and never falsely, the path
+ * on the air has to follow the altitude with its hysteresis, and the address
+ * fields may only be rebuilt when the path changes.  To see the rebuilds, the
+ * call sign is changed after every fix, so a packet carries the one from the
+ * last rebuild.  The climb rate has to follow the GPS time, however many fixes
+ * come in a second and however far apart they are.
+ */
+
+static uint8_t message[] = "flight test";
+
+/// Names for the messages
+static const char *phaseNames[] = {"ground", "ascent", "float", "descent", "landed"};
+
+/// The fix, and the fix number the path last changed at
+static GPSData gps;
+static uint32_t fixNumber, pathChange;
+
+/// The path as a string, and the phase, after the last fix
+static char path[32];
+static FLIGHT_PHASE phase;
+
+/// When each phase was first seen, in seconds, or -1
+static int32_t phaseTime[5];
+
+/// Path changes seen
+static uint16_t pathChanges;
+
+/**
+ * Send a packet and read the source and path out of its address fields.
+ *
+ * @param source filled with the source call sign
+ * @param relays filled with the relays, comma separated
+ *
+ * @return false if it didn't decode
+ */
+static bool_t Send(char *source, char *relays) {
+    uint8_t i, *address;
+
+    HostReset();
+    TncPreparePacket(message, config.destCallSign);
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+    if (ModemAfskDecode() != 1)
+        return FALSE;
+
+    for (i = 0; i < 6; ++i)
+        source[i] = modemFrames[0].data[7 + i] >> 1;
+    source[6] = 0;
+
+    relays[0] = 0;
+    for (address = modemFrames[0].data + 14; !(address[-1] & 0x01); address += 7) {
+        if (relays[0] != 0)
+            strcat(relays, ",");
+        for (i = 0; i < 6 && address[i] != (' ' << 1); ++i)
+            relays[strlen(relays) + 1] = 0, relays[strlen(relays)] = address[i] >> 1;
+        sprintf(relays + strlen(relays), "-%u", (address[6] >> 1) & 0x0f);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Expected path for an altitude and phase.
+ */
+static const char *Expected(FLIGHT_PHASE phase, int32_t altitude, const char *last) {
+    if (phase == FLIGHT_GROUND || phase == FLIGHT_LANDED)
+        return "WIDE1-1,WIDE2-1";
+    if (altitude > FLIGHT_DIRECT_ALTITUDE ||
+            (strcmp(last, "") == 0 && altitude > FLIGHT_DIRECT_ALTITUDE - FLIGHT_PATH_HYSTERESIS))
+        return "";
+    return "WIDE2-1";
+}
+
+/**
+ * Set the fix's GPS time.  Flights start at 23:00 UTC, so the longer ones go
+ * through midnight.
+ *
+ * @param seconds seconds since the start of the flight
+ */
+static void SetTime(uint32_t seconds) {
+    seconds = (seconds + 23 * 3600) % (24 * 3600);
+    gps.hours = seconds / 3600;
+    gps.minutes = seconds / 60 % 60;
+    gps.seconds = seconds % 60;
+}
+
+/**
+ * Feed a fix and follow what it did.  Every so often a packet is sent to check
+ * the path on the air, and that the header was built at the last path change.
+ *
+ * @param altitude altitude in cm, before the noise
+ * @param seconds seconds since the start of the flight
+ */
+static void Fix(double altitude, uint32_t seconds) {
+    char source[7], relays[32], callSign[8], expected[32];
+
+    SetTime(seconds);
+
+    // The GPS wanders a few meters, and jitters a meter fix to fix
+    gps.altitude = (int32_t) (altitude + 300 * sin(fixNumber / 60.0)) + rand() % 201 - 100;
+
+    strcpy(expected, Expected(FlightGetPhase(), gps.altitude, path));
+    FlightUpdate(&gps);
+    ++fixNumber;
+
+    if (FlightGetPhase() != phase) {
+        phase = FlightGetPhase();
+        if (phaseTime[phase] < 0)
+            phaseTime[phase] = seconds;
+    }
+    strcpy(expected, Expected(phase, gps.altitude, path));
+
+    // A new call sign after every fix, so the header shows when it was last built
+    snprintf(callSign, sizeof(callSign), "F%05lu", (unsigned long) (fixNumber % 100000));
+
+    if (strcmp(expected, path) != 0) {
+        strcpy(path, expected);
+        pathChange = fixNumber;
+        ++pathChanges;
+    }
+
+    if (fixNumber % 97 == 0 || pathChange == fixNumber) {
+        if (!HostCheck(Send(source, relays), "fix %lu: packet didn't decode", (unsigned long) fixNumber))
+            return;
+        HostCheck(strcmp(relays, path) == 0, "fix %lu, %s at %ld cm: path is \"%s\", not \"%s\"", (unsigned long) fixNumber,
+                phaseNames[phase], (long) gps.altitude, relays, path);
+        snprintf(expected, sizeof(expected), "F%05lu", (unsigned long) ((pathChange - 1) % 100000));
+        HostCheck(strcmp(source, expected) == 0 || (pathChange == 1 && strcmp(source, "AD7ZJ ") == 0),
+                "fix %lu: header last built with %s, the path changed after %s", (unsigned long) fixNumber, source, expected);
+    }
+
+    memcpy(config.callSign, callSign, 6);
+}
+
+/**
+ * Start a new flight.
+ */
+static void Start(void) {
+    uint8_t i;
+
+    TncConfigDefault();
+    config.txDelay = 4;
+    FlightInit();
+    memset(&gps, 0, sizeof(gps));
+    fixNumber = pathChange = 0;
+    pathChanges = 0;
+    strcpy(path, "?");
+    phase = FLIGHT_GROUND;
+    for (i = 0; i < 5; ++i)
+        phaseTime[i] = -1;
+    phaseTime[FLIGHT_GROUND] = 0;
+}
+
+/**
+ * Climb at 5 m/s for five minutes and get the climb rate.
+ *
+ * @param step seconds between fixes
+ * @param reports times each fix is reported, 10 cm apart, the way a receiver
+ * sending both GGA and NAV-PVT does
+ *
+ * @return climb rate in cm/s
+ */
+static int16_t Climb(uint8_t step, uint8_t reports) {
+    uint32_t t;
+    uint8_t i;
+
+    Start();
+    for (t = 0; t < 300; t += step)
+        for (i = 0; i < reports; ++i) {
+            SetTime(t);
+            gps.altitude = 150000 + 500 * t + 10 * i;
+            FlightUpdate(&gps);
+        }
+
+    return FlightGetClimbRate();
+}
+
+int main(void) {
+    uint32_t t, launch, burst, landing;
+    double altitude, rate;
+
+    srand(1);
+
+    // A flight:  10 minutes waiting at 1500 m, up at 5 m/s to 30 km, an hour
+    // floating, down fast then slowing under the parachute, and 20 minutes on the
+    // ground at 1200 m
+    Start();
+    altitude = 150000;
+    launch = 600;
+    for (t = 0; t < launch; ++t)
+        Fix(altitude, t);
+    for (; altitude < 3000000; ++t)
+        Fix((altitude += 500) - (t == launch + 1800 ? 300000 : 0), t);
+    burst = t + 3600;
+    for (; t < burst; ++t)
+        Fix(altitude, t);
+    for (rate = 3000; altitude > 120000; ++t) {
+        Fix(altitude, t);
+        rate = 500 + (rate - 500) * 0.999;
+        altitude -= rate;
+    }
+    landing = t;
+    for (; t < landing + 1200; ++t)
+        Fix(120000, t);
+
+    HostCheck(phaseTime[FLIGHT_ASCENT] > (int32_t) launch && phaseTime[FLIGHT_ASCENT] < (int32_t) launch + 40,
+            "ascent seen at %ld s, launch at %lu", (long) phaseTime[FLIGHT_ASCENT], (unsigned long) launch);
+    HostCheck(phaseTime[FLIGHT_FLOAT] > (int32_t) (burst - 3600 + FLIGHT_STEADY_TIME - 10) &&
+            phaseTime[FLIGHT_FLOAT] < (int32_t) (burst - 3600 + FLIGHT_STEADY_TIME + 40),
+            "float seen at %ld s, levelled off at %lu", (long) phaseTime[FLIGHT_FLOAT], (unsigned long) (burst - 3600));
+    HostCheck(phaseTime[FLIGHT_DESCENT] >= (int32_t) burst && phaseTime[FLIGHT_DESCENT] < (int32_t) burst + 10,
+            "descent seen at %ld s, burst at %lu", (long) phaseTime[FLIGHT_DESCENT], (unsigned long) burst);
+    HostCheck(phaseTime[FLIGHT_LANDED] > (int32_t) landing && phaseTime[FLIGHT_LANDED] < (int32_t) landing + FLIGHT_STEADY_TIME + 60,
+            "landed seen at %ld s, landed at %lu", (long) phaseTime[FLIGHT_LANDED], (unsigned long) landing);
+    HostCheck(phase == FLIGHT_LANDED, "flight ended %s", phaseNames[phase]);
+    printf("flight: ascent, float, descent and landed seen %ld, %ld, %ld and %ld s after they happened\n",
+            (long) (phaseTime[FLIGHT_ASCENT] - launch), (long) (phaseTime[FLIGHT_FLOAT] - (burst - 3600)),
+            (long) (phaseTime[FLIGHT_DESCENT] - burst), (long) (phaseTime[FLIGHT_LANDED] - landing));
+    HostCheck(pathChanges == 5, "%u path changes in a flight, not 5", pathChanges);
+
+    // Waiting on the ground for an hour, with the odd glitch, isn't a launch
+    Start();
+    for (t = 0; t < 3600; ++t)
+        Fix(t % 900 == 450 ? 350000 : 150000, t);
+    HostCheck(phase == FLIGHT_GROUND, "glitches on the ground made it %s", phaseNames[phase]);
+
+    // Slowly up and down around the direct altitude only changes the path at the edges
+    Start();
+    for (altitude = 150000, t = 0; altitude < FLIGHT_DIRECT_ALTITUDE - 200000; ++t)
+        Fix(altitude += 500, t);
+    for (launch = t; t < launch + 7200; ++t)
+        Fix(FLIGHT_DIRECT_ALTITUDE - FLIGHT_PATH_HYSTERESIS / 2 + 100000 * sin((t - launch) / 300.0), t);
+    HostCheck(pathChanges == 1 + 1 + 2 * 4, "%u path changes around the direct altitude, not %u", pathChanges, 1 + 1 + 2 * 4);
+
+    // A leaking balloon that comes down to float lower again
+    Start();
+    for (altitude = 150000, t = 0; altitude < 2500000; ++t)
+        Fix(altitude += 500, t);
+    for (; altitude > 1500000; ++t)
+        Fix(altitude -= 300, t);
+    for (launch = t; t < launch + 600; ++t)
+        Fix(altitude, t);
+    HostCheck(phase == FLIGHT_FLOAT, "a lower float is %s", phaseNames[phase]);
+
+    // The rate goes by the GPS time, not the number of fixes
+    HostCheck(abs(Climb(1, 1) - 500) <= 10, "climb rate %d cm/s with a fix a second, not 500", Climb(1, 1));
+    HostCheck(abs(Climb(1, 2) - 500) <= 10, "climb rate %d cm/s with each second reported twice, not 500", Climb(1, 2));
+    HostCheck(abs(Climb(2, 1) - 500) <= 10, "climb rate %d cm/s with a fix every other second, not 500", Climb(2, 1));
+    HostCheck(abs(Climb(20, 1) - 500) <= 10, "climb rate %d cm/s with a fix every 20 seconds, not 500", Climb(20, 1));
+
+    return HostReport("flight");
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "fx25.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * FX.25 code blocks, taken back out of the tones and corrected by the reference
+ * Reed-Solomon decoder.  Each packet size has to get the smallest code that
+ * holds it, the block has to be a clean codeword with the packet inside, and a
+ * plain AX.25 receiver still has to find the packet.  Then random byte errors
+ * are put in the block:  up to 8 have to be corrected every time, and the
+ * recovery rate is printed next to what plain AX.25 gets from the same block.
+ */
+
+/// Trials of each number of errors for each packet
+#define TEST_TRIALS 100
+/// Most byte errors put in a block
+#define TEST_MAX_ERRORS 12
+
+/// Blocks recovered with and without the check bytes, by number of errors
+static uint32_t fx25Recovered[TEST_MAX_ERRORS + 1], ax25Recovered[TEST_MAX_ERRORS + 1], trials;
+
+/// Frames that came out of a corrupted block with a good CRC but the wrong bytes
+static uint32_t wrongFrames;
+
+/// Correlation tags of the codes, smallest first, and their data block sizes
+static const uint64_t tags[] = {0x8f056eb4369660eeULL, 0xc7dc0508f3d9b09eULL, 0x26ff60a600cc8fdeULL, 0xb74db7df8a532f3eULL};
+static const uint8_t sizes[] = {32, 64, 128, 239};
+
+/**
+ * Unpack bytes LSB first, the order they're sent.
+ */
+static void Unpack(uint8_t *bits, const uint8_t *bytes, uint16_t length) {
+    uint16_t n;
+    uint8_t i;
+
+    for (n = 0; n < length; ++n)
+        for (i = 0; i < 8; ++i)
+            bits[n * 8 + i] = (bytes[n] >> i) & 1;
+}
+
+/**
+ * Check if the data block of a code block holds just the one frame expected.
+ */
+static bool_t Recovered(const uint8_t *block, uint8_t size, const uint8_t *frame, uint16_t length) {
+    static uint8_t bits[8 * 239];
+
+    Unpack(bits, block, size);
+    ModemHdlcDeframe(bits, size * 8);
+    if (modemFrameCount == 1 && modemFrames[0].length == length && memcmp(modemFrames[0].data, frame, length) == 0)
+        return TRUE;
+
+    wrongFrames += modemFrameCount;
+    return FALSE;
+}
+
+/**
+ * Send a packet as FX.25 and check its code block, then see what's left of it
+ * after errors.
+ *
+ * @param name what's being sent, for the messages
+ * @param length information field length
+ */
+static void Send(const char *name, uint16_t length) {
+    static uint8_t info[TNC_MAX_TX], bits[8 * 4 * TNC_MAX_TX], block[255], corrupt[255];
+    uint8_t frame[MODEM_MAX_FRAME], code, used, i;
+    uint16_t frameLength, position, n, errors, trial;
+    uint32_t before, start, count;
+    uint64_t tag;
+
+    for (n = 0; n < length; ++n)
+        info[n] = (n & 1 ? 0xff : ' ' + n % 64);
+    frameLength = ModemFrame(frame, "APRS  ", info, length);
+
+    // The smallest code that holds the packet between an opening and closing flag
+    used = (ModemHdlcBits(bits, frame, frameLength) + 16 + 7) / 8;
+    for (code = 0; code < sizeof(sizes) && sizes[code] < used; ++code)
+        ;
+
+    before = ModemDacTones();
+    HostCheck(TncFrameStart(config.destCallSign), "%s: packet started", name);
+    TncFrameAppend(info, length);
+    HostCheck(TncFrameEnd(), "%s: packet queued", name);
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+    count = ModemDacTones() - before;
+
+    // NRZI decode the transmission and find the tag, sent LSB first
+    for (n = 0; n < count; ++n)
+        bits[n] = (before + n == 0 || modemTones[before + n] == modemTones[before + n - 1]);
+    tag = 0;
+    for (start = 0; start < count; ++start) {
+        tag = (tag >> 1) | ((uint64_t) bits[start] << 63);
+        if (start >= 63 && (tag == tags[0] || tag == tags[1] || tag == tags[2] || tag == tags[3]))
+            break;
+    }
+    ++start;
+
+    HostCheck(code < sizeof(sizes) && tag == tags[code], "%s: %u bytes should have the %u byte code", name, used,
+            code < sizeof(sizes) ? sizes[code] : 0);
+    if (code == sizeof(sizes) || tag != tags[code] || start + (sizes[code] + FX25_CHECK_BYTES) * 8 > count)
+        return;
+
+    for (n = 0; n < sizes[code] + FX25_CHECK_BYTES; ++n) {
+        block[n] = 0;
+        for (i = 0; i < 8; ++i)
+            block[n] |= bits[start + n * 8 + i] << i;
+    }
+
+    HostCheck(ModemRsDecode(block, sizes[code] + FX25_CHECK_BYTES, FX25_CHECK_BYTES, 1) == 0, "%s: code block isn't a codeword", name);
+    HostCheck(Recovered(block, sizes[code], frame, frameLength), "%s: packet isn't in the data block", name);
+
+    // A receiver that ignores the tag and check bytes still hears the packet
+    ModemHdlcDeframe(bits, count);
+    HostCheck(modemFrameCount >= 1 && modemFrames[0].length == frameLength && memcmp(modemFrames[0].data, frame, frameLength) == 0,
+            "%s: plain AX.25 receiver doesn't get the packet", name);
+
+    for (errors = 0; errors <= TEST_MAX_ERRORS; ++errors)
+        for (trial = 0; trial < TEST_TRIALS; ++trial) {
+            memcpy(corrupt, block, sizes[code] + FX25_CHECK_BYTES);
+            for (n = 0; n < errors; ++n) {
+                // Each error in a different byte
+                do
+                    position = rand() % (sizes[code] + FX25_CHECK_BYTES);
+                while (corrupt[position] != block[position]);
+                corrupt[position] ^= 1 + rand() % 255;
+            }
+
+            ax25Recovered[errors] += Recovered(corrupt, sizes[code], frame, frameLength);
+            if (ModemRsDecode(corrupt, sizes[code] + FX25_CHECK_BYTES, FX25_CHECK_BYTES, 1) >= 0)
+                fx25Recovered[errors] += Recovered(corrupt, sizes[code], frame, frameLength);
+        }
+    trials += TEST_TRIALS;
+}
+
+int main(void) {
+    uint8_t errors;
+
+    srand(1);
+    HostReset();
+    TncConfigDefault();
+    config.txDelay = 4;
+    config.framing = TNC_FRAMING_FX25;
+
+    Send("short", 10);
+    Send("medium", 50);
+    Send("long", 90);
+
+    // Without a path the shortest packets fit the smallest code
+    config.relayCallSign1[0] = 0;
+    config.relayCallSign2[0] = 0;
+    TncBuildHeader();
+    Send("no path", 2);
+
+    printf("fx25: packets recovered from %u blocks with random byte errors\n", trials);
+    printf("  errors  FX.25  AX.25\n");
+    for (errors = 0; errors <= TEST_MAX_ERRORS; ++errors) {
+        printf("  %6u  %4u%%  %4u%%\n", errors, fx25Recovered[errors] * 100 / trials, ax25Recovered[errors] * 100 / trials);
+        if (errors <= FX25_CHECK_BYTES / 2)
+            HostCheck(fx25Recovered[errors] == trials, "only %u of %u blocks with %u errors recovered", fx25Recovered[errors], trials, errors);
+    }
+    HostCheck(ax25Recovered[1] < trials / 2, "plain AX.25 got through %u of %u single errors", ax25Recovered[1], trials);
+    HostCheck(wrongFrames == 0, "%u wrong frames had good CRCs", wrongFrames);
+
+    return HostReport("fx25");
+}
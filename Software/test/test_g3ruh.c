@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * G3RUH 9600 baud.  The baseband in the DAC log is descrambled by the reference
+ * modem and held to the same NRZI tones the AFSK sends:  8 times the txDelay
+ * flags, so the preamble lasts as long, then each packet bit stuffed with its CRC
+ * and two closing flags.  The frames have to come
+ * back out of it, every sample has to be a peak, a trough, or the zero crossing
+ * between, and the bits have to come at 9600 baud, about 8 times as fast as the
+ * same packets in AFSK.
+ */
+
+/// A packet's information field
+typedef struct {
+    const uint8_t *data;
+    uint16_t length;
+} INFO;
+
+static const uint8_t text[] = "!3316.25N/11152.68W>G3RUH test";
+static const uint8_t ones[] = {0xff, 0xff, 0xff, 0x7e, 0x7e, 0x3f, 0xfc, 0x1f, 0xf8, 0x00, 0xff, 0x1f};
+static const uint8_t zeros[32];
+
+/// The scrambler and descrambler agree once the 17 bit shift register has filled
+#define TEST_SCRAMBLER_BITS 17
+
+/**
+ * Send packets in one transmission.
+ *
+ * @param packets information fields to send
+ * @param count number of packets
+ *
+ * @return timer ticks from the first DAC write to the end of the last
+ */
+static uint64_t Send(const INFO *packets, uint8_t count) {
+    uint8_t i;
+
+    HostReset();
+    for (i = 0; i < count; ++i) {
+        HostCheck(TncFrameStart(config.destCallSign), "packet %u started", i);
+        TncFrameAppend((uint8_t *) packets[i].data, packets[i].length);
+        HostCheck(TncFrameEnd(), "packet %u queued", i);
+    }
+
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+
+    return hostDac[hostDacCount - 1].time + hostDac[hostDacCount - 1].pr2 + 1 - hostDac[0].time;
+}
+
+int main(void) {
+    static const INFO packets[] = {{text, sizeof(text) - 1}, {ones, sizeof(ones)}, {zeros, sizeof(zeros)}};
+    static uint8_t bits[8 * 4 * (TNC_MAX_TX + 64)];
+    uint8_t frame[MODEM_MAX_FRAME], tone, i;
+    uint16_t length;
+    uint32_t expected, n;
+    uint64_t g3ruh, afsk;
+    bool_t ok;
+    double baud;
+
+    TncConfigDefault();
+    config.modulation = TNC_G3RUH_9600;
+    g3ruh = Send(packets, 3);
+
+    // Every packet comes back out of the baseband
+    HostCheck(ModemG3ruhTones() > 0 && ModemDeframe() == 3, "%u of 3 packets decoded", modemFrameCount);
+    for (i = 0; i < modemFrameCount && i < 3; ++i) {
+        length = ModemFrame(frame, "APRS  ", packets[i].data, packets[i].length);
+        HostCheck(modemFrames[i].length == length && memcmp(modemFrames[i].data, frame, length) == 0, "packet %u decodes", i);
+    }
+
+    // The same tones as the AFSK, from where the descrambler has caught up
+    expected = 0;
+    for (n = 0; n < config.txDelay * 8; ++n)
+        expected += ModemFlag(bits + expected);
+    for (i = 0; i < 3; ++i) {
+        length = ModemFrame(frame, "APRS  ", packets[i].data, packets[i].length);
+        expected += ModemHdlcBits(bits + expected, frame, length);
+        expected += ModemFlag(bits + expected);
+        expected += ModemFlag(bits + expected);
+    }
+    tone = 0;
+    ModemNrzi(bits, expected, &tone);
+
+    HostCheck(modemToneCount == expected, "%u bits sent, expected %u", modemToneCount, expected);
+    for (n = TEST_SCRAMBLER_BITS; n < expected && n < modemToneCount; ++n)
+        if (modemTones[n] != bits[n])
+            break;
+    HostCheck(n == expected, "bit %u is wrong", n);
+
+    // Two samples a bit.  The second is at the bit's level, the first is too unless the level changes.
+    ok = (hostDacCount % 2 == 0);
+    for (n = 0; n + 1 < hostDacCount; n += 2) {
+        if (hostDac[n].pr2 != TNC_G3RUH_PR2 || hostDac[n + 1].pr2 != TNC_G3RUH_PR2)
+            ok = FALSE;
+        if (hostDac[n + 1].level != 0 && hostDac[n + 1].level != HOST_DAC_FULL)
+            ok = FALSE;
+        if (hostDac[n].level != hostDac[n + 1].level && ((n != 0 && hostDac[n - 1].level == hostDac[n + 1].level) ||
+                2 * hostDac[n].level < HOST_DAC_FULL - 1 || 2 * hostDac[n].level > HOST_DAC_FULL + 1))
+            ok = FALSE;
+    }
+    HostCheck(ok, "samples are only peaks, troughs, and the crossings between");
+
+    baud = (double) expected * HOST_TIMER2_RATE / g3ruh;
+    HostCheck(baud > 9600 * 0.99 && baud < 9600 * 1.01, "%.1f baud", baud);
+
+    // The packets, with the same short preamble, take an eighth of the time
+    config.txDelay = 1;
+    g3ruh = Send(packets, 3);
+    HostCheck(ModemG3ruhTones() > 0 && ModemDeframe() == 3, "%u of 3 packets decoded with a short txDelay", modemFrameCount);
+
+    config.modulation = TNC_AFSK_1200;
+    afsk = Send(packets, 3);
+    HostCheck(ModemAfskDecode() == 3, "%u of 3 packets decoded as AFSK", modemFrameCount);
+    HostCheck(afsk > 7 * g3ruh, "%.1f times shorter than AFSK, expected about 8", (double) afsk / g3ruh);
+
+    printf("g3ruh: %.1f baud, packets take %.1f mS, %.1f mS in AFSK\n", baud,
+            1000.0 * g3ruh / HOST_TIMER2_RATE, 1000.0 * afsk / HOST_TIMER2_RATE);
+
+    return HostReport("g3ruh");
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * The cached address fields.  For each path and SSID the packets have to carry
+ * what the config says once TncBuildHeader() has run, whether they go to
+ * config.destCallSign and pick up the cached CRC, or to a Mic-E destination
+ * that takes the cached one's place.  A packet to a Mic-E destination mustn't
+ * change the cache for the next one.  Last, starting a packet each way is timed
+ * against rebuilding the header for every packet, the way it was before the cache.
+ */
+
+/// Mic-E destination for 33 16.25 N, west, 100 off
+static uint8_t micE[] = "S32U6T";
+
+static uint8_t message[] = "!3316.25N/11152.68W>header test";
+
+/**
+ * Send a packet and check it against the reference built from the config.
+ *
+ * @param name what's being sent, for the messages
+ * @param dest destination call sign
+ */
+static void Send(const char *name, uint8_t *dest) {
+    static uint8_t bits[8 * 2 * MODEM_MAX_FRAME];
+    uint8_t frame[MODEM_MAX_FRAME];
+    uint16_t length, tones;
+
+    HostReset();
+    tones = TncFrameTones(message, dest);
+    HostCheck(TncPreparePacket(message, dest), "%s: packet queued", name);
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+
+    length = ModemFrame(frame, (const char *) dest, message, sizeof(message) - 1);
+    HostCheck(ModemAfskDecode() == 1 && modemFrames[0].length == length && memcmp(modemFrames[0].data, frame, length) == 0,
+            "%s to %s: packet doesn't match the config", name, dest);
+    HostCheck(tones == ModemHdlcBits(bits, frame, length), "%s to %s: TncFrameTones() is %u", name, dest, tones);
+}
+
+/**
+ * Rebuild the header for the config and send to both destinations.
+ */
+static void Check(const char *name) {
+    TncBuildHeader();
+    Send(name, config.destCallSign);
+    Send(name, micE);
+    Send(name, config.destCallSign);
+}
+
+/**
+ * Time starting a packet, up to the protocol ID, on this machine.  Host figures
+ * for comparing the ways, not PIC18 cycle counts.
+ */
+static void Benchmark(void) {
+    uint32_t n;
+    clock_t start;
+    double cached, micETime, rebuilt;
+
+    TncConfigDefault();
+
+    start = clock();
+    for (n = 0; n < 200000; ++n) {
+        TncFrameStart(config.destCallSign);
+        TncFrameAbort();
+    }
+    cached = (double) (clock() - start) / CLOCKS_PER_SEC / n;
+
+    start = clock();
+    for (n = 0; n < 200000; ++n) {
+        TncFrameStart(micE);
+        TncFrameAbort();
+    }
+    micETime = (double) (clock() - start) / CLOCKS_PER_SEC / n;
+
+    start = clock();
+    for (n = 0; n < 200000; ++n) {
+        TncBuildHeader();
+        TncFrameStart(config.destCallSign);
+        TncFrameAbort();
+    }
+    rebuilt = (double) (clock() - start) / CLOCKS_PER_SEC / n;
+
+    printf("header: %.0f ns a packet to the cached destination, %.0f ns to Mic-E, %.0f ns rebuilding it each time\n",
+            cached * 1e9, micETime * 1e9, rebuilt * 1e9);
+}
+
+int main(void) {
+    TncConfigDefault();
+    config.txDelay = 4;
+    Check("default path");
+
+    config.callSignSSID = 15;
+    config.relayCallSignSSID1 = 7;
+    config.relayCallSignSSID2 = 2;
+    Check("SSIDs");
+
+    config.relayCallSign2[0] = 0;
+    Check("one relay");
+
+    config.relayCallSign1[0] = 0;
+    Check("no relays");
+
+    strcpy(config.relayCallSign2, "WIDE1 ");
+    config.relayCallSignSSID2 = 1;
+    Check("second relay only");
+
+    strcpy(config.callSign, "N0CALL");
+    config.callSignSSID = 0;
+    strcpy(config.destCallSign, "APZPIC");
+    Check("new call signs");
+
+    Benchmark();
+
+    return HostReport("header");
+}
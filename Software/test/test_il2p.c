@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "il2p.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * IL2P packets, taken back out of the tones by a receiver written from the spec:
+ * find the sync word, correct and descramble the header, read the payload size
+ * from it, then correct and descramble the payload.  The payload has to be the
+ * packet less its CRC, with no bit stuffing anywhere, and it has to survive up to
+ * 8 byte errors in the payload and 1 in the header.  Past that the packet is lost,
+ * or, since the payload carries no CRC, now and then miscorrected into the wrong
+ * bytes; those are counted but not failed.  An AX.25 packet queued behind an IL2P
+ * one still has to reach a plain receiver.
+ */
+
+/// Trials of each number of errors for each packet
+#define TEST_TRIALS 50
+/// Most byte errors put in a payload block
+#define TEST_MAX_ERRORS 10
+
+/// Payloads recovered, by number of errors in the payload and in the header
+static uint32_t payloadRecovered[TEST_MAX_ERRORS + 1], headerRecovered[3], trials;
+
+/// Payloads miscorrected into the wrong bytes, past what the check bytes can fix
+static uint32_t wrongPayloads;
+
+/**
+ * Descramble a block in place, MSB first, with the receive side of x^9 + x^4 + 1.
+ */
+static void Descramble(uint8_t *block, uint16_t length) {
+    uint16_t state, n;
+    uint8_t in, out, i;
+
+    state = 0x1f0;
+    for (n = 0; n < length; ++n) {
+        out = 0;
+        for (i = 0; i < 8; ++i) {
+            in = (block[n] >> (7 - i)) & 1;
+            out = (out << 1) | ((in ^ state) & 1);
+            state = ((state >> 1) | (in << 8)) ^ (in << 3);
+        }
+        block[n] = out;
+    }
+}
+
+/**
+ * Receive a packet:  correct and descramble the header and payload.
+ *
+ * @param received header block then payload block with its check bytes, as sent
+ * @param payload set to the descrambled payload
+ *
+ * @return payload size, or -1 if it couldn't be corrected
+ */
+static int Receive(const uint8_t *received, uint8_t *payload) {
+    uint8_t header[IL2P_HEADER_BLOCK], block[255];
+    uint16_t count;
+    uint8_t i;
+
+    memcpy(header, received, IL2P_HEADER_BLOCK);
+    if (ModemRsDecode(header, IL2P_HEADER_BLOCK, 2, 0) < 0)
+        return -1;
+    Descramble(header, IL2P_HEADER_SIZE);
+
+    // Maximum FEC, type 0, and the size in bit 7 of bytes 2 through 11
+    if ((header[0] & 0x80) == 0 || (header[1] & 0x80) != 0)
+        return -1;
+    count = 0;
+    for (i = 0; i < 10; ++i)
+        count = (count << 1) | (header[2 + i] >> 7);
+    if (count > IL2P_MAX_BLOCK)
+        return -1;
+
+    memcpy(block, received + IL2P_HEADER_BLOCK, count + IL2P_CHECK_BYTES);
+    if (ModemRsDecode(block, count + IL2P_CHECK_BYTES, IL2P_CHECK_BYTES, 0) < 0)
+        return -1;
+    Descramble(block, count);
+    memcpy(payload, block, count);
+
+    return count;
+}
+
+/**
+ * Check a received packet against the frame that was sent.
+ */
+static bool_t Matches(const uint8_t *received, const uint8_t *frame, uint16_t length) {
+    uint8_t payload[255];
+    int count;
+
+    count = Receive(received, payload);
+    if (count < 0)
+        return FALSE;
+    if (count == length && memcmp(payload, frame, length) == 0)
+        return TRUE;
+
+    ++wrongPayloads;
+    return FALSE;
+}
+
+/**
+ * Put errors in different bytes of a block.
+ */
+static void Corrupt(uint8_t *block, const uint8_t *original, uint16_t length, uint8_t errors) {
+    uint16_t position;
+
+    while (errors-- != 0) {
+        do
+            position = rand() % length;
+        while (block[position] != original[position]);
+        block[position] ^= 1 + rand() % 255;
+    }
+}
+
+/**
+ * Send a packet as IL2P, and an AX.25 packet behind it if asked, and check them.
+ *
+ * @param name what's being sent, for the messages
+ * @param length information field length
+ * @param ax25 true to queue an AX.25 packet after it
+ */
+static void Send(const char *name, uint16_t length, bool_t ax25) {
+    static uint8_t info[TNC_MAX_TX], bits[8 * 4 * TNC_MAX_TX];
+    static const uint8_t plain[] = ">plain AX.25 after IL2P";
+    uint8_t frame[MODEM_MAX_FRAME], received[IL2P_HEADER_BLOCK + 255], corrupt[IL2P_HEADER_BLOCK + 255], errors;
+    uint16_t frameLength, size, n, trial;
+    uint32_t before, count, start, sync;
+    uint8_t i;
+
+    for (n = 0; n < length; ++n)
+        info[n] = (n & 1 ? 0xff : ' ' + n % 64);
+    frameLength = ModemFrame(frame, "APRS  ", info, length);
+
+    before = ModemDacTones();
+    HostCheck(TncFrameStart(config.destCallSign), "%s: packet started", name);
+    TncFrameAppend(info, length);
+    HostCheck(TncFrameEnd(), "%s: packet queued", name);
+    if (ax25) {
+        config.framing = TNC_FRAMING_AX25;
+        HostCheck(TncFrameStart(config.destCallSign), "%s: AX.25 packet started", name);
+        TncFrameAppend((uint8_t *) plain, sizeof(plain) - 1);
+        HostCheck(TncFrameEnd(), "%s: AX.25 packet queued", name);
+        config.framing = TNC_FRAMING_IL2P;
+    }
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+    count = ModemDacTones() - before;
+
+    // The sync word, MSB first, a mark is a one
+    sync = 0;
+    for (start = 0; start < count; ++start) {
+        sync = ((sync << 1) | modemTones[before + start]) & 0xffffff;
+        if (start >= 23 && sync == IL2P_SYNC_WORD)
+            break;
+    }
+    ++start;
+
+    size = IL2P_HEADER_BLOCK + frameLength + IL2P_CHECK_BYTES;
+    HostCheck(start + size * 8 <= count, "%s: no sync word", name);
+    if (start + size * 8 > count)
+        return;
+
+    for (n = 0; n < size; ++n) {
+        received[n] = 0;
+        for (i = 0; i < 8; ++i)
+            received[n] = (received[n] << 1) | modemTones[before + start + n * 8 + i];
+    }
+
+    HostCheck(ModemRsDecode(received, IL2P_HEADER_BLOCK, 2, 0) == 0, "%s: header isn't a codeword", name);
+    HostCheck(ModemRsDecode(received + IL2P_HEADER_BLOCK, frameLength + IL2P_CHECK_BYTES, IL2P_CHECK_BYTES, 0) == 0,
+            "%s: payload isn't a codeword", name);
+    HostCheck(Matches(received, frame, frameLength), "%s: payload isn't the packet", name);
+
+    if (ax25) {
+        // NRZI decode what follows the IL2P packet for a plain receiver
+        start += size * 8;
+        for (n = 0; start + n + 1 < count; ++n)
+            bits[n] = (modemTones[before + start + n + 1] == modemTones[before + start + n]);
+        ModemHdlcDeframe(bits, n);
+        frameLength = ModemFrame(frame, "APRS  ", plain, sizeof(plain) - 1);
+        HostCheck(modemFrameCount == 1 && modemFrames[0].length == frameLength && memcmp(modemFrames[0].data, frame, frameLength) == 0,
+                "%s: AX.25 packet after it isn't received", name);
+        return;
+    }
+
+    for (trial = 0; trial < TEST_TRIALS; ++trial) {
+        for (errors = 0; errors <= TEST_MAX_ERRORS; ++errors) {
+            memcpy(corrupt, received, size);
+            Corrupt(corrupt + IL2P_HEADER_BLOCK, received + IL2P_HEADER_BLOCK, size - IL2P_HEADER_BLOCK, errors);
+            payloadRecovered[errors] += Matches(corrupt, frame, frameLength);
+        }
+
+        for (errors = 0; errors <= 2; ++errors) {
+            memcpy(corrupt, received, size);
+            Corrupt(corrupt, received, IL2P_HEADER_BLOCK, errors);
+            headerRecovered[errors] += Matches(corrupt, frame, frameLength);
+        }
+    }
+    trials += TEST_TRIALS;
+}
+
+int main(void) {
+    uint8_t errors;
+
+    srand(1);
+    HostReset();
+    TncConfigDefault();
+    config.txDelay = 4;
+    config.framing = TNC_FRAMING_IL2P;
+
+    Send("short", 1, FALSE);
+    Send("medium", 40, FALSE);
+    Send("long", 90, FALSE);
+    Send("AX.25 behind", 20, TRUE);
+
+    printf("il2p: packets recovered from %u blocks with random byte errors\n", trials);
+    printf("  errors  payload  header\n");
+    for (errors = 0; errors <= TEST_MAX_ERRORS; ++errors) {
+        if (errors <= 2)
+            printf("  %6u  %6u%%  %5u%%\n", errors, payloadRecovered[errors] * 100 / trials, headerRecovered[errors] * 100 / trials);
+        else
+            printf("  %6u  %6u%%\n", errors, payloadRecovered[errors] * 100 / trials);
+        if (errors <= IL2P_CHECK_BYTES / 2)
+            HostCheck(payloadRecovered[errors] == trials, "only %u of %u payloads with %u errors recovered",
+                    payloadRecovered[errors], trials, errors);
+    }
+    HostCheck(headerRecovered[1] == trials, "only %u of %u headers with an error recovered", headerRecovered[1], trials);
+    printf("  %u miscorrected past the limits\n", wrongPayloads);
+
+    return HostReport("il2p");
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "kiss.h"
+#include "fifo.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * The KISS TNC, fed through the serial FIFO the way the receive interrupt fills
+ * it, with the main loop's KissUpdate() and RadioUpdate() run against the
+ * simulated clock.  Frames have to come off the air byte for byte as the host
+ * sent them, escapes undone, whether they're sent alone or back to back on a
+ * shared FEND.  Parameter frames have to set the configuration without keying
+ * up, frames too short to address have to be dropped, and a FIFO overrun has to
+ * lose only the frames it cut into, and the ones waiting ahead of them.
+ */
+
+static uint8_t info[] = "KISS test";
+
+/// What the host sends, KISS encoded
+static uint8_t serial[1024];
+static uint16_t serialLength;
+
+/**
+ * Start a scenario with the default configuration, an empty FIFO, and a fresh
+ * clock.  KISS mode is entered on a FEND, so KissInit() acts like one was just
+ * received.
+ */
+static void Reset(void) {
+    TncConfigDefault();
+    config.txDelay = 4;
+    FifoClear();
+    KissInit();
+    HostReset();
+    serialLength = 0;
+}
+
+/**
+ * Add a frame to what the host sends, escaping FEND and FESC.
+ *
+ * @param command command byte
+ * @param data frame contents
+ * @param length length of the contents
+ * @param shareFend leave off the opening FEND, so the last frame's closing one starts it
+ */
+static void Kiss(uint8_t command, const uint8_t *data, uint16_t length, bool_t shareFend) {
+    uint16_t i;
+
+    if (!shareFend)
+        serial[serialLength++] = KISS_FEND;
+    serial[serialLength++] = command;
+
+    for (i = 0; i < length; ++i) {
+        if (data[i] == KISS_FEND) {
+            serial[serialLength++] = KISS_FESC;
+            serial[serialLength++] = KISS_TFEND;
+        } else if (data[i] == KISS_FESC) {
+            serial[serialLength++] = KISS_FESC;
+            serial[serialLength++] = KISS_TFESC;
+        } else
+            serial[serialLength++] = data[i];
+    }
+
+    serial[serialLength++] = KISS_FEND;
+}
+
+/**
+ * Put what the host sent into the FIFO, the way the receive interrupt does.
+ */
+static void Receive(void) {
+    uint16_t i;
+
+    for (i = 0; i < serialLength; ++i)
+        FifoWrite(serial[i]);
+    serialLength = 0;
+}
+
+/**
+ * Run the main loop until the FIFO is read and the radio is back in receive
+ * mode, or a minute goes by.
+ */
+static void Run(void) {
+    do {
+        KissUpdate();
+        RadioUpdate(HostSysTick());
+        HostStep();
+    } while ((FifoHasData() || RadioIsBusy()) && HostSysTick() < 20 * 60);
+}
+
+/**
+ * Check what went on the air since Reset() decodes to the frames expected.
+ *
+ * @param name what's being sent, for the messages
+ * @param frames frames, each without its CRC
+ * @param lengths their lengths
+ * @param count number of frames
+ */
+static void Check(const char *name, uint8_t frames[][MODEM_MAX_FRAME], const uint16_t *lengths, uint8_t count) {
+    uint8_t i;
+
+    HostCheck(!RadioIsBusy() && !TncIsSending(), "%s: radio keyed down", name);
+    HostCheck(!FifoHasData(), "%s: FIFO read", name);
+
+    ModemAfskDecode();
+    HostCheck(modemFrameCount == count, "%s: %u of %u frames decoded", name, modemFrameCount, count);
+    for (i = 0; i < count && i < modemFrameCount; ++i)
+        HostCheck(modemFrames[i].length == lengths[i] && memcmp(modemFrames[i].data, frames[i], lengths[i]) == 0,
+                "%s: frame %u doesn't match", name, i);
+}
+
+/**
+ * Send a parameter and check what it set, and that nothing was keyed.
+ *
+ * @param command command byte
+ * @param value parameter
+ * @param field the configuration it sets
+ * @param expected what it should be set to
+ */
+static void Parameter(uint8_t command, uint8_t value, uint8_t *field, uint8_t expected) {
+    Reset();
+    Kiss(command, &value, 1, FALSE);
+    Receive();
+    Run();
+
+    HostCheck(*field == expected, "command %02x, %u: set to %u, expected %u", command, value, *field, expected);
+    HostCheck(hostDacCount == 0, "command %02x, %u: radio keyed", command, value);
+}
+
+int main(void) {
+    static uint8_t frames[3][MODEM_MAX_FRAME];
+    static uint8_t bytes[90];
+    uint16_t lengths[3], i;
+    uint8_t value;
+
+    // One frame by itself
+    Reset();
+    lengths[0] = ModemFrame(frames[0], "APRS  ", info, sizeof(info) - 1);
+    Kiss(KISS_DATA, frames[0], lengths[0], FALSE);
+    Receive();
+    Run();
+    Check("one frame", frames, lengths, 1);
+
+    // Two frames holding every byte value from 120 up, and on round to 43, so the
+    // FENDs and FESCs in them go through as TFENDs and TFESCs
+    Reset();
+    for (i = 0; i < 2; ++i) {
+        for (value = 0; value < sizeof(bytes); ++value)
+            bytes[value] = (uint8_t) (120 + i * sizeof(bytes) + value);
+        lengths[i] = ModemFrame(frames[i], "APRS  ", bytes, sizeof(bytes));
+        Kiss(KISS_DATA, frames[i], lengths[i], FALSE);
+    }
+    HostCheck(memchr(serial, KISS_TFEND, serialLength) != NULL && memchr(serial, KISS_TFESC, serialLength) != NULL,
+            "escaped frames have a TFEND and a TFESC");
+    Receive();
+    Run();
+    Check("escaped", frames, lengths, 2);
+
+    // Back to back, the closing FEND of each opening the next, and a port number on the last
+    Reset();
+    for (i = 0; i < 3; ++i) {
+        info[0] = '1' + i;
+        lengths[i] = ModemFrame(frames[i], "APRS  ", info, sizeof(info) - 1);
+        Kiss(i == 2 ? 0x10 | KISS_DATA : KISS_DATA, frames[i], lengths[i], i != 0);
+    }
+    Receive();
+    Run();
+    Check("shared FEND", frames, lengths, 3);
+
+    // Parameters, in 10 mS units, with their floors and ceilings
+    Parameter(KISS_TX_DELAY, 30, &config.txDelay, 45);
+    Parameter(KISS_TX_DELAY, 0, &config.txDelay, 1);
+    Parameter(KISS_TX_DELAY, 200, &config.txDelay, 255);
+    Parameter(0x10 | KISS_TX_DELAY, 10, &config.txDelay, 15);
+    Parameter(KISS_PERSISTENCE, 63, &config.persistence, 63);
+    Parameter(KISS_SLOT_TIME, 10, &config.slotTime, 2);
+    Parameter(KISS_SLOT_TIME, 12, &config.slotTime, 3);
+    Parameter(KISS_SLOT_TIME, 0, &config.slotTime, 1);
+
+    // A parameter sharing its FEND with the frame after it, which goes out with it
+    Reset();
+    value = 20;
+    Kiss(KISS_TX_DELAY, &value, 1, FALSE);
+    Kiss(KISS_DATA, frames[0], lengths[0], TRUE);
+    Receive();
+    Run();
+    HostCheck(config.txDelay == 30, "TXDELAY before a frame set to %u, expected 30", config.txDelay);
+    Check("after TXDELAY", frames, lengths, 1);
+
+    // Too short to hold the addresses and control field:  empty and 14 bytes stay
+    // off the air, 15 go out
+    Reset();
+    Kiss(KISS_DATA, frames[0], 0, FALSE);
+    Kiss(KISS_DATA, frames[0], 14, FALSE);
+    Receive();
+    Run();
+    HostCheck(hostDacCount == 0, "short data frames keyed the radio");
+    lengths[0] = 15;
+    Kiss(KISS_DATA, frames[0], 15, FALSE);
+    Receive();
+    Run();
+    Check("15 bytes", frames, lengths, 1);
+
+    // Leaving KISS mode isn't possible, so it's skipped over like any other frame
+    Reset();
+    Kiss(KISS_RETURN, NULL, 0, FALSE);
+    lengths[0] = ModemFrame(frames[0], "APRS  ", info, sizeof(info) - 1);
+    Kiss(KISS_DATA, frames[0], lengths[0], FALSE);
+    Receive();
+    Run();
+    Check("after return", frames, lengths, 1);
+
+    // A frame waiting in the FIFO, then one that's mostly FENDs and doesn't fit
+    // after it.  The end of the second is lost, so both are dropped, and the next
+    // frame the host sends is the first to go out.
+    Reset();
+    memset(bytes, KISS_FEND, sizeof(bytes));
+    lengths[1] = ModemFrame(frames[1], "APRS  ", bytes, sizeof(bytes));
+    Kiss(KISS_DATA, frames[0], lengths[0], FALSE);
+    Kiss(KISS_DATA, frames[1], lengths[1], FALSE);
+    HostCheck(serialLength > 256, "overrun sends %u bytes, the FIFO holds 255", serialLength);
+    Receive();
+    Run();
+    HostCheck(hostDacCount == 0, "frames cut by the overrun went out");
+    info[0] = 'B';
+    lengths[0] = ModemFrame(frames[0], "APRS  ", info, sizeof(info) - 1);
+    Kiss(KISS_DATA, frames[0], lengths[0], FALSE);
+    Receive();
+    Run();
+    Check("after overrun", frames, lengths, 1);
+
+    return HostReport("kiss");
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "gps.h"
+#include "mic-e.h"
+#include "host.h"
+
+/*
+ * The Mic-E encoder, byte for byte against the original one that divided
+ * everything out of degrees * 10^7.  Each position goes through both of the
+ * encoder's paths, once with the digits the GPS sent and once with them zeroed
+ * so it falls back on the degrees, over a grid of positions in all four
+ * hemispheres, and the speed, course and altitude over their whole ranges.
+ * Last, the three are timed.
+ */
+
+/// What the original encoder made
+static char refDestAddress[7], refInformation[14];
+
+/// Failures before the rest are only counted
+static uint32_t failures;
+
+/**
+ * The original encoder, for reference.
+ */
+static void RefMicEEncode(GPSData *gps) {
+    int32_t value;
+
+    value = labs(gps->latitude) / 10000000;
+    refDestAddress[0] = 'P' + (value / 10);
+    refDestAddress[1] = 'P' + (value % 10);
+
+    value = 6 * (labs(gps->latitude) % 10000000);
+    refDestAddress[2] = '0' + (value / 10000000) % 10;
+    refDestAddress[3] = '0' + (value / 1000000) % 10;
+    refDestAddress[4] = '0' + (value / 100000) % 10;
+    refDestAddress[5] = '0' + (value / 10000) % 10;
+
+    if (gps->latitude > 0)
+        refDestAddress[3] += 'P' - '0';
+    if (gps->longitude < 0)
+        refDestAddress[5] += 'P' - '0';
+    refDestAddress[6] = 0;
+
+    refInformation[0] = '`';
+
+    value = labs(gps->longitude) / 10000000;
+    if (value <= 9 || value >= 100)
+        refDestAddress[4] += 'P' - '0';
+    if (value <= 9)
+        refInformation[1] = value + 118;
+    else if (value <= 99)
+        refInformation[1] = value + 28;
+    else if (value <= 109)
+        refInformation[1] = value + 8;
+    else
+        refInformation[1] = value - 72;
+
+    value = (6 * (labs(gps->longitude) % 10000000)) / 1000000;
+    if (value <= 9)
+        refInformation[2] = value + 88;
+    else
+        refInformation[2] = value + 28;
+
+    value = ((6 * (labs(gps->longitude) % 10000000)) / 10000) % 100;
+    refInformation[3] = value + 28;
+
+    value = gps->speed / 10;
+    refInformation[4] = 28 + (value / 10);
+    refInformation[5] = 28 + ((value % 10) * 10);
+    refInformation[5] += (gps->heading / 10000);
+    refInformation[6] = 28 + (gps->heading / 100) % 100;
+
+    refInformation[7] = 'O';
+    refInformation[8] = '/';
+
+    value = (gps->altitude / 100) + 10000;
+    refInformation[9] = 33 + (value / 8281);
+    refInformation[10] = 33 + ((value / 91) % 91);
+    refInformation[11] = 33 + (value % 91);
+    refInformation[12] = '}';
+    refInformation[13] = 0;
+}
+
+/**
+ * Compare the encoder with the reference.  Only the first few failures are
+ * reported one by one.
+ *
+ * @return true if they match
+ */
+static bool_t Compare(GPSData *gps, const char *path) {
+    bool_t ok;
+
+    MicEEncode(gps);
+    RefMicEEncode(gps);
+    ok = memcmp(MicEGetDestAddress(), refDestAddress, sizeof(refDestAddress)) == 0 &&
+            memcmp(MicEGetInfoField(), refInformation, sizeof(refInformation)) == 0;
+
+    if (!ok && ++failures <= 10)
+        HostCheck(FALSE, "%s: %ld %ld %u %u %ld is %s %s, not %s %s", path, (long) gps->latitude, (long) gps->longitude,
+                gps->speed, gps->heading, (long) gps->altitude, MicEGetDestAddress(), MicEGetInfoField(), refDestAddress,
+                refInformation);
+
+    return ok;
+}
+
+/**
+ * Write n digits of a number.
+ */
+static void Digits(char *out, uint32_t value, uint8_t n) {
+    while (n-- > 0) {
+        out[n] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+/**
+ * Check a position through both paths.  The degrees are the ones the parser would
+ * make from the same digits, rounded up so they truncate back to the hundredths.
+ *
+ * @param latitude degrees * 6000 + hundredths of minutes
+ * @param longitude degrees * 6000 + hundredths of minutes
+ *
+ * @return the number of paths that matched
+ */
+static uint8_t Position(GPSData *gps, uint32_t latitude, uint32_t longitude, bool_t north, bool_t east) {
+    uint8_t matched;
+
+    gps->latitude = (latitude / 6000) * 10000000 + ((latitude % 6000) * 5000 + 2) / 3;
+    gps->longitude = (longitude / 6000) * 10000000 + ((longitude % 6000) * 5000 + 2) / 3;
+    if (!north)
+        gps->latitude = -gps->latitude;
+    if (!east)
+        gps->longitude = -gps->longitude;
+
+    Digits(gps->latitudeDigits, (latitude / 6000) * 10000 + latitude % 6000, 6);
+    Digits(gps->longitudeDigits, (longitude / 6000) * 10000 + longitude % 6000, 7);
+    matched = Compare(gps, "digits");
+
+    gps->latitudeDigits[0] = 0;
+    return matched + Compare(gps, "degrees");
+}
+
+/**
+ * Time the encoder's two paths and the original on this machine.  A PC divides
+ * in a few cycles where the PIC18 calls a library routine, so these are host
+ * figures, not PIC18 cycle counts.
+ */
+static void Benchmark(void) {
+    static GPSData fixes[1000];
+    uint32_t latitude, longitude, i, n;
+    clock_t start;
+    double digits, degrees, original;
+
+    for (i = 0; i < 1000; ++i) {
+        latitude = (i * 7919) % (90 * 6000);
+        longitude = (i * 104729) % (180 * 6000);
+        Position(&fixes[i], latitude, longitude, i & 0x01, i & 0x02);
+        fixes[i].speed = i * 7 % 8000;
+        fixes[i].heading = i * 97 % 36000;
+        fixes[i].altitude = i * 3001;
+    }
+
+    start = clock();
+    for (n = 0; n < 500; ++n)
+        for (i = 0; i < 1000; ++i)
+            MicEEncode(&fixes[i]);
+    degrees = (double) (clock() - start) / CLOCKS_PER_SEC / 500000;
+
+    start = clock();
+    for (n = 0; n < 500; ++n)
+        for (i = 0; i < 1000; ++i)
+            RefMicEEncode(&fixes[i]);
+    original = (double) (clock() - start) / CLOCKS_PER_SEC / 500000;
+
+    // Position() leaves the digits off, so put them back
+    for (i = 0; i < 1000; ++i) {
+        latitude = (i * 7919) % (90 * 6000);
+        longitude = (i * 104729) % (180 * 6000);
+        Digits(fixes[i].latitudeDigits, (latitude / 6000) * 10000 + latitude % 6000, 6);
+        Digits(fixes[i].longitudeDigits, (longitude / 6000) * 10000 + longitude % 6000, 7);
+    }
+    start = clock();
+    for (n = 0; n < 500; ++n)
+        for (i = 0; i < 1000; ++i)
+            MicEEncode(&fixes[i]);
+    digits = (double) (clock() - start) / CLOCKS_PER_SEC / 500000;
+
+    printf("mic-e: %.0f ns a fix from the digits, %.0f ns from degrees, %.0f ns the original way\n", digits * 1e9,
+            degrees * 1e9, original * 1e9);
+}
+
+int main(void) {
+    GPSData gps;
+    uint32_t latitude, longitude, count, matched;
+    int32_t altitude;
+    uint8_t hemisphere;
+
+    memset(&gps, 0, sizeof(gps));
+    gps.heading = 12300;
+    gps.speed = 456;
+    gps.altitude = 123456;
+
+    // Every degree and minute of longitude, with latitude stepping along too
+    count = matched = 0;
+    for (longitude = 0; longitude < 180 * 6000; ++longitude) {
+        latitude = (longitude * 7919) % (90 * 6000);
+        hemisphere = longitude & 0x03;
+        matched += Position(&gps, latitude, longitude, hemisphere & 0x01, hemisphere & 0x02);
+        count += 2;
+    }
+
+    // Every degree of latitude with a spread of minutes, and the poles
+    for (latitude = 0; latitude <= 90 * 6000; latitude += (latitude >= 90 * 6000 - 13 ? 1 : 13))
+        for (hemisphere = 0; hemisphere < 4; ++hemisphere) {
+            longitude = (latitude * 104729 + hemisphere * 45 * 6000) % (180 * 6000);
+            matched += Position(&gps, latitude, longitude, hemisphere & 0x01, hemisphere & 0x02);
+            count += 2;
+        }
+    HostCheck(matched == count, "positions: %lu of %lu match", (unsigned long) matched, (unsigned long) count);
+
+    // Speed and course over their whole ranges
+    count = matched = 0;
+    Position(&gps, 33 * 6000 + 1234, 111 * 6000 + 4321, TRUE, FALSE);
+    for (gps.speed = 0; gps.speed < 8000; gps.speed += 3)
+        for (gps.heading = 0; gps.heading < 36000; gps.heading += 97) {
+            matched += Compare(&gps, "speed and course");
+            ++count;
+        }
+    gps.speed = 7999;
+    for (gps.heading = 0; gps.heading < 36000; ++gps.heading) {
+        matched += Compare(&gps, "course");
+        ++count;
+    }
+    HostCheck(matched == count, "speeds and courses: %lu of %lu match", (unsigned long) matched, (unsigned long) count);
+
+    // Altitude from 10 km below the datum to the top of 3 base-91 digits
+    count = matched = 0;
+    gps.speed = 0;
+    gps.heading = 0;
+    for (altitude = -999999; altitude < (91L * 91 * 91 - 10000) * 100; altitude += 7 + labs(altitude) / 1000) {
+        gps.altitude = altitude;
+        matched += Compare(&gps, "altitude");
+        ++count;
+    }
+    HostCheck(matched == count, "altitudes: %lu of %lu match", (unsigned long) matched, (unsigned long) count);
+
+    Benchmark();
+
+    return HostReport("mic-e");
+}
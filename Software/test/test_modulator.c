@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+#include <htc.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * The interrupt driven AFSK modulator.  It has to put out exactly what the old
+ * busy wait loop in TncSendPacket() did, step for step:  the loop set PR2 for the
+ * next tone once timeElapsed, the sum of the PR2 of each sin step, reached BAUD.
+ * It's replayed here against tones NRZI encoded from the reference frame, so any
+ * change in a bit, a tone, or a step shows up as a PR2 that doesn't match.
+ */
+
+/// DAC levels of the 16 step sin table, as the resistor ladder puts them out
+static const uint8_t sinLevels[16] = {8, 10, 13, 14, 15, 14, 13, 10, 8, 5, 2, 1, 0, 1, 2, 5};
+
+int main(void) {
+    static uint8_t bits[8 * (TNC_MAX_TX + 128)];
+    uint8_t frame[MODEM_MAX_FRAME], tone, pr2;
+    uint16_t length, timeElapsed;
+    uint32_t count, n, i, last;
+    bool_t interruptsOn, match;
+
+    HostReset();
+    TncConfigDefault();
+    INTCON = 0xc0;
+
+    length = ModemFrame(frame, "APRS  ", (uint8_t *) ">modulator test", 15);
+    HostCheck(TncPreparePacket((uint8_t *) ">modulator test", config.destCallSign), "packet queued");
+
+    // Starting to send only turns on the interrupt
+    TncSendPacket();
+    HostCheck(TncIsSending() && TMR2IE && hostDacCount == 0, "TncSendPacket() returns before the packet is sent");
+
+    interruptsOn = TRUE;
+    while (TncIsSending()) {
+        HostStep();
+        if (INTCON != 0xc0 || !GIEH)
+            interruptsOn = FALSE;
+    }
+    HostCheck(interruptsOn, "interrupts stay on while sending");
+    HostCheck(HostSysTick() > 0, "system ticks go by while sending");
+
+    // The tones the old loop sent:  txDelay flags, the frame, and two closing flags,
+    // NRZI encoded starting from a space
+    count = 0;
+    for (i = 0; i < config.txDelay; ++i)
+        count += ModemFlag(bits + count);
+    count += ModemHdlcBits(bits + count, frame, length);
+    count += ModemFlag(bits + count);
+    count += ModemFlag(bits + count);
+
+    tone = 0;
+    ModemNrzi(bits, count, &tone);
+
+    // Replay its timing from power on
+    timeElapsed = 0;
+    pr2 = 255;
+    n = 0;
+    last = 0;
+    match = TRUE;
+    for (i = 0; i < hostDacCount; ++i) {
+        if (timeElapsed >= BAUD && n < count) {
+            timeElapsed -= BAUD;
+            pr2 = (bits[n++] ? MARK : SPACE);
+            last = i;
+        }
+
+        if (match && (hostDac[i].pr2 != pr2 || hostDac[i].level != sinLevels[i % 16])) {
+            HostCheck(FALSE, "step %u is PR2 %u level %u, the old loop sent PR2 %u level %u", i,
+                    hostDac[i].pr2, hostDac[i].level, pr2, sinLevels[i % 16]);
+            match = FALSE;
+        }
+
+        timeElapsed += pr2;
+    }
+    HostCheck(match, "every step matches the old loop");
+    HostCheck(n == count, "all %u tones sent, got %u", count, n);
+    HostCheck(hostDacCount == last + 1, "stops one step into the last tone like the old loop, %u steps for %u", hostDacCount, last + 1);
+
+    // And a receiver gets the packet
+    HostCheck(ModemAfskDecode() == 1, "one frame decoded, got %u", modemFrameCount);
+    HostCheck(modemFrameCount == 1 && modemFrames[0].length == length && memcmp(modemFrames[0].data, frame, length) == 0,
+            "decoded frame matches");
+
+    return HostReport("modulator");
+}
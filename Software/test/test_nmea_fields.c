@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "gps.h"
+#include "host.h"
+#include "nmea.h"
+
+/*
+ * The NMEA field splitting, against the reference parser that stores each
+ * sentence and counts commas from the start for every field.  A corpus of
+ * GGA, RMC, and skipped sentences from a range of talkers, with empty fields,
+ * missing trailing fields, extra ones, and no checksum, goes through both, and
+ * the GPS data has to match after every sentence.  A field too long for the
+ * reference's copy has to come through whole.  Then the time each takes
+ * over the corpus is printed.
+ */
+
+/// Sentences in the corpus
+#define CORPUS_SENTENCES 30000
+
+static const char *talkers[] = {"GP", "GN", "GL", "GA"};
+
+/**
+ * A random number from 0 to n - 1.
+ */
+static uint32_t Random(uint32_t n) {
+    return NmeaRandom() % n;
+}
+
+/**
+ * A position field, DDMM.mmmm or DDDMM.mmmm with 4 or 5 decimal places, or empty.
+ */
+static void Position(char *field, uint8_t degrees) {
+    uint32_t minutes;
+
+    if (Random(30) == 0) {
+        field[0] = 0;
+        return;
+    }
+
+    minutes = Random(6000000);
+    if (Random(2) == 0)
+        sprintf(field, "%0*u%02u.%04u", degrees, Random(degrees == 2 ? 90 : 180), minutes / 100000, minutes % 100000 / 10);
+    else
+        sprintf(field, "%0*u%02u.%05u", degrees, Random(degrees == 2 ? 90 : 180), minutes / 100000, minutes % 100000);
+}
+
+/**
+ * A decimal number field with the given decimal places, or sometimes empty.
+ */
+static void Number(char *field, uint32_t limit, uint8_t decimals, bool_t negative) {
+    uint32_t value, scale;
+    uint8_t i;
+
+    if (Random(20) == 0) {
+        field[0] = 0;
+        return;
+    }
+
+    for (scale = 1, i = 0; i < decimals; ++i)
+        scale *= 10;
+    value = Random(limit * scale);
+
+    field += sprintf(field, "%s%u", negative && Random(4) == 0 ? "-" : "", value / scale);
+    if (decimals != 0)
+        sprintf(field, ".%0*u", decimals, value % scale);
+}
+
+/**
+ * Build the next sentence of the corpus.
+ *
+ * @return its length
+ */
+static uint16_t Next(char *sentence) {
+    char body[NMEA_MAX_SENTENCE], latitude[16], longitude[16], a[16], b[16];
+    const char *talker;
+    uint16_t length;
+
+    talker = talkers[Random(4)];
+    Position(latitude, 2);
+    Position(longitude, 3);
+
+    switch (Random(4)) {
+        case 0:
+            Number(a, 30, 1, FALSE);
+            Number(b, 40000, 1 + Random(3), TRUE);
+            sprintf(body, "%sGGA,%02u%02u%02u.00,%s,%c,%s,%c,1,%02u,%s,%s,M,-20.1,M,,", talker, Random(24), Random(60),
+                    Random(60), latitude, "NS"[Random(2)], longitude, "EW"[Random(2)], Random(13), a, b);
+
+            // Receivers that stop after the altitude, or add fields of their own
+            if (Random(10) == 0)
+                *strstr(body, ",M,-20.1") = 0;
+            else if (Random(10) == 0)
+                strcat(body, ",1234,extra");
+            break;
+
+        case 1:
+            Number(a, 400, 1 + Random(2), FALSE);
+            Number(b, 360, Random(3), FALSE);
+            sprintf(body, "%sRMC,%02u%02u%02u.00,%c,%s,%c,%s,%c,%s,%s,%02u%02u%02u,,,A", talker, Random(24), Random(60),
+                    Random(60), "AAAV"[Random(4)], latitude, "NS"[Random(2)], longitude, "EW"[Random(2)], a, b,
+                    1 + Random(28), 1 + Random(12), Random(100));
+            if (Random(10) == 0)
+                *strstr(body, ",,,A") = 0;
+            break;
+
+        case 2:
+            sprintf(body, "%sGSV,3,1,12,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45", talker);
+            break;
+
+        default:
+            sprintf(body, "%sGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1", talker);
+            break;
+    }
+
+    length = NmeaSentence(sentence, body);
+
+    // Now and then no checksum, which ends at the CR
+    if (Random(50) == 0) {
+        strcpy(strchr(sentence, '*'), "\r\n");
+        length = strlen(sentence);
+    }
+
+    return length;
+}
+
+int main(void) {
+    static char corpus[CORPUS_SENTENCES * NMEA_MAX_SENTENCE];
+    static uint32_t offsets[CORPUS_SENTENCES + 1];
+    char sentence[NMEA_MAX_SENTENCE];
+    GPSData ref;
+    const char *difference;
+    uint32_t i, length, matched, ready;
+    clock_t start;
+    double gpsTime, refTime;
+    bool_t refReady;
+
+    // Build the corpus
+    length = 0;
+    for (i = 0; i < CORPUS_SENTENCES; ++i) {
+        offsets[i] = length;
+        length += Next(corpus + length);
+    }
+    offsets[i] = length;
+
+    // Sentence by sentence, in chunks of every size the UART might have queued
+    memset(&ref, 0, sizeof(ref));
+    matched = ready = 0;
+    for (i = 0; i < CORPUS_SENTENCES; ++i) {
+        NmeaFeed(corpus + offsets[i], offsets[i + 1] - offsets[i], 1 + Random(200));
+        refReady = NmeaRefDecode(&ref, corpus + offsets[i], NMEA_EXACT);
+
+        difference = NmeaDifference(GpsGetData(), &ref);
+        if (difference == NULL)
+            ++matched;
+        else if (i - matched < 10)
+            HostCheck(FALSE, "sentence %lu: %s differs in %.*s", (unsigned long) i, difference,
+                    (int) (offsets[i + 1] - offsets[i] - 2), corpus + offsets[i]);
+        ready += (GpsIsDataReady() == refReady);
+    }
+    HostCheck(matched == CORPUS_SENTENCES, "%lu of %u sentences match the reference", (unsigned long) matched, CORPUS_SENTENCES);
+    HostCheck(ready == CORPUS_SENTENCES, "data ready after %lu of %u sentences", (unsigned long) ready, CORPUS_SENTENCES);
+
+    // A field longer than the original's 25 character copy isn't cropped
+    NmeaFeed(sentence, NmeaSentence(sentence, "GPGGA,120000.00,,,,,1,05,1.0,000000000000000000012345.67,M,,M,,"), 200);
+    HostCheck(GpsGetData()->altitude == 1234567, "long altitude field is %ld", (long) GpsGetData()->altitude);
+
+    // Time the whole corpus both ways, with the floats the original used
+    start = clock();
+    for (i = 0; i < 20; ++i)
+        NmeaFeed(corpus, length, 200);
+    gpsTime = (double) (clock() - start) / CLOCKS_PER_SEC / 20;
+
+    start = clock();
+    for (i = 0; i < 20 * CORPUS_SENTENCES; ++i)
+        NmeaRefDecode(&ref, corpus + offsets[i % CORPUS_SENTENCES], NMEA_FLOAT);
+    refTime = (double) (clock() - start) / CLOCKS_PER_SEC / 20;
+
+    printf("nmea fields: %.0f ns a sentence, %.0f ns storing it and counting commas\n", gpsTime * 1e9 / CORPUS_SENTENCES,
+            refTime * 1e9 / CORPUS_SENTENCES);
+
+    return HostReport("nmea fields");
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "gps.h"
+#include "host.h"
+#include "nmea.h"
+
+/*
+ * The fixed point number decoding, against exact decimal arithmetic and the
+ * atof() and round() it replaced.  Positions over a grid of every degree of
+ * latitude and longitude, with 4 and 5 decimal places of minutes, have to
+ * come out exactly, and ones with more places within a unit of 10^-7 degrees.
+ * Altitude, HDOP, speed, and course over their ranges, with more and fewer
+ * decimal places than they're kept to, have to come out exactly too.  How
+ * often the float library's answer was off is printed, and how long the
+ * numbers take each way.
+ */
+
+/// Sentences kept for the timing, spread over all of them
+#define TIMED_SENTENCES 4000
+
+/// What's been compared, what matched exactly, and what the floats got wrong
+typedef struct {
+    const char *name;
+    uint32_t count, exact, close, floatWrong;
+    bool_t reported;
+} TALLY;
+
+/// The sentences kept for the timing
+static char timed[TIMED_SENTENCES][NMEA_MAX_SENTENCE];
+static uint32_t timedCount, decoded;
+
+/**
+ * Feed a sentence to the parser and both references.
+ */
+static void Decode(const char *body, GPSData *exact, GPSData *floats) {
+    char sentence[NMEA_MAX_SENTENCE];
+    uint16_t length;
+
+    length = NmeaSentence(sentence, body);
+    if (timedCount < TIMED_SENTENCES && decoded++ % 122 == 0)
+        strcpy(timed[timedCount++], sentence);
+    NmeaFeed(sentence, length, 200);
+    NmeaRefDecode(exact, sentence, NMEA_EXACT);
+    NmeaRefDecode(floats, sentence, NMEA_FLOAT);
+}
+
+/**
+ * Count a decoded number against the exact and float references.
+ */
+static void Tally(TALLY *tally, int32_t value, int32_t exact, int32_t floats, const char *body) {
+    ++tally->count;
+    if (value == exact)
+        ++tally->exact;
+    else if (value - exact <= 1 && exact - value <= 1)
+        ++tally->close;
+    if (floats != exact)
+        ++tally->floatWrong;
+
+    // The first one off by more than a unit is shown
+    if ((value - exact > 1 || exact - value > 1) && !tally->reported) {
+        tally->reported = TRUE;
+        HostCheck(FALSE, "%s is %ld, not %ld, from %s", tally->name, (long) value, (long) exact, body);
+    }
+}
+
+/**
+ * Print a tally.
+ */
+static void Report(const TALLY *tally) {
+    printf("  %-20s %8lu %8lu %8lu %8lu\n", tally->name, (unsigned long) tally->count, (unsigned long) tally->exact,
+            (unsigned long) tally->close, (unsigned long) tally->floatWrong);
+}
+
+/**
+ * Time the kept sentences through the parser, and through the reference with
+ * exact and with float numbers.  The reference splits the fields the same way
+ * both times, so the difference between those two is what the float library
+ * costs.  These are host figures, not PIC18 cycle counts.
+ */
+static void Benchmark(void) {
+    GPSData ref;
+    uint32_t i, n;
+    clock_t start;
+    double gpsTime, exactTime, floatTime;
+
+    start = clock();
+    for (n = 0; n < 20; ++n)
+        for (i = 0; i < timedCount; ++i)
+            NmeaFeed(timed[i], strlen(timed[i]), 200);
+    gpsTime = (double) (clock() - start) / CLOCKS_PER_SEC / (20 * timedCount);
+
+    start = clock();
+    for (n = 0; n < 20; ++n)
+        for (i = 0; i < timedCount; ++i)
+            NmeaRefDecode(&ref, timed[i], NMEA_EXACT);
+    exactTime = (double) (clock() - start) / CLOCKS_PER_SEC / (20 * timedCount);
+
+    start = clock();
+    for (n = 0; n < 20; ++n)
+        for (i = 0; i < timedCount; ++i)
+            NmeaRefDecode(&ref, timed[i], NMEA_FLOAT);
+    floatTime = (double) (clock() - start) / CLOCKS_PER_SEC / (20 * timedCount);
+
+    printf("nmea numbers: %.0f ns a sentence, the reference %.0f ns exact and %.0f ns with floats, over %lu sentences\n",
+            gpsTime * 1e9, exactTime * 1e9, floatTime * 1e9, (unsigned long) timedCount);
+}
+
+/**
+ * A decimal number with the given places.
+ */
+static void Decimal(char *text, int32_t value, uint8_t places) {
+    uint32_t scale, magnitude;
+    uint8_t i;
+
+    for (scale = 1, i = 0; i < places; ++i)
+        scale *= 10;
+    magnitude = (value < 0 ? -value : value);
+
+    text += sprintf(text, "%s%lu", value < 0 ? "-" : "", (unsigned long) (magnitude / scale));
+    if (places != 0)
+        sprintf(text, ".%0*lu", places, (unsigned long) (magnitude % scale));
+}
+
+int main(void) {
+    static TALLY positions[] = {{"position, 4 places"}, {"position, 5 places"}, {"position, 6 places"}, {"position, 7 places"}};
+    static TALLY altitude = {"altitude"}, hdop = {"HDOP"}, speed = {"speed"}, course = {"course"};
+    GPSData exact, floats;
+    char body[NMEA_MAX_SENTENCE], a[24], b[24];
+    uint32_t degrees, step, latitude, longitude, scale;
+    uint8_t places, i;
+    int32_t value;
+
+    memset(&exact, 0, sizeof(exact));
+    memset(&floats, 0, sizeof(floats));
+
+    // Every degree of latitude and longitude, with minutes spread over each
+    for (places = 4; places <= 7; ++places) {
+        for (scale = 60, i = 0; i < places; ++i)
+            scale *= 10;
+        for (degrees = 0; degrees < 180; ++degrees)
+            for (step = 0; step < 400; ++step) {
+                latitude = (uint32_t) (((uint64_t) step * 7919 * 104729 + degrees) % scale);
+                longitude = (uint32_t) (((uint64_t) step * 15485863 + degrees * 1299709) % scale);
+                Decimal(a, latitude, places);
+                Decimal(b, longitude, places);
+                snprintf(body, sizeof(body), "GPRMC,120000.00,A,%02u%s%s,%c,%03u%s%s,%c,1.0,2.0,010125,,,A", degrees % 90,
+                        latitude < 10 * scale / 60 ? "0" : "", a, step & 1 ? 'N' : 'S', degrees,
+                        longitude < 10 * scale / 60 ? "0" : "", b, step & 2 ? 'E' : 'W');
+                Decode(body, &exact, &floats);
+
+                Tally(&positions[places - 4], GpsGetData()->latitude, exact.latitude, floats.latitude, body);
+                Tally(&positions[places - 4], GpsGetData()->longitude, exact.longitude, floats.longitude, body);
+            }
+    }
+
+    // Altitude from below sea level to well over a balloon's, HDOP, speed, and course
+    for (places = 0; places <= 4; ++places)
+        for (step = 0; step < 20000; ++step) {
+            for (scale = 1, i = 0; i < places; ++i)
+                scale *= 10;
+
+            value = (int32_t) ((uint64_t) step * 2654435761u % (51000 * scale)) - 1000 * (int32_t) scale;
+            Decimal(a, value, places);
+            Decimal(b, (int32_t) (step * 40503u % (100 * scale)), places);
+            snprintf(body, sizeof(body), "GPGGA,120000.00,,,,,1,08,%s,%s,M,-20.1,M,,", b, a);
+            Decode(body, &exact, &floats);
+            Tally(&altitude, GpsGetData()->altitude, exact.altitude, floats.altitude, body);
+            Tally(&hdop, GpsGetData()->dop, exact.dop, floats.dop, body);
+
+            Decimal(a, (int32_t) ((uint64_t) step * 2246822519u % (1000 * scale)), places);
+            Decimal(b, (int32_t) ((uint64_t) step * 3266489917u % (360 * scale)), places);
+            snprintf(body, sizeof(body), "GPRMC,120000.00,A,,,,,%s,%s,010125,,,A", a, b);
+            Decode(body, &exact, &floats);
+            Tally(&speed, GpsGetData()->speed, exact.speed, floats.speed, body);
+            Tally(&course, GpsGetData()->heading, exact.heading, floats.heading, body);
+        }
+
+    printf("nmea numbers:          decoded    exact   within 1   floats wrong\n");
+    for (i = 0; i < 4; ++i)
+        Report(&positions[i]);
+    Report(&altitude);
+    Report(&hdop);
+    Report(&speed);
+    Report(&course);
+    Benchmark();
+
+    HostCheck(positions[0].exact == positions[0].count && positions[1].exact == positions[1].count,
+            "positions with 4 and 5 places aren't exact");
+    HostCheck(positions[2].exact + positions[2].close == positions[2].count &&
+            positions[3].exact + positions[3].close == positions[3].count, "positions with 6 and 7 places aren't within 1");
+    HostCheck(altitude.exact == altitude.count, "altitudes aren't exact");
+    HostCheck(hdop.exact == hdop.count, "HDOPs aren't exact");
+    HostCheck(speed.exact == speed.count, "speeds aren't exact");
+    HostCheck(course.exact == course.count, "courses aren't exact");
+
+    return HostReport("nmea numbers");
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "gps.h"
+#include "fifo.h"
+#include "host.h"
+#include "nmea.h"
+
+/*
+ * The NMEA decoder a character at a time.  A fix has to decode the same however
+ * the characters are split between GpsUpdate() calls, down to one at a time.
+ * A sentence that fails its checksum, is cut off by the next '$', runs too
+ * long, or has a garbled command mustn't change anything, not even the fields
+ * decoded before the problem showed up.  Noise between sentences is ignored,
+ * and every character goes to the log in order.  When the FIFO overruns, the
+ * start of one sentence and the end of another mustn't decode as one.
+ */
+
+static const char *gga = "GPGGA,191647.00,3216.0918,N,12416.8259,W,1,09,5.4,31015.9,M,-20.1,M,,";
+static const char *rmc = "GPRMC,191647.00,A,3216.0918,N,12416.8259,W,45.28,168.86,011227,,,A";
+
+/// A fix that's different in every field, for the sentences that are rejected
+static const char *other = "GPRMC,235959.00,V,1111.1111,S,02222.2222,E,1.00,2.00,311299,,,A";
+
+/// Two valid fixes, the second with the speed and course swapped, which leaves the checksum alone
+static const char *cut = "GPRMC,235959.00,A,1111.1111,S,02222.2222,E,1.00,2.00,311299,,,A";
+static const char *swapped = "GPRMC,235959.00,A,1111.1111,S,02222.2222,E,2.00,1.00,311299,,,A";
+
+/// Everything fed to the parser, to check the log against
+static char fed[200000];
+static uint32_t fedLength;
+
+/**
+ * Feed characters to the parser, keeping a copy.
+ */
+static void Feed(const char *text, uint32_t length, uint16_t chunk) {
+    memcpy(fed + fedLength, text, length);
+    fedLength += length;
+    NmeaFeed(text, length, chunk);
+}
+
+/**
+ * Feed a sentence that shouldn't be used, after a good fix, and check that
+ * nothing changed.
+ */
+static void Rejected(const char *name, const char *text, uint32_t length) {
+    char sentence[NMEA_MAX_SENTENCE];
+    GPSData before;
+
+    Feed(sentence, NmeaSentence(sentence, "GPGGA,000000.00,,,,,1,04,2.0,100.0,M,,M,,"), 200);
+    GpsIsDataReady();
+    before = *GpsGetData();
+
+    Feed(text, length, 1);
+    HostCheck(memcmp(&before, GpsGetData(), sizeof(before)) == 0, "%s changed the GPS data", name);
+    HostCheck(!GpsIsDataReady(), "%s set the data ready", name);
+
+    // And the next good sentence still decodes
+    Feed(sentence, NmeaSentence(sentence, gga), 200);
+    HostCheck(GpsIsDataReady() && GpsGetData()->altitude == 3101590, "sentence after %s didn't decode", name);
+}
+
+int main(void) {
+    char pair[2 * NMEA_MAX_SENTENCE], sentence[2 * NMEA_MAX_SENTENCE], body[2 * NMEA_MAX_SENTENCE];
+    GPSData whole, before;
+    uint32_t length, split, matched, i;
+    uint16_t chunk;
+
+    // The fix in one go, as a reference
+    length = NmeaSentence(pair, gga);
+    length += NmeaSentence(pair + length, rmc);
+    Feed(pair, length, 200);
+    HostCheck(GpsIsDataReady(), "fix isn't ready");
+    whole = *GpsGetData();
+    HostCheck(whole.altitude == 3101590 && whole.latitude == 322681967 && whole.longitude == -1242804317 &&
+            whole.speed == 453 && whole.heading == 16886 && whole.trackedSats == 9 && whole.fixType == Fix3D,
+            "fix decoded as %ld cm, %ld, %ld, %u, %u, %u satellites", (long) whole.altitude, (long) whole.latitude,
+            (long) whole.longitude, whole.speed, whole.heading, whole.trackedSats);
+
+    // Split between two calls at every character, and in every chunk size
+    matched = 0;
+    for (split = 1; split < length; ++split) {
+        memset(GpsGetData(), 0, sizeof(GPSData));
+        Feed(pair, split, 200);
+        Feed(pair + split, length - split, 200);
+        matched += (memcmp(&whole, GpsGetData(), sizeof(whole)) == 0 && GpsIsDataReady());
+    }
+    for (chunk = 1; chunk <= 200; ++chunk) {
+        memset(GpsGetData(), 0, sizeof(GPSData));
+        Feed(pair, length, chunk);
+        matched += (memcmp(&whole, GpsGetData(), sizeof(whole)) == 0 && GpsIsDataReady());
+    }
+    HostCheck(matched == length - 1 + 200, "%lu of %lu splits decode the same", (unsigned long) matched,
+            (unsigned long) (length - 1 + 200));
+
+    // A wrong checksum, and a character changed along the way
+    length = NmeaSentence(sentence, other);
+    sentence[length - 3] ^= 0x01;
+    Rejected("a wrong checksum", sentence, length);
+
+    length = NmeaSentence(sentence, other);
+    sentence[40] ^= 0x02;
+    Rejected("a garbled character", sentence, length);
+
+    // Cut off by the next sentence's '$'
+    length = NmeaSentence(sentence, other);
+    Rejected("a sentence cut off", sentence, 50);
+
+    // Longer than a sentence can be
+    strcpy(body, other);
+    for (i = 0; i < 10; ++i)
+        strcat(body, ",123456789");
+    Rejected("an overlong sentence", sentence, NmeaSentence(sentence, body));
+
+    // A command too long to be one
+    strcpy(body, "GPRMCXYZW");
+    strcat(body, other + 5);
+    Rejected("a garbled command", sentence, NmeaSentence(sentence, body));
+
+    // Noise between sentences, without the '$' or the UBX sync character
+    length = 0;
+    for (i = 0; i < 1000; ++i) {
+        do
+            pair[length] = (char) NmeaRandom();
+        while ((uint8_t) pair[length] == '$' || (uint8_t) pair[length] == 0xb5);
+        ++length;
+        if (length == 100) {
+            Rejected("noise", pair, length);
+            length = 0;
+        }
+    }
+
+    // Every character went to the log in order, in whole chunks
+    HostCheck(nmeaLogLength <= fedLength && fedLength - nmeaLogLength < 16 && memcmp(nmeaLog, fed, nmeaLogLength) == 0,
+            "log has %lu of the %lu characters fed, not in order", (unsigned long) nmeaLogLength, (unsigned long) fedLength);
+
+    // The FIFO fills up partway into a sentence and drops the rest of it and the
+    // start of the next, whose end then arrives.  Spliced together they'd make a
+    // good sentence that was never sent.
+    Feed(sentence, NmeaSentence(sentence, gga), 200);
+    GpsIsDataReady();
+    before = *GpsGetData();
+    length = NmeaSentence(sentence, cut);
+    NmeaSentence(body, swapped);
+    split = strstr(sentence, "1.00") - sentence;
+    for (i = 0; i < 255 - split; ++i)
+        FifoWrite('x');
+    for (i = 0; i < length; ++i)
+        FifoWrite(sentence[i]);
+    for (i = 0; i < split; ++i)
+        FifoWrite(body[i]);
+    GpsUpdate();
+    NmeaFeed(body + split, length - split, 200);
+    HostCheck(memcmp(&before, GpsGetData(), sizeof(before)) == 0 && !GpsIsDataReady(), "sentences spliced by an overrun decoded");
+
+    Feed(sentence, NmeaSentence(sentence, gga), 200);
+    HostCheck(GpsIsDataReady() && GpsGetData()->altitude == 3101590, "sentence after an overrun didn't decode");
+
+    return HostReport("nmea stream");
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * Information fields streamed from a source while the packet goes out.  A full
+ * TNC_MAX_INFO byte field takes more tones than the whole queue holds, so it only
+ * gets through if RadioUpdate() keeps encoding it behind the interrupt.  The
+ * source has to be read exactly once a byte, in order, and a field that's too
+ * long, or framing that can't stream, has to drop the packet without hurting the
+ * queue.
+ */
+
+/// Bytes the source hands out:  runs of ones for the bit stuffing, and text
+static uint8_t pattern[TNC_MAX_INFO];
+
+/// Next byte of the pattern the source gives out, and how many it has
+static uint16_t sourceIndex;
+
+/**
+ * Source for TncFrameAppendSource(), reading the pattern in order.
+ */
+static uint8_t Source(void) {
+    return pattern[sourceIndex++ % sizeof(pattern)];
+}
+
+/**
+ * Queue a packet with the start of its field from memory and the rest streamed.
+ *
+ * @param prefix bytes from memory
+ * @param streamed bytes from the source
+ *
+ * @return true if it was queued
+ */
+static bool_t Queue(uint16_t prefix, uint16_t streamed) {
+    if (!TncFrameStart(config.destCallSign))
+        return FALSE;
+    TncFrameAppend(pattern, prefix);
+    sourceIndex = prefix;
+    TncFrameAppendSource(Source, streamed);
+
+    return TncFrameEnd();
+}
+
+/**
+ * Send what's queued and check it decodes to the packets expected.
+ *
+ * @param name what's being sent, for the messages
+ * @param lengths information field lengths of the packets, each from the start of the pattern
+ * @param count number of packets
+ */
+static void Send(const char *name, const uint16_t *lengths, uint8_t count) {
+    static uint8_t bits[8 * 2 * MODEM_MAX_FRAME];
+    uint8_t frame[MODEM_MAX_FRAME], i;
+    uint16_t length;
+
+    HostReset();
+    HostRadioSend();
+    HostCheck(!TncIsSending() && !RadioIsBusy(), "%s: radio keyed down", name);
+
+    ModemAfskDecode();
+    HostCheck(modemFrameCount == count, "%s: %u of %u packets decoded", name, modemFrameCount, count);
+    for (i = 0; i < count && i < modemFrameCount; ++i) {
+        length = ModemFrame(frame, "APRS  ", pattern, lengths[i]);
+        HostCheck(modemFrames[i].length == length && memcmp(modemFrames[i].data, frame, length) == 0,
+                "%s: packet %u doesn't match", name, i);
+
+        if (lengths[i] == TNC_MAX_INFO - 1)
+            HostCheck(ModemHdlcBits(bits, frame, length) > TNC_QUEUE_TONES * 8,
+                    "%s: packet %u fits the queue, so it isn't streamed through it", name, i);
+    }
+}
+
+int main(void) {
+    static const uint16_t full[] = {TNC_MAX_INFO - 1};
+    static const uint16_t split[] = {TNC_MAX_INFO - 1};
+    static const uint16_t pair[] = {20, 200};
+    static const uint16_t one[] = {30};
+    uint16_t n;
+
+    for (n = 0; n < sizeof(pattern); ++n)
+        pattern[n] = (n % 32 < 16 ? 0xff : 'A' + n % 26);
+
+    TncConfigDefault();
+    config.txDelay = 4;
+
+    // The whole field streamed, with room for the end of message character
+    HostCheck(Queue(0, TNC_MAX_INFO - 1), "full field queued");
+    Send("full field", full, 1);
+    HostCheck(sourceIndex == TNC_MAX_INFO - 1, "source read %u times, expected %u", sourceIndex, TNC_MAX_INFO - 1);
+
+    // Some from memory, the rest streamed
+    HostCheck(Queue(40, TNC_MAX_INFO - 1 - 40), "split field queued");
+    Send("split field", split, 1);
+    HostCheck(sourceIndex == TNC_MAX_INFO - 1, "split field: source stopped at %u", sourceIndex);
+
+    // A packet from memory, then a streamed one in the same transmission
+    HostCheck(Queue(20, 0), "first of pair queued");
+    HostCheck(Queue(0, 200), "streamed second of pair queued");
+    HostCheck(!Queue(10, 0), "nothing queues behind a streamed packet");
+    Send("pair", pair, 2);
+
+    // One byte too many
+    HostCheck(!Queue(0, TNC_MAX_INFO), "oversize field dropped");
+    HostCheck(!Queue(100, TNC_MAX_INFO - 100), "oversize split field dropped");
+
+    // FX.25 and IL2P fill in a tag or header from the whole packet, so they can't stream
+    config.framing = TNC_FRAMING_FX25;
+    HostCheck(!Queue(0, 30), "FX.25 packet can't stream");
+    config.framing = TNC_FRAMING_IL2P;
+    HostCheck(!Queue(0, 30), "IL2P packet can't stream");
+    config.framing = TNC_FRAMING_AX25;
+
+    // The dropped packets left the queue alone
+    HostCheck(Queue(30, 0), "packet queued after the dropped ones");
+    Send("after dropped", one, 1);
+
+    return HostReport("stream");
+}
@@ -0,0 +1,185 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <htc.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+#define _XTAL_FREQ 32000000
+
+/*
+ * Distortion of the DDS tones, to pick between the resistor DAC and the PWM
+ * output for a board.  Built once for each, both with TNC_DDS so the samples
+ * come at the same rate.
+ *
+ * The samples in the middle of each run of one tone are fit with the tone and its
+ * harmonics at the frequency the phase step makes.  The harmonics' power over the
+ * tone's is the THD, and whatever the fit doesn't account for is the noise the
+ * steps of the table add.  Below the sample rate, that's what a receiver hears.
+ */
+
+#if TNC_OUTPUT == TNC_OUTPUT_PWM
+#define TEST_NAME "distortion, PWM"
+/// Largest THD+N allowed, percent
+#define TEST_LIMIT 4.0
+#else
+#define TEST_NAME "distortion, DAC"
+#define TEST_LIMIT 15.0
+#endif
+
+/// Harmonics fit above the tone
+#define TEST_HARMONICS 5
+
+/// Size of the fit:  the middle, and a cos and sin for the tone and each harmonic
+#define TEST_TERMS (1 + 2 * (TEST_HARMONICS + 1))
+
+/// Power of the tone and each harmonic, and what's left over, summed over the runs
+typedef struct {
+    double harmonic[TEST_HARMONICS + 2];
+    double residual;
+} TEST_POWER;
+
+/**
+ * Least squares fit of the samples from first to last with a tone and its
+ * harmonics, adding the power of each into the sums.
+ */
+static void Fit(uint32_t first, uint32_t last, double frequency, TEST_POWER *power) {
+    double matrix[TEST_TERMS][TEST_TERMS + 1], basis[TEST_TERMS], fit[TEST_TERMS], x, t, scale, error;
+    uint32_t n;
+    uint8_t i, j, k;
+
+    memset(matrix, 0, sizeof(matrix));
+    for (n = first; n <= last; ++n) {
+        t = (double) (hostDac[n].time - hostDac[first].time) / HOST_TIMER2_RATE;
+        x = (2.0 * hostDac[n].level - HOST_DAC_FULL) / HOST_DAC_FULL;
+
+        basis[0] = 1;
+        for (k = 1; k <= TEST_HARMONICS + 1; ++k) {
+            basis[2 * k - 1] = cos(2 * M_PI * k * frequency * t);
+            basis[2 * k] = sin(2 * M_PI * k * frequency * t);
+        }
+        for (i = 0; i < TEST_TERMS; ++i) {
+            for (j = 0; j < TEST_TERMS; ++j)
+                matrix[i][j] += basis[i] * basis[j];
+            matrix[i][TEST_TERMS] += basis[i] * x;
+        }
+    }
+
+    // Gauss-Jordan, the normal equations are well conditioned over a few cycles
+    for (i = 0; i < TEST_TERMS; ++i) {
+        for (j = 0; j < TEST_TERMS; ++j)
+            if (j != i) {
+                scale = matrix[j][i] / matrix[i][i];
+                for (k = i; k <= TEST_TERMS; ++k)
+                    matrix[j][k] -= scale * matrix[i][k];
+            }
+    }
+    for (i = 0; i < TEST_TERMS; ++i)
+        fit[i] = matrix[i][TEST_TERMS] / matrix[i][i];
+
+    for (k = 1; k <= TEST_HARMONICS + 1; ++k)
+        power->harmonic[k] += (fit[2 * k - 1] * fit[2 * k - 1] + fit[2 * k] * fit[2 * k]) / 2 * (last - first + 1);
+
+    for (n = first; n <= last; ++n) {
+        t = (double) (hostDac[n].time - hostDac[first].time) / HOST_TIMER2_RATE;
+        error = (2.0 * hostDac[n].level - HOST_DAC_FULL) / HOST_DAC_FULL - fit[0];
+        for (k = 1; k <= TEST_HARMONICS + 1; ++k)
+            error -= fit[2 * k - 1] * cos(2 * M_PI * k * frequency * t) + fit[2 * k] * sin(2 * M_PI * k * frequency * t);
+        power->residual += error * error;
+    }
+}
+
+/**
+ * Fit every run of a tone four or more bits long, a bit in from each end.
+ *
+ * @param tone 1 for mark, 0 for space
+ * @param step the phase step of the tone
+ * @param name what to call it
+ *
+ * @return THD+N, percent
+ */
+static double Distortion(uint8_t tone, uint16_t step, const char *name) {
+    TEST_POWER power;
+    double frequency, thd, total;
+    uint32_t window, start, end, first, last;
+    uint8_t k;
+
+    frequency = (double) step * HOST_TIMER2_RATE / (TNC_DDS_PR2 + 1) / 65536;
+    window = HOST_WAV_RATE / 1200;
+    memset(&power, 0, sizeof(power));
+
+    first = 0;
+    for (start = window; start < modemSampleCount - window; start = end) {
+        for (end = start; end < modemSampleCount - window && modemSampleTones[end] == modemSampleTones[start]; ++end)
+            ;
+        if (modemSampleTones[start] != tone || end - start < 4 * window)
+            continue;
+
+        // The DAC writes between, the audio starts at the first one
+        while (first < hostDacCount && (hostDac[first].time - hostDac[0].time) * HOST_WAV_RATE < (uint64_t) (start + window) * HOST_TIMER2_RATE)
+            ++first;
+        for (last = first; last + 1 < hostDacCount && (hostDac[last + 1].time - hostDac[0].time) * HOST_WAV_RATE < (uint64_t) (end - window) * HOST_TIMER2_RATE; ++last)
+            ;
+        Fit(first, last, frequency, &power);
+    }
+
+    thd = 0;
+    for (k = 2; k <= TEST_HARMONICS + 1; ++k)
+        thd += power.harmonic[k];
+    total = 100 * sqrt((thd + power.residual) / power.harmonic[1]);
+
+    printf("  %s %.2f Hz:  THD %.2f%%, THD+N %.2f%%, harmonics", name, frequency, 100 * sqrt(thd / power.harmonic[1]), total);
+    for (k = 2; k <= TEST_HARMONICS + 1; ++k)
+        printf(" %.1f", 10 * log10(power.harmonic[k] / power.harmonic[1]));
+    printf(" dBc\n");
+
+    return total;
+}
+
+int main(void) {
+    static uint8_t ones[60];
+    uint8_t frame[MODEM_MAX_FRAME];
+    uint16_t length;
+    uint32_t n;
+    bool_t inRange;
+    double distortion;
+
+    HostReset();
+    TncConfigDefault();
+
+    // Long runs of one tone in the flags and between the stuffed bits of the ones
+    config.txDelay = 255;
+    memset(ones, 0xff, sizeof(ones));
+    length = ModemFrame(frame, "APRS  ", ones, sizeof(ones));
+
+    HostCheck(TncFrameStart(config.destCallSign), "packet started");
+    TncFrameAppend(ones, sizeof(ones));
+    HostCheck(TncFrameEnd(), "packet queued");
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+
+    HostCheck(ModemAfskDecode() == 1 && modemFrames[0].length == length && memcmp(modemFrames[0].data, frame, length) == 0,
+            "packet decodes");
+
+    inRange = TRUE;
+    for (n = 0; n < hostDacCount; ++n)
+        if (hostDac[n].level > HOST_DAC_FULL)
+            inRange = FALSE;
+    HostCheck(inRange, "output stays within full scale");
+
+#if TNC_OUTPUT == TNC_OUTPUT_PWM
+    HostCheck(CCP1CON == 0b00001100, "CCP1 is in PWM mode");
+    HostCheck(PORTA == 0, "resistor DAC is left alone");
+#endif
+
+    printf("%s:\n", TEST_NAME);
+    distortion = Distortion(1, TNC_DDS_MARK, "mark");
+    HostCheck(distortion < TEST_LIMIT, "mark THD+N %.2f%% is over %.1f%%", distortion, TEST_LIMIT);
+    distortion = Distortion(0, TNC_DDS_SPACE, "space");
+    HostCheck(distortion < TEST_LIMIT, "space THD+N %.2f%% is over %.1f%%", distortion, TEST_LIMIT);
+
+    return HostReport(TEST_NAME);
+}
@@ -0,0 +1,149 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * Frequency and baud error of the modulator, measured from its audio the way a
+ * scope would.  Built twice:  once for the PR2 modulator, whose tones and bit clock
+ * come out of whole timer periods, and once with TNC_DDS for the phase accumulator,
+ * which should be exact to within the rounding of its steps.
+ *
+ * The baud rate is the time between the first and last tone change over a long
+ * transmission.  Each tone's frequency is the average period between zero
+ * crossings in the middle of runs of four or more bits of it.
+ */
+
+#if TNC_DDS
+#define TEST_NAME "tone error, DDS"
+/// Largest error allowed, percent
+#define TEST_LIMIT 0.05
+#else
+#define TEST_NAME "tone error, PR2"
+#define TEST_LIMIT 1.0
+#endif
+
+/**
+ * Measure the average frequency of a tone in the middle of its long runs.
+ *
+ * @param tone 1 for mark, 0 for space
+ *
+ * @return frequency in Hz
+ */
+static double Frequency(uint8_t tone) {
+    uint32_t window, start, end, n;
+    double first, last, cycles, time, crossing;
+    bool_t found;
+
+    window = HOST_WAV_RATE / 1200;
+    cycles = 0;
+    time = 0;
+
+    for (start = window; start < modemSampleCount - window; start = end) {
+        for (end = start; end < modemSampleCount - window && modemSampleTones[end] == modemSampleTones[start]; ++end)
+            ;
+        if (modemSampleTones[start] != tone || end - start < 4 * window)
+            continue;
+
+        // Half a bit in from each end, clear of the tone change
+        found = FALSE;
+        first = 0;
+        last = 0;
+        for (n = start + window / 2; n < end - window / 2; ++n)
+            if (modemAudio[n - 1] < 0 && modemAudio[n] >= 0) {
+                crossing = n - 1 + (double) -modemAudio[n - 1] / (modemAudio[n] - modemAudio[n - 1]);
+                if (!found)
+                    first = crossing;
+                else
+                    cycles += 1;
+                last = crossing;
+                found = TRUE;
+            }
+        time += last - first;
+    }
+
+    return cycles * HOST_WAV_RATE / time;
+}
+
+/**
+ * Measure the bit rate from the first tone change to the last.
+ *
+ * @return baud
+ */
+static double Baud(void) {
+    uint32_t first, last, n;
+    double bits;
+
+    first = 0;
+    last = 0;
+    for (n = HOST_WAV_RATE / 1200 + 1; n < modemSampleCount - HOST_WAV_RATE / 1200; ++n)
+        if (modemSampleTones[n] != modemSampleTones[n - 1]) {
+            if (first == 0)
+                first = n;
+            last = n;
+        }
+
+    // The edges are whole bits apart
+    bits = floor((double) (last - first) * 1200 / HOST_WAV_RATE + 0.5);
+
+    return bits * HOST_WAV_RATE / (last - first);
+}
+
+/**
+ * Check a measurement against what it should be.
+ */
+static void Error(const char *what, double measured, double nominal) {
+    double error;
+
+    error = 100 * (measured - nominal) / nominal;
+    printf("  %s %.2f, %+.3f%%\n", what, measured, error);
+    HostCheck(fabs(error) < TEST_LIMIT, "%s %.2f is %+.3f%% off, more than %.2f%%", what, measured, error, TEST_LIMIT);
+}
+
+int main(void) {
+    static uint8_t ones[60];
+    uint8_t frame[MODEM_MAX_FRAME];
+    uint16_t length;
+    uint32_t n;
+    bool_t fixed;
+
+    HostReset();
+    TncConfigDefault();
+
+    // Long runs of one tone in the flags and between the stuffed bits of the ones
+    config.txDelay = 255;
+    memset(ones, 0xff, sizeof(ones));
+    length = ModemFrame(frame, "APRS  ", ones, sizeof(ones));
+
+    HostCheck(TncFrameStart(config.destCallSign), "packet started");
+    TncFrameAppend(ones, sizeof(ones));
+    HostCheck(TncFrameEnd(), "packet queued");
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+
+    HostCheck(ModemAfskDecode() == 1 && modemFrames[0].length == length && memcmp(modemFrames[0].data, frame, length) == 0,
+            "packet decodes");
+
+#if TNC_DDS
+    // The sample rate never changes
+    fixed = TRUE;
+    for (n = 0; n < hostDacCount; ++n)
+        if (hostDac[n].pr2 != TNC_DDS_PR2)
+            fixed = FALSE;
+    HostCheck(fixed, "PR2 stays at TNC_DDS_PR2");
+#else
+    (void) n;
+    (void) fixed;
+#endif
+
+    printf("%s:\n", TEST_NAME);
+    Error("mark Hz", Frequency(1), 1200);
+    Error("space Hz", Frequency(0), 2200);
+    Error("baud", Baud(), 1200);
+
+    return HostReport(TEST_NAME);
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "tnc.h"
+#include "host.h"
+#include "modem.h"
+
+/*
+ * The tone stream TncPreparePacket() and the frame builder encode ahead of time.
+ * Each transmission is taken back out of the DAC log a tone per bit and held to
+ * the reference:  txDelay flags, then each packet bit stuffed with its CRC and
+ * two closing flags, NRZI encoded from a space.  The payloads lean on the bit
+ * stuffing:  runs of ones across byte boundaries, flag bytes, and five ones
+ * right before the CRC.  Last, the encoding and the interrupt are timed.
+ */
+
+/// A packet's information field
+typedef struct {
+    const uint8_t *data;
+    uint16_t length;
+} INFO;
+
+static const uint8_t ones[] = {0xff, 0xff, 0xff, 0x7e, 0x7e, 0x3f, 0xfc, 0x1f, 0xf8, 0x00, 0xff, 0x1f};
+static const uint8_t flags[] = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+static const uint8_t text[] = ">tones test";
+static const uint8_t one[] = "one";
+static const uint8_t three[] = "three";
+static const uint8_t binary[] = {0x00, 0x01, 0x80, 0xc0, 0xdb, 0xdc, 0xdd, 0xfe, 0x0f, 0xf0};
+
+/**
+ * Send packets in one transmission and check every tone of it.
+ *
+ * @param name what's being sent, for the messages
+ * @param packets information fields to send
+ * @param count number of packets
+ */
+static void Send(const char *name, const INFO *packets, uint8_t count) {
+    static uint8_t bits[8 * 4 * (TNC_MAX_TX + 64)];
+    uint8_t frame[MODEM_MAX_FRAME], tone, i;
+    uint16_t length;
+    uint32_t expected, before, n;
+
+    expected = 0;
+    for (n = 0; n < config.txDelay; ++n)
+        expected += ModemFlag(bits + expected);
+
+    for (i = 0; i < count; ++i) {
+        length = ModemFrame(frame, "APRS  ", packets[i].data, packets[i].length);
+        expected += ModemHdlcBits(bits + expected, frame, length);
+        expected += ModemFlag(bits + expected);
+        expected += ModemFlag(bits + expected);
+
+        HostCheck(TncFrameStart(config.destCallSign), "%s: packet %u started", name, i);
+        TncFrameAppend((uint8_t *) packets[i].data, packets[i].length);
+        HostCheck(TncFrameEnd(), "%s: packet %u queued", name, i);
+    }
+
+    tone = 0;
+    ModemNrzi(bits, expected, &tone);
+
+    before = ModemDacTones();
+    TncSendPacket();
+    while (TncIsSending())
+        HostStep();
+    ModemDacTones();
+
+    HostCheck(modemToneCount - before == expected, "%s: %u tones sent, expected %u", name, modemToneCount - before, expected);
+    for (n = 0; n < expected && before + n < modemToneCount; ++n)
+        if (modemTones[before + n] != bits[n])
+            break;
+    HostCheck(n == expected, "%s: tone %u is wrong", name, n);
+}
+
+/**
+ * Check the tone count TncFrameTones() predicts for a packet against the reference.
+ */
+static void CountTones(const uint8_t *info) {
+    static uint8_t bits[8 * 2 * MODEM_MAX_FRAME];
+    uint8_t frame[MODEM_MAX_FRAME];
+    uint16_t length, tones;
+    uint32_t expected;
+
+    length = ModemFrame(frame, "APRS  ", info, strlen((const char *) info));
+    expected = ModemHdlcBits(bits, frame, length);
+    tones = TncFrameTones((uint8_t *) info, config.destCallSign);
+
+    HostCheck(tones == expected, "TncFrameTones(\"%s\") is %u, expected %u", info, tones, expected);
+}
+
+/**
+ * Time TncPreparePacket() encoding a packet, and the interrupt sending it, on
+ * this machine.  It's a host figure, for comparing the two, not a PIC18 cycle count.
+ */
+static void Benchmark(void) {
+    uint32_t n, interrupts;
+    clock_t start;
+    double prepareTime, interruptTime;
+
+    config.txDelay = 1;
+    prepareTime = interruptTime = 0;
+    interrupts = 0;
+
+    for (n = 0; n < 2000; ++n) {
+        start = clock();
+        TncPreparePacket((uint8_t *) text, config.destCallSign);
+        prepareTime += (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        TncSendPacket();
+        start = clock();
+        while (TncIsSending()) {
+            TncTimer2Interrupt();
+            ++interrupts;
+        }
+        interruptTime += (double) (clock() - start) / CLOCKS_PER_SEC;
+    }
+
+    printf("tones: %.0f ns to prepare a packet, %.1f ns an interrupt, %lu interrupts a packet\n", prepareTime * 1e9 / n,
+            interruptTime * 1e9 / interrupts, (unsigned long) (interrupts / n));
+}
+
+int main(void) {
+    static const INFO plain[] = {{text, sizeof(text) - 1}};
+    static const INFO stuffed[] = {{ones, sizeof(ones)}};
+    static const INFO flagged[] = {{flags, sizeof(flags) - 1}};
+    static const INFO empty[] = {{text, 0}};
+    static const INFO burst[] = {{one, 3}, {ones, sizeof(ones)}, {three, 5}};
+    static const INFO mixed[] = {{binary, sizeof(binary)}, {flags, 6}};
+
+    HostReset();
+    TncConfigDefault();
+
+    Send("plain", plain, 1);
+    Send("stuffed", stuffed, 1);
+    Send("flags", flagged, 1);
+    Send("empty", empty, 1);
+    Send("three back to back", burst, 3);
+    Send("binary", mixed, 2);
+
+    // A shorter txDelay and a different path change the flags and header
+    config.txDelay = 3;
+    config.callSignSSID = 15;
+    config.relayCallSign2[0] = 0;
+    TncBuildHeader();
+    Send("short txDelay, one relay", burst, 3);
+
+    CountTones(text);
+    CountTones(flags);
+    CountTones((const uint8_t *) "");
+    CountTones((const uint8_t *) "?????|||||\x7f\x7f");
+
+    Benchmark();
+
+    return HostReport("tones");
+}
@@ -0,0 +1,254 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "gps.h"
+#include "host.h"
+#include "nmea.h"
+
+/*
+ * UBX NAV-PVT frames, built from the u-blox protocol spec, through the same
+ * parser as the NMEA sentences.  Frames with random fixes have to decode to
+ * the GPSData units, rounded to the nearest, with the date and time only taken
+ * when they're flagged valid and the fix type only when the fix is good.
+ * Frames with a bad checksum, the wrong length, or too long to be real mustn't
+ * change anything, other messages are skipped whatever's in them, and NMEA
+ * sentences in between, even after a stray sync character, still decode.
+ */
+
+/// Bytes in a NAV-PVT payload
+#define PVT_LENGTH 92
+
+/// A NAV-PVT payload's fields, as the spec lays them out
+typedef struct {
+    uint16_t year;
+    uint8_t month, day, hour, minute, second, valid;
+    uint8_t fixType, flags, satellites;
+    int32_t longitude, latitude, height, hMSL, gSpeed, headMot;
+    uint16_t pDOP;
+} PVT;
+
+/**
+ * Store a little endian number.
+ */
+static void Put(uint8_t *out, uint32_t value, uint8_t bytes) {
+    while (bytes-- != 0) {
+        *out++ = (uint8_t) value;
+        value >>= 8;
+    }
+}
+
+/**
+ * Build a UBX frame, sync characters, class, ID, length, payload, and the 8 bit
+ * Fletcher checksum over the class through the payload.
+ *
+ * @return length of the frame
+ */
+static uint16_t Frame(char *frame, uint8_t class, uint8_t id, const uint8_t *payload, uint16_t length) {
+    uint8_t a, b, *out;
+    uint16_t i;
+
+    out = (uint8_t *) frame;
+    out[0] = 0xb5;
+    out[1] = 0x62;
+    out[2] = class;
+    out[3] = id;
+    Put(out + 4, length, 2);
+    memcpy(out + 6, payload, length);
+
+    a = b = 0;
+    for (i = 2; i < length + 6; ++i) {
+        a += out[i];
+        b += a;
+    }
+    out[length + 6] = a;
+    out[length + 7] = b;
+
+    return length + 8;
+}
+
+/**
+ * Build a NAV-PVT frame.
+ */
+static uint16_t PvtFrame(char *frame, const PVT *pvt) {
+    uint8_t payload[PVT_LENGTH], i;
+
+    // Everything we don't use gets noise, so it can't matter
+    for (i = 0; i < PVT_LENGTH; ++i)
+        payload[i] = (uint8_t) NmeaRandom();
+
+    Put(payload + 4, pvt->year, 2);
+    payload[6] = pvt->month;
+    payload[7] = pvt->day;
+    payload[8] = pvt->hour;
+    payload[9] = pvt->minute;
+    payload[10] = pvt->second;
+    payload[11] = pvt->valid;
+    payload[20] = pvt->fixType;
+    payload[21] = pvt->flags;
+    payload[23] = pvt->satellites;
+    Put(payload + 24, pvt->longitude, 4);
+    Put(payload + 28, pvt->latitude, 4);
+    Put(payload + 32, pvt->height, 4);
+    Put(payload + 36, pvt->hMSL, 4);
+    Put(payload + 60, pvt->gSpeed, 4);
+    Put(payload + 64, pvt->headMot, 4);
+    Put(payload + 76, pvt->pDOP, 2);
+
+    return Frame(frame, 0x01, 0x07, payload, PVT_LENGTH);
+}
+
+/**
+ * A random fix.
+ */
+static void RandomPvt(PVT *pvt) {
+    pvt->year = 2000 + NmeaRandom() % 100;
+    pvt->month = 1 + NmeaRandom() % 12;
+    pvt->day = 1 + NmeaRandom() % 28;
+    pvt->hour = NmeaRandom() % 24;
+    pvt->minute = NmeaRandom() % 60;
+    pvt->second = NmeaRandom() % 60;
+    pvt->valid = NmeaRandom() % 4;
+    pvt->fixType = NmeaRandom() % 6;
+    pvt->flags = NmeaRandom() % 4;
+    pvt->satellites = NmeaRandom() % 30;
+    pvt->longitude = (int32_t) (NmeaRandom() % 3600000001u) - 1800000000;
+    pvt->latitude = (int32_t) (NmeaRandom() % 1800000001u) - 900000000;
+    pvt->height = (int32_t) (NmeaRandom() % 50000000) - 1000000;
+    pvt->hMSL = (int32_t) (NmeaRandom() % 50000000) - 1000000;
+    pvt->gSpeed = NmeaRandom() % 200000;
+    pvt->headMot = NmeaRandom() % 36000000;
+    pvt->pDOP = NmeaRandom() % 10000;
+}
+
+/**
+ * Check the GPS data against a fix it was decoded from.
+ *
+ * @param before the GPS data before the frame, for what shouldn't change
+ *
+ * @return name of the first field that's wrong, or NULL
+ */
+static const char *Wrong(const PVT *pvt, const GPSData *before) {
+    const GPSData *data = GpsGetData();
+    FixType fixType;
+
+    if (pvt->valid & 0x02) {
+        if (data->hours != pvt->hour || data->minutes != pvt->minute || data->seconds != pvt->second)
+            return "time";
+    } else if (data->hours != before->hours || data->minutes != before->minutes || data->seconds != before->seconds)
+        return "invalid time";
+
+    if (pvt->valid & 0x01) {
+        if (data->year != pvt->year || data->month != pvt->month || data->day != pvt->day)
+            return "date";
+    } else if (data->year != before->year || data->month != before->month || data->day != before->day)
+        return "invalid date";
+
+    if (!(pvt->flags & 0x01))
+        fixType = NoFix;
+    else if (pvt->fixType == 2)
+        fixType = Fix2D;
+    else if (pvt->fixType == 3 || pvt->fixType == 4)
+        fixType = Fix3D;
+    else
+        fixType = NoFix;
+    if (data->fixType != fixType)
+        return "fix type";
+
+    if (data->trackedSats != pvt->satellites)
+        return "satellites";
+    if (data->latitude != pvt->latitude || data->longitude != pvt->longitude)
+        return "position";
+    if (data->latitudeDigits[0] != 0 || data->longitudeDigits[0] != 0)
+        return "position digits";
+    if (data->altitude != (int32_t) lround(pvt->hMSL / 10.0))
+        return "altitude";
+    if (data->speed != (uint16_t) lround(pvt->gSpeed * 3.6 / 1.852 / 100))
+        return "speed";
+    if (data->heading != (uint16_t) lround(pvt->headMot / 1000.0))
+        return "course";
+    if (data->dop != (uint16_t) lround(pvt->pDOP / 10.0))
+        return "DOP";
+
+    return NULL;
+}
+
+/**
+ * Feed something that shouldn't be used, and check that nothing changed.
+ */
+static void Rejected(const char *name, const char *text, uint32_t length) {
+    char sentence[NMEA_MAX_SENTENCE];
+    GPSData before;
+
+    GpsIsDataReady();
+    before = *GpsGetData();
+    NmeaFeed(text, length, 1);
+    HostCheck(memcmp(&before, GpsGetData(), sizeof(before)) == 0, "%s changed the GPS data", name);
+    HostCheck(!GpsIsDataReady(), "%s set the data ready", name);
+
+    // And what follows still decodes
+    NmeaFeed(sentence, NmeaSentence(sentence, "GPGGA,120000.00,,,,,1,07,1.5,1234.5,M,,M,,"), 1);
+    HostCheck(GpsIsDataReady() && GpsGetData()->altitude == 123450, "sentence after %s didn't decode", name);
+}
+
+int main(void) {
+    char frame[1024], sentence[NMEA_MAX_SENTENCE];
+    uint8_t payload[600];
+    PVT pvt, other;
+    GPSData before;
+    const char *wrong;
+    uint32_t i, matched;
+    uint16_t length;
+
+    // Random fixes, a byte at a time and in chunks, with NMEA in between
+    matched = 0;
+    for (i = 0; i < 20000; ++i) {
+        RandomPvt(&pvt);
+        before = *GpsGetData();
+        NmeaFeed(frame, PvtFrame(frame, &pvt), 1 + NmeaRandom() % 150);
+
+        wrong = Wrong(&pvt, &before);
+        if (wrong == NULL && GpsIsDataReady())
+            ++matched;
+        else if (i - matched < 10)
+            HostCheck(FALSE, "frame %lu: %s is wrong", (unsigned long) i, wrong != NULL ? wrong : "data ready");
+
+        if (i % 7 == 0)
+            NmeaFeed(sentence, NmeaSentence(sentence, "GPGSV,3,1,12,01,40,083,46,02,17,308,41"), 200);
+    }
+    HostCheck(matched == 20000, "%lu of 20000 frames decode", (unsigned long) matched);
+
+    // The same frame whole, to damage
+    RandomPvt(&other);
+    other.valid = 3;
+    other.flags = 1;
+    length = PvtFrame(frame, &other);
+
+    frame[length - 2] ^= 0x01;
+    Rejected("a bad checksum A", frame, length);
+    frame[length - 2] ^= 0x01;
+    frame[length - 1] ^= 0x01;
+    Rejected("a bad checksum B", frame, length);
+    frame[length - 1] ^= 0x01;
+    frame[40] ^= 0x10;
+    Rejected("a damaged payload", frame, length);
+
+    // The wrong length, and too long to be real
+    memset(payload, 0, sizeof(payload));
+    Rejected("a short NAV-PVT", frame, Frame(frame, 0x01, 0x07, payload, PVT_LENGTH - 4));
+    Rejected("a long frame", frame, Frame(frame, 0x01, 0x07, payload, 600));
+
+    // Other messages are skipped, even full of '$' and sync characters
+    for (i = 0; i < sizeof(payload); ++i)
+        payload[i] = "$\xb5\x62,*"[i % 5];
+    Rejected("a NAV-SAT", frame, Frame(frame, 0x01, 0x35, payload, 200));
+    Rejected("an empty ACK", frame, Frame(frame, 0x05, 0x01, payload, 0));
+
+    // A stray sync character right before a sentence
+    sentence[0] = (char) 0xb5;
+    length = NmeaSentence(sentence + 1, "GPGGA,120000.00,,,,,1,07,1.5,2345.6,M,,M,,") + 1;
+    NmeaFeed(sentence, length, 1);
+    HostCheck(GpsIsDataReady() && GpsGetData()->altitude == 234560, "sentence after a stray sync character didn't decode");
+
+    return HostReport("ubx");
+}